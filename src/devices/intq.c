@@ -88,11 +88,17 @@ wait (struct intq *q UNUSED, struct thread **waiter)
 {
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
-  ASSERT ((waiter == &q->not_empty && intq_empty (q))
-          || (waiter == &q->not_full && intq_full (q)));
 
-  *waiter = thread_current ();
-  thread_block ();
+  /* With interrupts off the condition can still change under us,
+     from another CPU, until sched_lock is held. */
+  spinlock_acquire (&sched_lock);
+  if ((waiter == &q->not_empty && intq_empty (q))
+      || (waiter == &q->not_full && intq_full (q)))
+    {
+      *waiter = thread_current ();
+      thread_block ();
+    }
+  spinlock_release (&sched_lock);
 }
 
 /* WAITER must be the address of Q's not_empty or not_full
@@ -106,9 +112,11 @@ signal (struct intq *q UNUSED, struct thread **waiter)
   ASSERT ((waiter == &q->not_empty && !intq_empty (q))
           || (waiter == &q->not_full && !intq_full (q)));
 
+  spinlock_acquire (&sched_lock);
   if (*waiter != NULL) 
     {
       thread_unblock (*waiter);
       *waiter = NULL;
     }
+  spinlock_release (&sched_lock);
 }
@@ -0,0 +1,73 @@
+#include "devices/ioapic.h"
+#include <debug.h>
+#include <stdio.h>
+
+/* I/O Advanced Programmable Interrupt Controller.  Replaces the
+   pair of 8259A PICs on a multiprocessor: it takes the device
+   interrupt lines and sends each one, as a message with a vector,
+   to the local APIC of a chosen CPU.
+   Refer to the Intel 82093AA I/O APIC datasheet for details. */
+
+/* Memory-mapped registers, as byte offsets from the base
+   address.  The I/O APIC's own registers are reached indirectly,
+   by writing their index to IOREGSEL and then accessing IOWIN. */
+#define IOREGSEL 0x00
+#define IOWIN    0x10
+
+/* Indirect registers. */
+#define IOAPICVER      0x01             /* Version and # of pins. */
+#define IOREDTBL(PIN)  (0x10 + 2 * (PIN))       /* Redirection entry. */
+
+#define REDIR_MASKED   0x00010000       /* Interrupt masked. */
+
+static volatile uint32_t *ioapic;
+static int pin_cnt;
+
+static uint32_t
+ioapic_read (int reg)
+{
+  ioapic[IOREGSEL / sizeof *ioapic] = reg;
+  return ioapic[IOWIN / sizeof *ioapic];
+}
+
+static void
+ioapic_write (int reg, uint32_t value)
+{
+  ioapic[IOREGSEL / sizeof *ioapic] = reg;
+  ioapic[IOWIN / sizeof *ioapic] = value;
+}
+
+/* Initializes the I/O APIC whose registers are mapped at REGS,
+   with every pin masked. */
+void
+ioapic_init (volatile void *regs)
+{
+  int pin;
+
+  ioapic = regs;
+  pin_cnt = ((ioapic_read (IOAPICVER) >> 16) & 0xff) + 1;
+
+  for (pin = 0; pin < pin_cnt; pin++)
+    {
+      ioapic_write (IOREDTBL (pin), REDIR_MASKED);
+      ioapic_write (IOREDTBL (pin) + 1, 0);
+    }
+}
+
+/* Sends interrupt line PIN, which behaves as described by FLAGS,
+   to the CPU with local APIC ID APIC_ID as vector VEC. */
+void
+ioapic_route (int pin, uint8_t vec, uint32_t flags, uint8_t apic_id)
+{
+  ASSERT (ioapic != NULL);
+  ASSERT ((flags & ~(IOAPIC_ACTIVE_LOW | IOAPIC_LEVEL)) == 0);
+
+  if (pin >= pin_cnt)
+    {
+      printf ("ioapic: no pin %d for vector %#04x\n", pin, vec);
+      return;
+    }
+
+  ioapic_write (IOREDTBL (pin) + 1, (uint32_t) apic_id << 24);
+  ioapic_write (IOREDTBL (pin), vec | flags);
+}
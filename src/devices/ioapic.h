@@ -0,0 +1,14 @@
+#ifndef DEVICES_IOAPIC_H
+#define DEVICES_IOAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Redirection entry flags, as found in the MP table. */
+#define IOAPIC_ACTIVE_LOW  0x00002000   /* Pin polarity: active low. */
+#define IOAPIC_LEVEL       0x00008000   /* Trigger mode: level. */
+
+void ioapic_init (volatile void *regs);
+void ioapic_route (int pin, uint8_t vec, uint32_t flags, uint8_t apic_id);
+
+#endif /* devices/ioapic.h */
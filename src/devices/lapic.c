@@ -0,0 +1,216 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include "devices/timer.h"
+#include "threads/io.h"
+#include "threads/vaddr.h"
+
+/* Local Advanced Programmable Interrupt Controller (APIC).
+   Every CPU has one.  It delivers the interrupts routed to that
+   CPU, has a timer of its own and is how CPUs interrupt each
+   other (inter-processor interrupts, IPIs).
+   Refer to [IA32-v3a] chapter 10 "Advanced Programmable
+   Interrupt Controller (APIC)" for details. */
+
+/* Registers, as byte offsets from the base address. */
+#define LAPIC_ID          0x020   /* ID. */
+#define LAPIC_TPR         0x080   /* Task Priority. */
+#define LAPIC_EOI         0x0b0   /* End Of Interrupt. */
+#define LAPIC_SVR         0x0f0   /* Spurious Interrupt Vector. */
+#define LAPIC_ESR         0x280   /* Error Status. */
+#define LAPIC_ICR_LO      0x300   /* Interrupt Command, bits 0-31. */
+#define LAPIC_ICR_HI      0x310   /* Interrupt Command, bits 32-63. */
+#define LAPIC_LVT_TIMER   0x320   /* Local Vector Table: timer. */
+#define LAPIC_LVT_LINT0   0x350   /* Local Vector Table: LINT0 pin. */
+#define LAPIC_LVT_LINT1   0x360   /* Local Vector Table: LINT1 pin. */
+#define LAPIC_LVT_ERROR   0x370   /* Local Vector Table: errors. */
+#define LAPIC_TIMER_INIT  0x380   /* Timer initial count. */
+#define LAPIC_TIMER_CUR   0x390   /* Timer current count. */
+#define LAPIC_TIMER_DIV   0x3e0   /* Timer divide configuration. */
+
+/* Bits of the above. */
+#define SVR_ENABLE        0x00000100    /* APIC software enable. */
+#define LVT_MASKED        0x00010000    /* Interrupt masked. */
+#define LVT_PERIODIC      0x00020000    /* Timer: periodic mode. */
+#define ICR_INIT          0x00000500    /* Delivery mode: INIT. */
+#define ICR_STARTUP       0x00000600    /* Delivery mode: start-up. */
+#define ICR_PENDING       0x00001000    /* Delivery status: send pending. */
+#define ICR_ASSERT        0x00004000    /* Level: assert. */
+#define ICR_LEVEL         0x00008000    /* Trigger mode: level. */
+#define TIMER_DIV_16      0x3           /* Divide the bus clock by 16. */
+
+/* Ticks of TIMER_FREQ measured by lapic_timer_calibrate(). */
+#define CALIBRATE_TICKS 10
+
+/* CMOS registers used to set up the warm reset vector. */
+#define CMOS_PORT_INDEX   0x70
+#define CMOS_PORT_DATA    0x71
+#define CMOS_SHUTDOWN     0x0f          /* Shutdown status register. */
+#define CMOS_WARM_RESET   0x0a          /* "Jump through 40:67" status. */
+
+static volatile uint32_t *lapic;
+
+/* Timer count that makes for a TIMER_FREQ Hz periodic timer. */
+static uint32_t timer_count;
+
+static uint32_t
+lapic_read (int reg)
+{
+  return lapic[reg / sizeof *lapic];
+}
+
+static void
+lapic_write (int reg, uint32_t value)
+{
+  lapic[reg / sizeof *lapic] = value;
+
+  /* Wait for the write to finish, by reading. */
+  lapic_read (LAPIC_ID);
+}
+
+/* Records that the local APIC registers are mapped at REGS.
+   All the CPUs see their own local APIC at the same address. */
+void
+lapic_init (volatile void *regs)
+{
+  lapic = regs;
+}
+
+/* Returns true if lapic_init() was called. */
+bool
+lapic_present (void)
+{
+  return lapic != NULL;
+}
+
+/* Enables the current CPU's local APIC.  LINT0 and LINT1, through
+   which the PIC and NMIs can reach the CPU, are masked: external
+   interrupts come through the I/O APIC instead. */
+void
+lapic_init_cpu (void)
+{
+  ASSERT (lapic != NULL);
+
+  lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+  lapic_write (LAPIC_LVT_TIMER, LVT_MASKED);
+  lapic_write (LAPIC_LVT_LINT0, LVT_MASKED);
+  lapic_write (LAPIC_LVT_LINT1, LVT_MASKED);
+  lapic_write (LAPIC_LVT_ERROR, LVT_MASKED);
+
+  /* Clear the error status, which takes two writes, and any
+     interrupt still waiting to be acknowledged. */
+  lapic_write (LAPIC_ESR, 0);
+  lapic_write (LAPIC_ESR, 0);
+  lapic_write (LAPIC_EOI, 0);
+
+  /* Accept every interrupt. */
+  lapic_write (LAPIC_TPR, 0);
+}
+
+/* Returns the current CPU's local APIC ID. */
+uint8_t
+lapic_id (void)
+{
+  ASSERT (lapic != NULL);
+
+  return lapic_read (LAPIC_ID) >> 24;
+}
+
+/* Acknowledges the interrupt being handled. */
+void
+lapic_eoi (void)
+{
+  lapic_write (LAPIC_EOI, 0);
+}
+
+/* Sends an interrupt command with the given low word ICR_LO to
+   the CPU whose local APIC ID is APIC_ID, and waits for it to be
+   delivered. */
+static void
+send_command (uint8_t apic_id, uint32_t icr_lo)
+{
+  lapic_write (LAPIC_ICR_HI, (uint32_t) apic_id << 24);
+  lapic_write (LAPIC_ICR_LO, icr_lo);
+  while (lapic_read (LAPIC_ICR_LO) & ICR_PENDING)
+    asm volatile ("pause");
+}
+
+/* Interrupts the CPU with local APIC ID APIC_ID with vector VEC. */
+void
+lapic_send_ipi (uint8_t apic_id, uint8_t vec)
+{
+  send_command (apic_id, vec);
+}
+
+/* Starts the application processor whose local APIC ID is
+   APIC_ID running 16-bit real mode code at START_PHYS, which
+   must be page-aligned and below 1 MB.  This is the INIT,
+   STARTUP, STARTUP sequence of [MP] appendix B.4. */
+void
+lapic_start_ap (uint8_t apic_id, uintptr_t start_phys)
+{
+  uint16_t *warm_reset_vector;
+  int i;
+
+  ASSERT (start_phys % PGSIZE == 0 && start_phys < 0x100000);
+
+  /* CPUs older than the STARTUP IPI come out of INIT through the
+     BIOS, which jumps through the warm reset vector at 40:67 if
+     the CMOS shutdown status says so. */
+  outb (CMOS_PORT_INDEX, CMOS_SHUTDOWN);
+  outb (CMOS_PORT_DATA, CMOS_WARM_RESET);
+  warm_reset_vector = ptov (0x467);
+  warm_reset_vector[0] = 0;
+  warm_reset_vector[1] = start_phys >> 4;
+
+  /* Assert, then deassert INIT. */
+  send_command (apic_id, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+  timer_udelay (200);
+  send_command (apic_id, ICR_INIT | ICR_LEVEL);
+  timer_mdelay (10);
+
+  /* The STARTUP vector is the page number of START_PHYS.  [MP]
+     says to send it twice. */
+  for (i = 0; i < 2; i++)
+    {
+      send_command (apic_id, ICR_STARTUP | (start_phys >> 12));
+      timer_udelay (200);
+    }
+}
+
+/* Measures how fast the local APIC timer counts against the
+   8254 timer, which must already be running.  Interrupts must
+   be on. */
+void
+lapic_timer_calibrate (void)
+{
+  int64_t start;
+
+  ASSERT (lapic != NULL);
+
+  lapic_write (LAPIC_TIMER_DIV, TIMER_DIV_16);
+  lapic_write (LAPIC_LVT_TIMER, LVT_MASKED);
+
+  /* Start counting right after a tick. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    asm volatile ("pause");
+  lapic_write (LAPIC_TIMER_INIT, UINT32_MAX);
+
+  start = timer_ticks ();
+  while (timer_ticks () - start < CALIBRATE_TICKS)
+    asm volatile ("pause");
+  timer_count = (UINT32_MAX - lapic_read (LAPIC_TIMER_CUR)) / CALIBRATE_TICKS;
+  lapic_write (LAPIC_TIMER_INIT, 0);
+}
+
+/* Starts the current CPU's local APIC timer interrupting
+   TIMER_FREQ times per second with LAPIC_TIMER_VEC. */
+void
+lapic_timer_start (void)
+{
+  ASSERT (timer_count != 0);
+
+  lapic_write (LAPIC_TIMER_DIV, TIMER_DIV_16);
+  lapic_write (LAPIC_LVT_TIMER, LVT_PERIODIC | LAPIC_TIMER_VEC);
+  lapic_write (LAPIC_TIMER_INIT, timer_count);
+}
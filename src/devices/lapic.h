@@ -0,0 +1,27 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Interrupt vectors raised by the local APICs.  They live at the
+   top of the IDT, away from the PIC's 0x20...0x2f and the system
+   call vector 0x30. */
+#define LAPIC_TIMER_VEC     0xf0    /* Local timer of an AP. */
+#define LAPIC_RESCHED_VEC   0xf1    /* "Pick another thread" IPI. */
+#define LAPIC_TLB_VEC       0xf2    /* "Flush your TLB" IPI. */
+#define LAPIC_SPURIOUS_VEC  0xff    /* Spurious interrupt. */
+
+void lapic_init (volatile void *regs);
+void lapic_init_cpu (void);
+bool lapic_present (void);
+uint8_t lapic_id (void);
+void lapic_eoi (void);
+
+void lapic_send_ipi (uint8_t apic_id, uint8_t vec);
+void lapic_start_ap (uint8_t apic_id, uintptr_t start_phys);
+
+void lapic_timer_calibrate (void);
+void lapic_timer_start (void);
+
+#endif /* devices/lapic.h */
@@ -72,7 +72,7 @@ pit_configure_channel (int channel, int mode, int frequency)
       count = 2;
     }
   else
-    count = (PIT_HZ + frequency / 2) / frequency;
+    count = pit_frequency_to_count (frequency);
 
   /* Configure the PIT mode and load its counters. */
   old_level = intr_disable ();
@@ -81,3 +81,72 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* Returns the number of PIT cycles in one period of a channel
+   running at FREQUENCY Hz, which must be between 19 and PIT_HZ. */
+unsigned
+pit_frequency_to_count (int frequency)
+{
+  ASSERT (frequency >= 19 && frequency <= PIT_HZ);
+
+  return (PIT_HZ + frequency / 2) / frequency;
+}
+
+/* Puts channel 0 in mode 0 (interrupt on terminal count): its
+   output goes high, raising interrupt line 0 once, after COUNT
+   PIT cycles and then stays high until the channel is
+   reprogrammed.  Used by the tickless idle code in
+   devices/timer.c, which calls pit_configure_channel() to go
+   back to a periodic interrupt. */
+void
+pit_configure_oneshot (uint16_t count)
+{
+  enum intr_level old_level;
+
+  ASSERT (count != 0);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, 0x30);
+  outb (PIT_PORT_COUNTER (0), count);
+  outb (PIT_PORT_COUNTER (0), count >> 8);
+  intr_set_level (old_level);
+}
+
+/* Returns the current value of CHANNEL's down-counter. */
+uint16_t
+pit_read_count (int channel)
+{
+  enum intr_level old_level;
+  uint16_t count;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  /* Latch the counter, then read it low byte first. */
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, channel << 6);
+  count = inb (PIT_PORT_COUNTER (channel));
+  count |= inb (PIT_PORT_COUNTER (channel)) << 8;
+  intr_set_level (old_level);
+
+  return count;
+}
+
+/* Returns true if CHANNEL's output is currently high.  For a
+   channel configured with pit_configure_oneshot() this means the
+   count has run out. */
+bool
+pit_output_high (int channel)
+{
+  enum intr_level old_level;
+  uint8_t status;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  /* Read-back command, latching CHANNEL's status only. */
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, 0xe0 | (2 << channel));
+  status = inb (PIT_PORT_COUNTER (channel));
+  intr_set_level (old_level);
+
+  return (status & 0x80) != 0;
+}
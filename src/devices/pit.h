@@ -1,8 +1,15 @@
 #ifndef DEVICES_PIT_H
 #define DEVICES_PIT_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 void pit_configure_channel (int channel, int mode, int frequency);
+unsigned pit_frequency_to_count (int frequency);
+
+/* Tickless idle support. */
+void pit_configure_oneshot (uint16_t count);
+uint16_t pit_read_count (int channel);
+bool pit_output_high (int channel);
 
 #endif /* devices/pit.h */
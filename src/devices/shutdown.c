@@ -4,8 +4,17 @@
 #include "devices/kbd.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
+#include "threads/fpu.h"
+#include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/sched-trace.h"
+#include "threads/slab.h"
+#include "threads/softirq.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
 #endif
@@ -130,6 +139,14 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  palloc_print_stats ();
+  kmem_print_stats ();
+  malloc_print_stats ();
+  fpu_print_stats ();
+  intr_print_stats ();
+  softirq_print_stats ();
+  workqueue_print_stats ();
+  sched_trace_print ();
 #ifdef FILESYS
   block_print_stats ();
 #endif
@@ -138,4 +155,10 @@ print_stats (void)
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef LOCK_PROFILE
+  lock_print_profile ();
+#endif
+#ifdef MALLOC_PROFILE
+  malloc_print_profile ();
+#endif
 }
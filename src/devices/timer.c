@@ -4,10 +4,13 @@
 #include <round.h>
 #include <stdio.h>
 #include "devices/pit.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/sleep.h"
+#include "threads/softirq.h"
+#include "threads/workqueue.h"
 
 
 /* See [8254] for hardware details of the 8254 timer chip. */
@@ -20,12 +23,41 @@
 #endif
 
 /* Number of timer ticks since OS booted. */
-static int64_t ticks;
+static volatile int64_t ticks;
+
+/* Tickless idle mode (-tickless).
+
+   When the idle thread is about to halt, timer_idle_enter()
+   replaces the periodic interrupt by a one-shot interrupt at the
+   next tick at which something has to happen (a sleeper's
+   deadline, delayed work, or the MLFQS once-a-second update), as
+   far as the 16-bit PIT counter reaches.  The one-shot is aligned
+   on the tick boundaries of the periodic timer, so that when it
+   fires the ticks in between are simply added to TICKS and the
+   periodic interrupt is restarted.  If another interrupt wakes
+   up a thread first, timer_idle_exit(), called as the CPU
+   switches to it, counts the tick boundaries that already went
+   by from the PIT counter and shortens the one-shot to the next
+   boundary. */
+bool timer_tickless;
+
+static unsigned tick_count;     /* PIT cycles per tick. */
+static int oneshot_ticks;       /* Ticks covered by the armed one-shot, 0 if periodic. */
+static unsigned oneshot_count;  /* PIT cycles the one-shot was armed with. */
+static unsigned oneshot_first;  /* PIT cycles until the first tick boundary. */
+static int64_t skipped_ticks;   /* # of timer interrupts that never happened. */
 
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Time-stamp counter cycles per second, of the BSP, as measured
+   against the PIT by timer_calibrate().  0 before then. */
+uint64_t timer_tsc_hz;
+
+/* Timer ticks over which timer_calibrate() measures the TSC. */
+#define TSC_CALIBRATE_TICKS 5
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
@@ -40,14 +72,18 @@ timer_init (void)
   sleep_init();
   
   pit_configure_channel (0, 2, TIMER_FREQ);
+  tick_count = pit_frequency_to_count (TIMER_FREQ);
   intr_register_ext (TIMER_IRQ, timer_interrupt, "8254 Timer");
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates loops_per_tick, used to implement brief delays, and
+   timer_tsc_hz. */
 void
 timer_calibrate (void) 
 {
   unsigned high_bit, test_bit;
+  uint64_t start_tsc;
+  int64_t start;
 
   ASSERT (intr_get_level () == INTR_ON);
   printf ("Calibrating timer...  ");
@@ -68,14 +104,45 @@ timer_calibrate (void)
       loops_per_tick |= test_bit;
 
   printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+  /* Count TSC cycles from one tick to a later one. */
+  start = ticks;
+  while (ticks == start)
+    barrier ();
+  start_tsc = rdtsc ();
+  start = ticks;
+  while (ticks - start < TSC_CALIBRATE_TICKS)
+    barrier ();
+  timer_tsc_hz = (rdtsc () - start_tsc) * TIMER_FREQ / TSC_CALIBRATE_TICKS;
+}
+
+/* Converts CYCLES of the time-stamp counter to microseconds, or
+   returns 0 if the TSC has not been calibrated yet. */
+uint64_t
+timer_cycles_to_us (uint64_t cycles) 
+{
+  if (timer_tsc_hz == 0)
+    return 0;
+  return cycles / timer_tsc_hz * 1000000
+         + cycles % timer_tsc_hz * 1000000 / timer_tsc_hz;
 }
 
-/* Returns the number of timer ticks since the OS booted. */
+/* Returns the number of timer ticks since the OS booted.
+
+   Only the BSP takes the timer interrupt, and other CPUs may read
+   TICKS, a 64-bit value, halfway through an update: read it until
+   two reads agree. */
 int64_t
 timer_ticks (void) 
 {
   enum intr_level old_level = intr_disable ();
-  int64_t t = ticks;
+  int64_t t;
+  do
+    {
+      t = ticks;
+      barrier ();
+    }
+  while (t != ticks);
   intr_set_level (old_level);
   return t;
 }
@@ -169,21 +236,106 @@ timer_ndelay (int64_t ns)
   real_time_delay (ns, 1000 * 1000 * 1000);
 }
 
+/* Called by the idle thread, with interrupts off, right before
+   it halts the CPU.  In tickless mode, arms a one-shot interrupt
+   for the next tick that needs one. */
+void
+timer_idle_enter (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || oneshot_ticks != 0)
+    return;
+
+  /* If the current period is about to end its interrupt may
+     already be pending, which would then be taken for the
+     one-shot.  Just keep ticking this time. */
+  const unsigned first = pit_read_count (0);
+  if (first < tick_count / 16 || first > tick_count)
+    return;
+
+  const int64_t max_ticks = 1 + (UINT16_MAX - first) / tick_count;
+  int64_t next = sleep_next_event (ticks + max_ticks);
+  next = thread_next_sched_event (ticks, next);
+  next = workqueue_next_event (next);
+  if (next - ticks < 2)
+    return;
+
+  oneshot_ticks = next - ticks;
+  oneshot_first = first;
+  oneshot_count = first + (oneshot_ticks - 1) * tick_count;
+  pit_configure_oneshot (oneshot_count);
+}
+
+/* Called by schedule(), with interrupts off, when the BSP
+   switches from its idle thread to another thread, which may
+   happen straight from an interrupt handler.  If the one-shot
+   armed by timer_idle_enter() is still pending, brings TICKS up to
+   date and moves the one-shot to the next tick boundary, so that
+   the thread gets its timer interrupts again. */
+void
+timer_idle_exit (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (oneshot_ticks < 2)
+    return;
+
+  /* Read the counter before the output: once the count has run
+     out the counter wraps around, but then the output is high and
+     the pending interrupt takes care of everything. */
+  const unsigned left = pit_read_count (0);
+  if (pit_output_high (0) || left > oneshot_count)
+    return;
+
+  const unsigned elapsed = oneshot_count - left;
+  const int crossed = elapsed < oneshot_first
+                      ? 0 : 1 + (elapsed - oneshot_first) / tick_count;
+  const unsigned next_boundary = oneshot_first + crossed * tick_count;
+
+  ticks += crossed;
+  skipped_ticks += crossed;
+  thread_account_skipped_ticks (crossed);
+
+  oneshot_ticks = 1;
+  oneshot_count = next_boundary - elapsed;
+  pit_configure_oneshot (oneshot_count);
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) 
 {
-  printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  if (timer_tickless)
+    printf ("Timer: %"PRId64" ticks, %"PRId64" skipped while idle\n",
+            timer_ticks (), skipped_ticks);
+  else
+    printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
 
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
+  if (oneshot_ticks != 0)
+    {
+      /* The one-shot armed by timer_idle_enter() went off: account
+         for the ticks it stood in for and go back to ticking. */
+      const int skipped = oneshot_ticks - 1;
+
+      oneshot_ticks = 0;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+
+      ticks += skipped;
+      skipped_ticks += skipped;
+      thread_account_skipped_ticks (skipped);
+    }
+
   ticks++;
 
   thread_tick ();
-  thread_sleep_tick ();
+  softirq_raise (SOFTIRQ_TIMER);
+  softirq_raise (SOFTIRQ_WORK);
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -2,6 +2,7 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -11,6 +12,10 @@
 void timer_init (void);
 void timer_calibrate (void);
 
+/* Time-stamp counter. */
+extern uint64_t timer_tsc_hz;
+uint64_t timer_cycles_to_us (uint64_t cycles);
+
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
 
@@ -25,6 +30,11 @@ void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
+/* Tickless idle. */
+extern bool timer_tickless;
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
@@ -0,0 +1,64 @@
+/* execbench.c
+
+   Stresses the kernel's process table, open inode list and
+   shared executable table, which every exec() and wait() looks
+   up, by keeping many processes exec'ing at once.
+
+   Starts PROCS children at the same time.  Each of them execs and
+   waits for ROUNDS short-lived grandchildren, one after the
+   other.  Run it in a kernel built with `make LOCK_PROFILE=1' to
+   see how long those lookups had to wait for each other, e.g.
+   `pintos -- -q run "execbench 16 20"'. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+int
+main (int argc, char *argv[])
+{
+  char cmd[64];
+  pid_t pids[32];
+  struct rusage ru;
+  int procs, rounds, failed = 0;
+  int i;
+
+  /* A grandchild does nothing. */
+  if (argc == 2 && !strcmp (argv[1], "leaf"))
+    return 0;
+
+  /* A child execs ROUNDS grandchildren in turn. */
+  if (argc == 3 && !strcmp (argv[1], "child"))
+    {
+      rounds = atoi (argv[2]);
+      for (i = 0; i < rounds; i++)
+        if (wait (exec ("execbench leaf")) != 0)
+          failed++;
+      return failed;
+    }
+
+  procs = argc > 1 ? atoi (argv[1]) : 8;
+  rounds = argc > 2 ? atoi (argv[2]) : 10;
+  if (procs < 1 || procs > (int) (sizeof pids / sizeof *pids) || rounds < 1)
+    {
+      printf ("usage: execbench [procs (1-32)] [rounds]\n");
+      return EXIT_FAILURE;
+    }
+
+  snprintf (cmd, sizeof cmd, "execbench child %d", rounds);
+  for (i = 0; i < procs; i++)
+    pids[i] = exec (cmd);
+  for (i = 0; i < procs; i++)
+    {
+      int status = pids[i] != PID_ERROR ? wait (pids[i]) : -1;
+      if (status != 0)
+        failed += status > 0 ? status : rounds;
+    }
+
+  getrusage (RUSAGE_SELF, &ru);
+  printf ("execbench: %d processes x %d execs, %d failed, "
+          "%llu us kernel time in the parent\n",
+          procs, rounds, failed, (unsigned long long) ru.ru_stime_us);
+  return failed != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -5,7 +5,11 @@
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/spinlock.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -54,14 +58,58 @@ byte_to_sector (const struct inode *inode, off_t pos)
 }
 
 /* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
+   returns the same `struct inode'.  Searched far more often than
+   changed, so protected by a reader-writer lock. */
 static struct list open_inodes;
+static struct rwlock open_inodes_lock;
+
+/* Protects the `open_cnt' of every inode, which openers change
+   while holding open_inodes_lock only for reading, or not at
+   all. */
+static struct spinlock open_cnt_lock = SPINLOCK_INITIALIZER ("inode open_cnt");
+
+/* Cache of in-memory inodes. */
+static struct kmem_cache inode_cache
+  = KMEM_CACHE_INITIALIZER (inode_cache, "inode", struct inode, NULL);
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  rwlock_init (&open_inodes_lock);
+}
+
+/* Adds DELTA to INODE's open count and returns the new count. */
+static int
+add_open_cnt (struct inode *inode, int delta)
+{
+  enum intr_level old_level = intr_disable ();
+  int cnt;
+
+  spinlock_acquire (&open_cnt_lock);
+  cnt = inode->open_cnt += delta;
+  spinlock_release (&open_cnt_lock);
+  intr_set_level (old_level);
+
+  return cnt;
+}
+
+/* Returns the open inode for SECTOR, or a null pointer if there
+   is none.  open_inodes_lock must be held. */
+static struct inode *
+find_open_inode (block_sector_t sector)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+       e = list_next (e)) 
+    {
+      struct inode *inode = list_entry (e, struct inode, elem);
+      if (inode->sector == sector) 
+        return inode;
+    }
+  return NULL;
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -111,33 +159,38 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
-  struct inode *inode;
+  struct inode *inode, *open;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
-    {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
-    }
+  rwlock_acquire_read (&open_inodes_lock);
+  open = inode_reopen (find_open_inode (sector));
+  rwlock_release_read (&open_inodes_lock);
+  if (open != NULL)
+    return open;
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (&inode_cache);
   if (inode == NULL)
     return NULL;
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize, without holding the lock across the disk read. */
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
   block_read (fs_device, inode->sector, &inode->data);
+
+  /* Another thread may have opened it meanwhile. */
+  rwlock_acquire_write (&open_inodes_lock);
+  open = inode_reopen (find_open_inode (sector));
+  if (open == NULL)
+    list_push_front (&open_inodes, &inode->elem);
+  rwlock_release_write (&open_inodes_lock);
+  if (open != NULL)
+    {
+      kmem_cache_free (&inode_cache, inode);
+      return open;
+    }
   return inode;
 }
 
@@ -146,7 +199,7 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    add_open_cnt (inode, 1);
   return inode;
 }
 
@@ -163,16 +216,23 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode) 
 {
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  /* Release resources if this was the last opener.  The count
+     only drops to 0 with the write lock held, so that inode_open()
+     cannot find INODE at the same time. */
+  rwlock_acquire_write (&open_inodes_lock);
+  last = add_open_cnt (inode, -1) == 0;
+  if (last)
+    list_remove (&inode->elem);
+  rwlock_release_write (&open_inodes_lock);
+
+  if (last)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
@@ -181,7 +241,7 @@ inode_close (struct inode *inode)
                             bytes_to_sectors (inode->data.length)); 
         }
 
-      free (inode); 
+      kmem_cache_free (&inode_cache, inode);
     }
 }
 
@@ -0,0 +1,211 @@
+#include "pairing-heap.h"
+#include "../debug.h"
+
+/* A pairing heap [Fredman et al., "The pairing heap: a new form
+   of self-adjusting heap", 1986] is a tree in which every element
+   is at least as great as its children.  The children of an
+   element are kept in a doubly linked list, first child first.
+
+   Two heaps are melded by making the lesser root the first child
+   of the greater one.  Removing an element melds its children in
+   two passes: first in pairs from left to right, then the pairs
+   from right to left into one heap, which is what makes removal
+   take O(lg n) amortized time. */
+
+/* Returns true if A must leave HEAP before B. */
+static bool
+before (const struct pheap *heap, const struct pheap_elem *a,
+        const struct pheap_elem *b)
+{
+  if (heap->less (b, a, heap->aux))
+    return true;
+  if (heap->less (a, b, heap->aux))
+    return false;
+  return a->seq < b->seq;
+}
+
+/* Melds the heaps rooted at A and B, both non-null, and returns
+   the root of the result.  The sibling links of A and B are
+   ignored. */
+static struct pheap_elem *
+meld (const struct pheap *heap, struct pheap_elem *a, struct pheap_elem *b)
+{
+  if (before (heap, b, a))
+    {
+      struct pheap_elem *t = a;
+      a = b;
+      b = t;
+    }
+
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  b->prev = a;
+  a->child = b;
+
+  a->next = a->prev = NULL;
+  return a;
+}
+
+/* Melds the list of siblings starting at FIRST, which must not be
+   null, into one heap and returns its root. */
+static struct pheap_elem *
+meld_siblings (const struct pheap *heap, struct pheap_elem *first)
+{
+  struct pheap_elem *pairs = NULL, *root;
+
+  /* First pass: meld pairs from left to right, stacking the
+     results through their `next' links. */
+  while (first != NULL)
+    {
+      struct pheap_elem *a = first, *b = a->next, *pair;
+
+      if (b != NULL)
+        {
+          first = b->next;
+          pair = meld (heap, a, b);
+        }
+      else
+        {
+          first = NULL;
+          pair = a;
+          pair->prev = NULL;
+        }
+      pair->next = pairs;
+      pairs = pair;
+    }
+
+  /* Second pass: meld the pairs from right to left. */
+  root = pairs;
+  pairs = pairs->next;
+  root->next = NULL;
+  while (pairs != NULL)
+    {
+      struct pheap_elem *pair = pairs;
+      pairs = pairs->next;
+      root = meld (heap, root, pair);
+    }
+  return root;
+}
+
+/* Takes ELEM, with its children, out of HEAP, melds its children
+   back in and leaves ELEM unlinked.  Does not change HEAP's
+   size. */
+static void
+cut (struct pheap *heap, struct pheap_elem *elem)
+{
+  struct pheap_elem *children = elem->child;
+
+  if (elem == heap->root)
+    heap->root = NULL;
+  else
+    {
+      /* ELEM's `prev' is its parent iff ELEM is the first child. */
+      if (elem->prev->child == elem)
+        elem->prev->child = elem->next;
+      else
+        elem->prev->next = elem->next;
+      if (elem->next != NULL)
+        elem->next->prev = elem->prev;
+    }
+
+  if (children != NULL)
+    {
+      struct pheap_elem *sub = meld_siblings (heap, children);
+      heap->root = heap->root != NULL ? meld (heap, heap->root, sub) : sub;
+    }
+
+  elem->child = elem->next = elem->prev = NULL;
+}
+
+/* Initializes HEAP as an empty heap ordered by LESS given
+   auxiliary data AUX. */
+void
+pheap_init (struct pheap *heap, pheap_less_func *less, void *aux)
+{
+  ASSERT (heap != NULL);
+  ASSERT (less != NULL);
+
+  heap->root = NULL;
+  heap->size = 0;
+  heap->next_seq = 0;
+  heap->less = less;
+  heap->aux = aux;
+}
+
+/* Inserts ELEM into HEAP. */
+void
+pheap_insert (struct pheap *heap, struct pheap_elem *elem)
+{
+  ASSERT (heap != NULL);
+  ASSERT (elem != NULL);
+
+  elem->child = elem->next = elem->prev = NULL;
+  elem->seq = heap->next_seq++;
+  heap->root = heap->root != NULL ? meld (heap, heap->root, elem) : elem;
+  heap->size++;
+}
+
+/* Removes the greatest element of HEAP, which must not be empty,
+   and returns it. */
+struct pheap_elem *
+pheap_pop (struct pheap *heap)
+{
+  struct pheap_elem *top;
+
+  ASSERT (heap != NULL);
+  ASSERT (heap->size > 0);
+
+  top = heap->root;
+  cut (heap, top);
+  heap->size--;
+  return top;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+pheap_remove (struct pheap *heap, struct pheap_elem *elem)
+{
+  ASSERT (heap != NULL);
+  ASSERT (elem != NULL);
+  ASSERT (heap->size > 0);
+
+  cut (heap, elem);
+  heap->size--;
+}
+
+/* Moves ELEM, which must be in HEAP, to its place after its key
+   changed.  ELEM keeps its insertion order among equal
+   elements. */
+void
+pheap_update (struct pheap *heap, struct pheap_elem *elem)
+{
+  ASSERT (heap != NULL);
+  ASSERT (elem != NULL);
+  ASSERT (heap->size > 0);
+
+  cut (heap, elem);
+  heap->root = heap->root != NULL ? meld (heap, heap->root, elem) : elem;
+}
+
+/* Returns the greatest element of HEAP, or a null pointer if HEAP
+   is empty. */
+struct pheap_elem *
+pheap_top (const struct pheap *heap)
+{
+  return heap->root;
+}
+
+/* Returns the number of elements in HEAP. */
+size_t
+pheap_size (const struct pheap *heap)
+{
+  return heap->size;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+pheap_empty (const struct pheap *heap)
+{
+  return heap->size == 0;
+}
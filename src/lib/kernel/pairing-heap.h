@@ -0,0 +1,68 @@
+#ifndef __LIB_KERNEL_PAIRING_HEAP_H
+#define __LIB_KERNEL_PAIRING_HEAP_H
+
+/* Pairing heap.
+
+   A priority queue whose top is its greatest element.  Insertion
+   takes O(1) time, and removing the top or any other element
+   takes O(lg n) amortized time.  An element whose key changed can
+   be moved to its new place with pheap_update() in the same time.
+   Elements that compare equal leave the heap in the order they
+   were inserted.
+
+   Like lists and hash tables, the heap does not use dynamic
+   allocation.  Each structure that can be in a heap embeds a
+   struct pheap_elem member, and pheap_entry converts a pointer to
+   it back to a pointer to the structure.  Refer to
+   lib/kernel/list.h for a detailed explanation of the
+   technique. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct pheap_elem
+  {
+    struct pheap_elem *child;   /* First child, or null. */
+    struct pheap_elem *next;    /* Next sibling, or null. */
+    struct pheap_elem *prev;    /* Previous sibling, or parent if first. */
+    uint64_t seq;               /* Insertion order, to break ties. */
+  };
+
+/* Converts pointer to heap element PHEAP_ELEM into a pointer to
+   the structure that PHEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define pheap_entry(PHEAP_ELEM, STRUCT, MEMBER)                 \
+        ((STRUCT *) ((uint8_t *) &(PHEAP_ELEM)->child           \
+                     - offsetof (STRUCT, MEMBER.child)))
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or false
+   if A is greater than or equal to B. */
+typedef bool pheap_less_func (const struct pheap_elem *a,
+                              const struct pheap_elem *b,
+                              void *aux);
+
+/* Pairing heap. */
+struct pheap
+  {
+    struct pheap_elem *root;    /* Greatest element, or null if empty. */
+    size_t size;                /* Number of elements. */
+    uint64_t next_seq;          /* Insertion order of next element. */
+    pheap_less_func *less;      /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+void pheap_init (struct pheap *, pheap_less_func *, void *aux);
+void pheap_insert (struct pheap *, struct pheap_elem *);
+struct pheap_elem *pheap_pop (struct pheap *);
+void pheap_remove (struct pheap *, struct pheap_elem *);
+void pheap_update (struct pheap *, struct pheap_elem *);
+
+struct pheap_elem *pheap_top (const struct pheap *);
+size_t pheap_size (const struct pheap *);
+bool pheap_empty (const struct pheap *);
+
+#endif /* lib/kernel/pairing-heap.h */
@@ -0,0 +1,52 @@
+/* Fixed-size bitmap of 64 priority levels, used to find the
+   highest non-empty priority queue with a find-first-set
+   instead of walking every queue. */
+
+#ifndef __LIB_KERNEL_PRIORITY_BITMAP_H
+#define __LIB_KERNEL_PRIORITY_BITMAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PRIORITY_BITMAP_BITS 64
+#define __PRIORITY_BITMAP_WORD_BITS 32
+
+/* Bit N is set if priority level N is non-empty.
+   Split in two words so that the lookup only needs the 32-bit
+   bit-scan builtins (no libgcc helpers in the kernel). */
+struct priority_bitmap {
+  uint32_t words[PRIORITY_BITMAP_BITS / __PRIORITY_BITMAP_WORD_BITS];
+};
+
+static inline void priority_bitmap_init (struct priority_bitmap *b) {
+  b->words[0] = 0;
+  b->words[1] = 0;
+}
+
+static inline void priority_bitmap_set (struct priority_bitmap *b, int pri) {
+  b->words[pri / __PRIORITY_BITMAP_WORD_BITS] |= 1u << (pri % __PRIORITY_BITMAP_WORD_BITS);
+}
+
+static inline void priority_bitmap_clear (struct priority_bitmap *b, int pri) {
+  b->words[pri / __PRIORITY_BITMAP_WORD_BITS] &= ~(1u << (pri % __PRIORITY_BITMAP_WORD_BITS));
+}
+
+static inline bool priority_bitmap_test (const struct priority_bitmap *b, int pri) {
+  return (b->words[pri / __PRIORITY_BITMAP_WORD_BITS] >> (pri % __PRIORITY_BITMAP_WORD_BITS)) & 1;
+}
+
+static inline bool priority_bitmap_empty (const struct priority_bitmap *b) {
+  return b->words[0] == 0 && b->words[1] == 0;
+}
+
+/* Returns the highest set priority, or -1 if none is set. */
+static inline int priority_bitmap_highest (const struct priority_bitmap *b) {
+  if (b->words[1] != 0)
+    return 2 * __PRIORITY_BITMAP_WORD_BITS - 1 - __builtin_clz (b->words[1]);
+  if (b->words[0] != 0)
+    return __PRIORITY_BITMAP_WORD_BITS - 1 - __builtin_clz (b->words[0]);
+
+  return -1;
+}
+
+#endif
@@ -0,0 +1,314 @@
+#include "rbtree.h"
+#include "../debug.h"
+
+/* The classic red-black tree, as in [CLRS] chapter 13, with null
+   pointers instead of a sentinel node:
+
+     1. Every node is either red or black.
+     2. The root is black.
+     3. A red node has no red child.
+     4. Every path from a node down to a null child has the same
+        number of black nodes.
+
+   Together these keep the longest path from the root no more
+   than twice as long as the shortest one. */
+
+static bool
+is_red (const struct rb_node *n)
+{
+  return n != NULL && n->red;
+}
+
+/* Replaces the link from OLD's parent to OLD by one to NEW. */
+static void
+replace_child (struct rb_tree *tree, struct rb_node *old,
+               struct rb_node *new)
+{
+  struct rb_node *parent = old->parent;
+
+  if (parent == NULL)
+    tree->root = new;
+  else if (parent->left == old)
+    parent->left = new;
+  else
+    parent->right = new;
+  if (new != NULL)
+    new->parent = parent;
+}
+
+/* Rotates X's right child up into X's place. */
+static void
+rotate_left (struct rb_tree *tree, struct rb_node *x)
+{
+  struct rb_node *y = x->right;
+
+  x->right = y->left;
+  if (y->left != NULL)
+    y->left->parent = x;
+  replace_child (tree, x, y);
+  y->left = x;
+  x->parent = y;
+}
+
+/* Rotates X's left child up into X's place. */
+static void
+rotate_right (struct rb_tree *tree, struct rb_node *x)
+{
+  struct rb_node *y = x->left;
+
+  x->left = y->right;
+  if (y->right != NULL)
+    y->right->parent = x;
+  replace_child (tree, x, y);
+  y->right = x;
+  x->parent = y;
+}
+
+/* Initializes TREE as an empty tree ordered by LESS, given
+   auxiliary data AUX. */
+void
+rb_init (struct rb_tree *tree, rb_less_func *less, void *aux)
+{
+  ASSERT (tree != NULL);
+  ASSERT (less != NULL);
+
+  tree->root = NULL;
+  tree->min = NULL;
+  tree->size = 0;
+  tree->less = less;
+  tree->aux = aux;
+}
+
+/* Inserts NODE into TREE, after any nodes equal to it. */
+void
+rb_insert (struct rb_tree *tree, struct rb_node *node)
+{
+  struct rb_node *parent = NULL;
+  struct rb_node **link = &tree->root;
+  bool leftmost = true;
+
+  ASSERT (tree != NULL);
+  ASSERT (node != NULL);
+
+  while (*link != NULL)
+    {
+      parent = *link;
+      if (tree->less (node, parent, tree->aux))
+        link = &parent->left;
+      else
+        {
+          link = &parent->right;
+          leftmost = false;
+        }
+    }
+
+  node->parent = parent;
+  node->left = node->right = NULL;
+  node->red = true;
+  *link = node;
+  if (leftmost)
+    tree->min = node;
+  tree->size++;
+
+  /* Fix up a red node with a red parent, moving up the tree. */
+  while (is_red (node->parent))
+    {
+      struct rb_node *p = node->parent;
+      struct rb_node *g = p->parent;
+      struct rb_node *uncle = g->left == p ? g->right : g->left;
+
+      if (is_red (uncle))
+        {
+          p->red = uncle->red = false;
+          g->red = true;
+          node = g;
+          continue;
+        }
+
+      if (g->left == p)
+        {
+          if (p->right == node)
+            {
+              rotate_left (tree, p);
+              node = p;
+              p = node->parent;
+            }
+          rotate_right (tree, g);
+        }
+      else
+        {
+          if (p->left == node)
+            {
+              rotate_right (tree, p);
+              node = p;
+              p = node->parent;
+            }
+          rotate_left (tree, g);
+        }
+      p->red = false;
+      g->red = true;
+      break;
+    }
+  tree->root->red = false;
+}
+
+/* Returns the smallest node in the subtree rooted at N. */
+static struct rb_node *
+subtree_min (struct rb_node *n)
+{
+  while (n->left != NULL)
+    n = n->left;
+  return n;
+}
+
+/* Removes NODE, which must be in TREE, from TREE. */
+void
+rb_remove (struct rb_tree *tree, struct rb_node *node)
+{
+  struct rb_node *child, *parent;
+  bool removed_black;
+
+  ASSERT (tree != NULL);
+  ASSERT (node != NULL);
+  ASSERT (tree->size > 0);
+
+  if (tree->min == node)
+    tree->min = rb_next (node);
+
+  if (node->left == NULL || node->right == NULL)
+    {
+      /* At most one child: splice NODE out. */
+      child = node->left != NULL ? node->left : node->right;
+      parent = node->parent;
+      removed_black = !node->red;
+      replace_child (tree, node, child);
+    }
+  else
+    {
+      /* Two children: move NODE's successor, which has no left
+         child, into NODE's place. */
+      struct rb_node *succ = subtree_min (node->right);
+
+      child = succ->right;
+      removed_black = !succ->red;
+      if (succ->parent == node)
+        parent = succ;
+      else
+        {
+          parent = succ->parent;
+          replace_child (tree, succ, child);
+          succ->right = node->right;
+          succ->right->parent = succ;
+        }
+      replace_child (tree, node, succ);
+      succ->left = node->left;
+      succ->left->parent = succ;
+      succ->red = node->red;
+    }
+  tree->size--;
+
+  if (!removed_black)
+    return;
+
+  /* CHILD's side of PARENT is now one black node short. */
+  while (child != tree->root && !is_red (child))
+    {
+      if (parent->left == child)
+        {
+          struct rb_node *sib = parent->right;
+          if (is_red (sib))
+            {
+              sib->red = false;
+              parent->red = true;
+              rotate_left (tree, parent);
+              sib = parent->right;
+            }
+          if (!is_red (sib->left) && !is_red (sib->right))
+            {
+              sib->red = true;
+              child = parent;
+              parent = child->parent;
+              continue;
+            }
+          if (!is_red (sib->right))
+            {
+              sib->left->red = false;
+              sib->red = true;
+              rotate_right (tree, sib);
+              sib = parent->right;
+            }
+          sib->red = parent->red;
+          parent->red = false;
+          sib->right->red = false;
+          rotate_left (tree, parent);
+        }
+      else
+        {
+          struct rb_node *sib = parent->left;
+          if (is_red (sib))
+            {
+              sib->red = false;
+              parent->red = true;
+              rotate_right (tree, parent);
+              sib = parent->left;
+            }
+          if (!is_red (sib->left) && !is_red (sib->right))
+            {
+              sib->red = true;
+              child = parent;
+              parent = child->parent;
+              continue;
+            }
+          if (!is_red (sib->left))
+            {
+              sib->right->red = false;
+              sib->red = true;
+              rotate_left (tree, sib);
+              sib = parent->left;
+            }
+          sib->red = parent->red;
+          parent->red = false;
+          sib->left->red = false;
+          rotate_right (tree, parent);
+        }
+      child = tree->root;
+      break;
+    }
+  if (child != NULL)
+    child->red = false;
+}
+
+/* Returns the smallest node in TREE, or a null pointer if TREE
+   is empty. */
+struct rb_node *
+rb_min (const struct rb_tree *tree)
+{
+  return tree->min;
+}
+
+/* Returns the node that follows N in its tree, or a null pointer
+   if N is the greatest one. */
+struct rb_node *
+rb_next (const struct rb_node *n)
+{
+  if (n->right != NULL)
+    return subtree_min (n->right);
+
+  while (n->parent != NULL && n->parent->right == n)
+    n = n->parent;
+  return n->parent;
+}
+
+/* Returns the number of nodes in TREE. */
+size_t
+rb_size (const struct rb_tree *tree)
+{
+  return tree->size;
+}
+
+/* Returns true if TREE is empty, false otherwise. */
+bool
+rb_empty (const struct rb_tree *tree)
+{
+  return tree->size == 0;
+}
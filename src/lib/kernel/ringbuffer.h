@@ -51,6 +51,15 @@
     __RINGBUFFER_POP(buf); \
   __RINGBUFFER_PUSH(buf, val);
   
+/* Number of values in the ringbuffer. */
+#define RINGBUFFER_COUNT(buf) \
+  ({ (buf.head - buf.tail + buf.size) % buf.size; })
+
+/* The I'th value from the tail (the oldest one) without popping
+   it.  I must be less than RINGBUFFER_COUNT(buf). */
+#define RINGBUFFER_AT(buf, i) \
+  (buf.data[(buf.tail + (i)) % buf.size])
+
 /**
  * Pop value from ringbuffer.  
  * @param has_popped will be set to true if a value has been popped, false otherwise
@@ -0,0 +1,20 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+#include <stdint.h>
+
+/* Resource usage, as returned by the getrusage() system call. */
+struct rusage
+  {
+    uint64_t ru_utime_us;       /* Time spent in user mode, in us. */
+    uint64_t ru_stime_us;       /* Time spent in the kernel, in us. */
+    long long ru_pgfault;       /* # of page faults. */
+    long long ru_nvcsw;         /* # of times the CPU was given up. */
+    long long ru_nivcsw;        /* # of times the CPU was taken away. */
+  };
+
+/* Values of getrusage()'s WHO argument. */
+#define RUSAGE_SELF 0           /* All threads of the process, dead or alive. */
+#define RUSAGE_THREAD 1         /* Only the calling thread. */
+
+#endif /* lib/rusage.h */
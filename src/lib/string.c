@@ -1,5 +1,98 @@
 #include <string.h>
-#include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "debug.h"
+
+/* The block functions below move 4 bytes at a time with the x86
+   string instructions, `rep movsl' and `rep stosl', after moving
+   single bytes until the destination is 4-byte aligned.  The
+   string instructions go upward, since the direction flag is
+   clear on function entry and intr_entry clears it too.
+
+   The string and search functions below read a machine word at
+   a time once the pointer is word-aligned.  An aligned word never
+   straddles a page boundary, so reading a whole word that holds
+   the terminator or the last byte of a block cannot fault, even
+   if the rest of it lies beyond the string or block. */
+
+/* Blocks shorter than this are moved a byte at a time. */
+#define WORD_MOVE_MIN 16
+
+/* A word, which may alias any other type. */
+typedef unsigned long __attribute__ ((may_alias)) word_t;
+
+/* 0x01 and 0x80 in every byte of a word. */
+#define ONES ((unsigned long) -1 / 0xff)
+#define HIGHS (ONES * 0x80)
+
+/* Returns true if some byte of W is 0 [Mycroft, comp.lang.c,
+   1987]: subtracting 1 from a 0 byte is the only way that the
+   byte's top bit gets set when it was clear. */
+static inline bool
+has_zero (unsigned long w)
+{
+  return ((w - ONES) & ~w & HIGHS) != 0;
+}
+
+/* Returns a word with every byte set to C. */
+static inline unsigned long
+repeat_byte (unsigned char c)
+{
+  return ONES * c;
+}
+
+/* Returns true if P is aligned on a word boundary. */
+static inline bool
+word_aligned (const void *p)
+{
+  return (uintptr_t) p % sizeof (word_t) == 0;
+}
+
+/* Copies SIZE bytes from SRC to DST, going upward. */
+static inline void
+copy_up (unsigned char *dst, const unsigned char *src, size_t size)
+{
+  if (size >= WORD_MOVE_MIN)
+    {
+      size_t head = -(uintptr_t) dst % 4;
+      size_t words = (size - head) / 4;
+
+      size = (size - head) % 4;
+      asm volatile ("rep movsb"
+                    : "+D" (dst), "+S" (src), "+c" (head) : : "memory");
+      asm volatile ("rep movsl"
+                    : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+    }
+  asm volatile ("rep movsb"
+                : "+D" (dst), "+S" (src), "+c" (size) : : "memory");
+}
+
+/* Copies SIZE bytes from SRC to DST, going downward from the
+   ends of the blocks, so that overlapping blocks with DST above
+   SRC are copied correctly. */
+static inline void
+copy_down (unsigned char *dst, const unsigned char *src, size_t size)
+{
+  dst += size;
+  src += size;
+  if (size >= WORD_MOVE_MIN)
+    {
+      size_t tail = (uintptr_t) dst % 4;
+      size_t words = (size - tail) / 4;
+
+      size = (size - tail) % 4;
+      while (tail-- > 0)
+        *--dst = *--src;
+      dst -= 4;
+      src -= 4;
+      asm volatile ("std; rep movsl; cld"
+                    : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+      dst += 4;
+      src += 4;
+    }
+  while (size-- > 0)
+    *--dst = *--src;
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -12,9 +105,7 @@ memcpy (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  while (size-- > 0)
-    *dst++ = *src++;
-
+  copy_up (dst, src, size);
   return dst_;
 }
 
@@ -29,20 +120,12 @@ memmove (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  if (dst < src) 
-    {
-      while (size-- > 0)
-        *dst++ = *src++;
-    }
-  else 
-    {
-      dst += size;
-      src += size;
-      while (size-- > 0)
-        *--dst = *--src;
-    }
+  if (dst <= src || dst >= src + size)
+    copy_up (dst, src, size);
+  else
+    copy_down (dst, src, size);
 
-  return dst;
+  return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -95,9 +178,20 @@ memchr (const void *block_, int ch_, size_t size)
 {
   const unsigned char *block = block_;
   unsigned char ch = ch_;
+  unsigned long pattern = repeat_byte (ch);
 
   ASSERT (block != NULL || size == 0);
 
+  for (; size > 0 && !word_aligned (block); size--, block++)
+    if (*block == ch)
+      return (void *) block;
+
+  /* Skip whole words that don't contain CH. */
+  for (; size >= sizeof (word_t); size -= sizeof (word_t),
+         block += sizeof (word_t))
+    if (has_zero (*(const word_t *) block ^ pattern))
+      break;
+
   for (; size-- > 0; block++)
     if (*block == ch)
       return (void *) block;
@@ -113,9 +207,24 @@ char *
 strchr (const char *string, int c_) 
 {
   char c = c_;
+  unsigned long pattern = repeat_byte (c);
 
   ASSERT (string != NULL);
 
+  for (; !word_aligned (string); string++)
+    if (*string == c)
+      return (char *) string;
+    else if (*string == '\0')
+      return NULL;
+
+  /* Skip whole words that contain neither C nor a null byte. */
+  for (;; string += sizeof (word_t))
+    {
+      unsigned long w = *(const word_t *) string;
+      if (has_zero (w) || has_zero (w ^ pattern))
+        break;
+    }
+
   for (;;) 
     if (*string == c)
       return (char *) string;
@@ -281,9 +390,21 @@ memset (void *dst_, int value, size_t size)
   unsigned char *dst = dst_;
 
   ASSERT (dst != NULL || size == 0);
-  
-  while (size-- > 0)
-    *dst++ = value;
+
+  if (size >= WORD_MOVE_MIN)
+    {
+      size_t head = -(uintptr_t) dst % 4;
+      size_t words = (size - head) / 4;
+      uint32_t pattern = 0x01010101u * (unsigned char) value;
+
+      size = (size - head) % 4;
+      asm volatile ("rep stosb"
+                    : "+D" (dst), "+c" (head) : "a" (pattern) : "memory");
+      asm volatile ("rep stosl"
+                    : "+D" (dst), "+c" (words) : "a" (pattern) : "memory");
+    }
+  asm volatile ("rep stosb"
+                : "+D" (dst), "+c" (size) : "a" (value) : "memory");
 
   return dst_;
 }
@@ -296,7 +417,15 @@ strlen (const char *string)
 
   ASSERT (string != NULL);
 
-  for (p = string; *p != '\0'; p++)
+  for (p = string; !word_aligned (p); p++)
+    if (*p == '\0')
+      return p - string;
+
+  /* Skip whole words without a null byte. */
+  while (!has_zero (*(const word_t *) p))
+    p += sizeof (word_t);
+
+  for (; *p != '\0'; p++)
     continue;
   return p - string;
 }
@@ -28,7 +28,15 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_FUTEX_WAIT,             /* Wait on a word of user memory. */
+    SYS_FUTEX_WAKE,             /* Wake threads waiting on a word. */
+    SYS_THREAD_CREATE,          /* Start a thread in this process. */
+    SYS_THREAD_JOIN,            /* Wait for a thread to exit. */
+    SYS_THREAD_EXIT,            /* Terminate this thread. */
+    SYS_GETRUSAGE               /* Report CPU time and other usage. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,134 @@
+#include <synch.h>
+#include <limits.h>
+#include <syscall.h>
+
+/* Mutex states. */
+#define FREE 0                  /* Not held. */
+#define HELD 1                  /* Held, nobody waiting. */
+#define CONTENDED 2             /* Held, maybe somebody waiting. */
+
+/* Atomically sets *ADDR to NEW if it is OLD.  Returns the value
+   *ADDR had.  See [IA32-v2a] "CMPXCHG". */
+static inline unsigned
+cmpxchg (volatile unsigned *addr, unsigned old, unsigned new)
+{
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "+a" (old), "+m" (*addr)
+                : "r" (new)
+                : "memory");
+  return old;
+}
+
+/* Atomically sets *ADDR to VALUE and returns its old value. */
+static inline unsigned
+xchg (volatile unsigned *addr, unsigned value)
+{
+  asm volatile ("xchgl %0, %1"
+                : "+m" (*addr), "+r" (value)
+                :
+                : "memory");
+  return value;
+}
+
+/* Initializes MUTEX, which starts out free. */
+void
+mutex_init (struct mutex *mutex)
+{
+  mutex->state = FREE;
+}
+
+/* Acquires MUTEX, sleeping until it is available if necessary.
+   MUTEX must not already be held by the calling thread.
+
+   Taking a free mutex is a single atomic instruction.  A thread
+   that finds it held marks it CONTENDED, so that the holder knows
+   to call futex_wake() when it releases it, and sleeps.  A thread
+   that gets it after sleeping keeps it CONTENDED, because it
+   can't tell whether others are still sleeping. */
+void
+mutex_lock (struct mutex *mutex)
+{
+  unsigned state = cmpxchg (&mutex->state, FREE, HELD);
+  if (state == FREE)
+    return;
+
+  if (state != CONTENDED)
+    state = xchg (&mutex->state, CONTENDED);
+  while (state != FREE)
+    {
+      futex_wait (&mutex->state, CONTENDED);
+      state = xchg (&mutex->state, CONTENDED);
+    }
+}
+
+/* Tries to acquire MUTEX without sleeping.  Returns true if
+   successful, false if it is held. */
+bool
+mutex_trylock (struct mutex *mutex)
+{
+  return cmpxchg (&mutex->state, FREE, HELD) == FREE;
+}
+
+/* Releases MUTEX, which the calling thread must hold, and wakes
+   up one of the threads waiting for it, if any. */
+void
+mutex_unlock (struct mutex *mutex)
+{
+  if (xchg (&mutex->state, FREE) == CONTENDED)
+    futex_wake (&mutex->state, 1);
+}
+
+/* Initializes condition variable COND. */
+void
+condvar_init (struct condvar *cond)
+{
+  cond->seq = 0;
+  cond->waiters = 0;
+}
+
+/* Atomically releases MUTEX and waits for COND to be signaled,
+   then reacquires MUTEX before returning.  MUTEX must be held.
+
+   As with the kernel's condition variables, the condition must
+   be checked again after returning.  A signal sent between
+   releasing MUTEX and going to sleep changes COND->seq, which
+   makes futex_wait() return at once instead of missing it. */
+void
+condvar_wait (struct condvar *cond, struct mutex *mutex)
+{
+  const unsigned seq = cond->seq;
+
+  cond->waiters++;
+  mutex_unlock (mutex);
+  futex_wait (&cond->seq, seq);
+
+  /* Others may have been woken along with us, so we can't take
+     MUTEX as uncontended. */
+  while (xchg (&mutex->state, CONTENDED) != FREE)
+    futex_wait (&mutex->state, CONTENDED);
+  cond->waiters--;
+}
+
+/* If any threads are waiting on COND, wakes up one of them.
+   MUTEX must be held. */
+void
+condvar_signal (struct condvar *cond, struct mutex *mutex UNUSED)
+{
+  if (cond->waiters > 0)
+    {
+      cond->seq++;
+      futex_wake (&cond->seq, 1);
+    }
+}
+
+/* Wakes up all threads, if any, waiting on COND.  MUTEX must be
+   held. */
+void
+condvar_broadcast (struct condvar *cond, struct mutex *mutex UNUSED)
+{
+  if (cond->waiters > 0)
+    {
+      cond->seq++;
+      futex_wake (&cond->seq, INT_MAX);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef __LIB_USER_SYNCH_H
+#define __LIB_USER_SYNCH_H
+
+#include <stdbool.h>
+
+/* User-level mutexes and condition variables, built on the
+   futex_wait() and futex_wake() system calls.  Neither enters the
+   kernel unless some thread actually has to wait.
+
+   They work between processes too, if they are placed in a file
+   mapped with mmap() by all of them. */
+
+/* A mutex. */
+struct mutex
+  {
+    volatile unsigned state;    /* 0: free, 1: held, 2: held, may
+                                   have waiters. */
+  };
+
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+/* A condition variable. */
+struct condvar
+  {
+    volatile unsigned seq;      /* Bumped by every signal. */
+    unsigned waiters;           /* # of threads in condvar_wait(). */
+  };
+
+#define CONDVAR_INITIALIZER { 0, 0 }
+
+void condvar_init (struct condvar *);
+void condvar_wait (struct condvar *, struct mutex *);
+void condvar_signal (struct condvar *, struct mutex *);
+void condvar_broadcast (struct condvar *, struct mutex *);
+
+#endif /* lib/user/synch.h */
@@ -182,3 +182,49 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+int
+futex_wait (volatile unsigned *addr, unsigned expected)
+{
+  return syscall2 (SYS_FUTEX_WAIT, addr, expected);
+}
+
+int
+futex_wake (volatile unsigned *addr, int cnt)
+{
+  return syscall2 (SYS_FUTEX_WAKE, addr, cnt);
+}
+
+/* Where threads started by thread_create() begin: calls FUNC
+   and exits the thread if it returns. */
+static void NO_RETURN
+thread_start (void (*func) (void *aux), void *aux)
+{
+  func (aux);
+  thread_exit ();
+}
+
+tid_t
+thread_create (void (*func) (void *aux), void *aux)
+{
+  return syscall3 (SYS_THREAD_CREATE, thread_start, func, aux);
+}
+
+int
+thread_join (tid_t tid)
+{
+  return syscall1 (SYS_THREAD_JOIN, tid);
+}
+
+void
+thread_exit (void)
+{
+  syscall0 (SYS_THREAD_EXIT);
+  NOT_REACHED ();
+}
+
+int
+getrusage (int who, struct rusage *usage)
+{
+  return syscall2 (SYS_GETRUSAGE, who, usage);
+}
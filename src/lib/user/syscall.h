@@ -3,11 +3,16 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <rusage.h>
 
 /* Process identifier. */
 typedef int pid_t;
 #define PID_ERROR ((pid_t) -1)
 
+/* Thread identifier. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
 /* Map region identifier. */
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
@@ -45,4 +50,12 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+int futex_wait (volatile unsigned *addr, unsigned expected);
+int futex_wake (volatile unsigned *addr, int cnt);
+tid_t thread_create (void (*func) (void *aux), void *aux);
+int thread_join (tid_t);
+void thread_exit (void) NO_RETURN;
+int getrusage (int who, struct rusage *);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,106 @@
+/* Measures how late sleeping threads wake up when thousands of
+   them are asleep at once.
+
+   Starts THREAD_CNT threads that each sleep ITER_CNT times for a
+   random number of ticks (some of them long enough to go through
+   the upper levels of the timing wheel) and record, after each
+   wake-up, how many ticks past their deadline they got to run.
+   Prints the average and maximum lateness and a histogram.
+
+   Each thread needs a page, so run with more memory than the
+   default, e.g. `pintos -m 16 -- -q run bench-alarm-lateness'. */
+
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 2000
+#define ITER_CNT 5
+#define MAX_SLEEP 300           /* Usual sleep, in ticks. */
+#define LONG_SLEEP 5000         /* Every LONG_EVERY'th thread sleeps this long. */
+#define LONG_EVERY 50
+#define HISTOGRAM_CNT 8         /* Buckets: 0, 1, 2-3, 4-7, ..., 64+. */
+
+static thread_func sleeper;
+
+static struct semaphore done;
+static int64_t total_lateness;
+static int64_t max_lateness;
+static int64_t wakeups;
+static int64_t histogram[HISTOGRAM_CNT];
+
+void
+test_bench_alarm_lateness (void)
+{
+  int i;
+
+  sema_init (&done, 0);
+
+  msg ("Starting %d sleepers, %d sleeps each...", THREAD_CNT, ITER_CNT);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper, (void *) i) == TID_ERROR)
+        fail ("could only start %d threads, give Pintos more memory", i);
+    }
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  msg ("%"PRId64" wake-ups, average lateness %"PRId64".%02"PRId64" ticks, "
+       "maximum %"PRId64" ticks.", wakeups, total_lateness / wakeups,
+       total_lateness * 100 / wakeups % 100, max_lateness);
+  for (i = 0; i < HISTOGRAM_CNT; i++)
+    {
+      int low = i == 0 ? 0 : 1 << (i - 1);
+      if (i == HISTOGRAM_CNT - 1)
+        msg ("  %d+ ticks late: %"PRId64, low, histogram[i]);
+      else
+        msg ("  %d-%d ticks late: %"PRId64, low, (1 << i) - 1, histogram[i]);
+    }
+}
+
+static void
+record_lateness (int64_t lateness)
+{
+  enum intr_level old_level = intr_disable ();
+  int bucket = 0;
+
+  while (bucket < HISTOGRAM_CNT - 1 && lateness >= 1 << bucket)
+    bucket++;
+  histogram[bucket]++;
+
+  total_lateness += lateness;
+  if (lateness > max_lateness)
+    max_lateness = lateness;
+  wakeups++;
+
+  intr_set_level (old_level);
+}
+
+static void
+sleeper (void *id_)
+{
+  int id = (int) id_;
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      int64_t duration = id % LONG_EVERY == 0 && i == 0
+                         ? LONG_SLEEP
+                         : 1 + random_ulong () % MAX_SLEEP;
+      int64_t deadline = timer_ticks () + duration;
+
+      timer_sleep (duration);
+      record_lateness (timer_ticks () - deadline);
+    }
+
+  sema_up (&done);
+}
@@ -0,0 +1,89 @@
+/* Measures the cost of priority donation through long lock
+   chains.
+
+   The main thread, at PRI_MIN, holds lock 0.  Thread I (I = 1
+   ... DEPTH) has priority PRI_MIN + I, acquires lock I and then
+   blocks on lock I - 1, so that every new thread donates its
+   priority down the whole chain to the main thread.  The main
+   thread then checks that it got the donation, releases lock 0
+   and lets the chain unwind.  This is repeated ROUND_CNT times.
+
+   DEPTH is well beyond the nesting depth of the graded tests;
+   the main thread must still end up with the priority of the
+   last thread. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define DEPTH 60
+#define ROUND_CNT 100
+
+struct link
+  {
+    struct lock *held;          /* Lock to acquire first, if any. */
+    struct lock *wanted;        /* Lock to block on. */
+  };
+
+static thread_func link_thread;
+
+static struct lock locks[DEPTH];
+static struct link links[DEPTH + 1];
+static struct semaphore done;
+
+void
+test_bench_donate_chain (void)
+{
+  int64_t start;
+  int round, i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  thread_set_priority (PRI_MIN);
+  sema_init (&done, 0);
+  for (i = 0; i < DEPTH; i++)
+    lock_init (&locks[i]);
+  for (i = 1; i <= DEPTH; i++)
+    {
+      links[i].held = i < DEPTH ? &locks[i] : NULL;
+      links[i].wanted = &locks[i - 1];
+    }
+
+  msg ("%d rounds of a %d-deep donation chain.", ROUND_CNT, DEPTH);
+  start = timer_ticks ();
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      lock_acquire (&locks[0]);
+      for (i = 1; i <= DEPTH; i++)
+        thread_create ("link", PRI_MIN + i, link_thread, &links[i]);
+
+      if (thread_get_priority () != PRI_MIN + DEPTH)
+        fail ("main thread has priority %d instead of %d.",
+              thread_get_priority (), PRI_MIN + DEPTH);
+
+      lock_release (&locks[0]);
+      for (i = 1; i <= DEPTH; i++)
+        sema_down (&done);
+    }
+  msg ("%"PRId64" ticks.", timer_elapsed (start));
+}
+
+static void
+link_thread (void *link_)
+{
+  struct link *link = link_;
+
+  if (link->held != NULL)
+    lock_acquire (link->held);
+  lock_acquire (link->wanted);
+
+  lock_release (link->wanted);
+  if (link->held != NULL)
+    lock_release (link->held);
+  sema_up (&done);
+}
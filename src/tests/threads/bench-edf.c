@@ -0,0 +1,176 @@
+/* Measures how many deadlines periodic tasks miss under load,
+   with and without real-time reservations.
+
+   Three periodic tasks, each doing a little busy work in every
+   period, run next to HOGS_PER_CPU CPU-bound threads per CPU for
+   DURATION ticks.  In the first round the tasks are ordinary
+   threads of the same priority as the hogs and have to wait for
+   the hogs' time slices before they get to run.  In the second
+   round each of them reserves its work with thread_set_deadline()
+   and the earliest-deadline-first class runs them ahead of the
+   hogs, so they should miss (almost) no deadline at all.
+
+   Between the rounds, also checks that admission control turns
+   down a reservation of a whole CPU on top of the tasks' on a
+   single CPU. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define DURATION 1000           /* Length of each round, in ticks. */
+#define HOGS_PER_CPU 3
+#define TASK_CNT 3
+
+struct periodic_task
+  {
+    int64_t runtime;            /* Reserved ticks per period. */
+    int64_t period;             /* Period, in ticks. */
+    int64_t work;               /* Ticks of busy work per period. */
+    bool edf;                   /* Reserve RUNTIME per PERIOD? */
+    int jobs;                   /* # of periods run. */
+    int misses;                 /* # of periods whose work ended late. */
+  };
+
+static thread_func task_thread;
+static thread_func hog_thread;
+
+static struct semaphore admitted;
+static struct semaphore done;
+static volatile bool stop_hogs;
+
+static void run_round (struct periodic_task *, bool edf);
+
+void
+test_bench_edf (void)
+{
+  struct periodic_task tasks[TASK_CNT] =
+    {
+      {2, 10, 1, false, 0, 0},
+      {3, 20, 2, false, 0, 0},
+      {4, 40, 3, false, 0, 0},
+    };
+
+  sema_init (&admitted, 0);
+  sema_init (&done, 0);
+
+  msg ("%d CPUs, %d hogs per CPU, %d ticks per round.",
+       cpu_cnt, HOGS_PER_CPU, DURATION);
+  run_round (tasks, false);
+  run_round (tasks, true);
+}
+
+static void
+run_round (struct periodic_task *tasks, bool edf)
+{
+  const char *mode = edf ? "edf" : "plain";
+  int hog_cnt = HOGS_PER_CPU * cpu_cnt;
+  int total_jobs = 0, total_misses = 0;
+  int i;
+
+  stop_hogs = false;
+  for (i = 0; i < hog_cnt; i++)
+    thread_create ("hog", PRI_DEFAULT, hog_thread, NULL);
+
+  for (i = 0; i < TASK_CNT; i++)
+    {
+      char name[16];
+      tasks[i].edf = edf;
+      tasks[i].jobs = tasks[i].misses = 0;
+      snprintf (name, sizeof name, "task %d", i);
+      thread_create (name, PRI_DEFAULT, task_thread, &tasks[i]);
+    }
+
+  if (edf)
+    {
+      for (i = 0; i < TASK_CNT; i++)
+        sema_down (&admitted);
+
+      bool accepted = thread_set_deadline (100, 100);
+      msg ("edf: a whole CPU reserved on top of the tasks: %s.",
+           accepted ? "accepted" : "rejected");
+      ASSERT (cpu_cnt > 1 || !accepted);
+      thread_clear_deadline ();
+    }
+
+  for (i = 0; i < TASK_CNT; i++)
+    sema_down (&done);
+  stop_hogs = true;
+  for (i = 0; i < hog_cnt; i++)
+    sema_down (&done);
+
+  for (i = 0; i < TASK_CNT; i++)
+    {
+      struct periodic_task *t = &tasks[i];
+      msg ("%s: task %d (%"PRId64" ticks every %"PRId64"): "
+           "%d of %d deadlines missed.",
+           mode, i, t->work, t->period, t->misses, t->jobs);
+      total_jobs += t->jobs;
+      total_misses += t->misses;
+    }
+  msg ("%s: miss rate %d.%d%%.", mode,
+       total_misses * 100 / total_jobs,
+       total_misses * 1000 / total_jobs % 10);
+}
+
+static void
+task_thread (void *task_)
+{
+  struct periodic_task *task = task_;
+  int64_t deadline;
+  int i;
+
+  if (task->edf)
+    {
+      if (!thread_set_deadline (task->runtime, task->period))
+        fail ("task with %"PRId64" ticks every %"PRId64" not admitted",
+              task->runtime, task->period);
+      sema_up (&admitted);
+    }
+
+  deadline = timer_ticks () + task->period;
+  for (i = 0; i < DURATION / task->period; i++)
+    {
+      int64_t start = timer_ticks ();
+      bool met;
+
+      while (timer_elapsed (start) < task->work)
+        continue;
+
+      if (task->edf)
+        met = thread_wait_period ();
+      else
+        {
+          /* Same bookkeeping as thread_wait_period(). */
+          int64_t now = timer_ticks ();
+          int64_t release = deadline;
+
+          met = now <= deadline;
+          while (release < now)
+            release += task->period;
+          timer_sleep (release - now);
+          deadline = release + task->period;
+        }
+
+      task->jobs++;
+      if (!met)
+        task->misses++;
+    }
+
+  if (task->edf)
+    thread_clear_deadline ();
+  sema_up (&done);
+}
+
+static void
+hog_thread (void *aux UNUSED)
+{
+  while (!stop_hogs)
+    continue;
+  sema_up (&done);
+}
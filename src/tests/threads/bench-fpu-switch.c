@@ -0,0 +1,99 @@
+/* Measures what lazy FPU switching adds to a context switch.
+
+   The main thread and a partner thread ping-pong the CPU with
+   thread_yield(), first with neither of them using the FPU, then
+   with only the main thread using it, then with both.  A thread
+   that uses the FPU keeps a value in %xmm0 across every yield
+   and checks that it survives; the kernel is built without SSE,
+   so nothing else touches that register.
+
+   Threads that don't use the FPU should switch as fast as
+   before.  With one FPU user its state stays loaded and only
+   needs saving; with two, every switch also traps and restores
+   the other thread's state. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/fpu.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define YIELD_CNT 20000
+
+static thread_func partner_thread;
+static void yield_loop (bool use_fpu, unsigned pattern, bool partner);
+
+static struct semaphore partner_done;
+static volatile bool stop_partner;
+
+void
+test_bench_fpu_switch (void)
+{
+  static const char *modes[] = {"no FPU users", "one FPU user",
+                                "two FPU users"};
+  int mode;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  if (!fpu_available ())
+    {
+      msg ("CPU has no FXSAVE or SSE, skipping.");
+      return;
+    }
+
+  sema_init (&partner_done, 0);
+
+  msg ("%d yields per row.", YIELD_CNT);
+  for (mode = 0; mode < 3; mode++)
+    {
+      int64_t start;
+
+      stop_partner = false;
+      thread_create ("partner", PRI_DEFAULT, partner_thread,
+                     mode == 2 ? &mode : NULL);
+
+      start = timer_ticks ();
+      yield_loop (mode > 0, 0x12345678, false);
+      msg ("%s: %"PRId64" ticks.", modes[mode], timer_elapsed (start));
+
+      stop_partner = true;
+      sema_down (&partner_done);
+    }
+}
+
+/* Yields YIELD_CNT times, or until stop_partner is set if
+   PARTNER.  If USE_FPU, keeps PATTERN in %xmm0 meanwhile and
+   fails if another thread's FPU state shows up there. */
+static void
+yield_loop (bool use_fpu, unsigned pattern, bool partner)
+{
+  int i;
+
+  for (i = 0; partner ? !stop_partner : i < YIELD_CNT; i++)
+    {
+      unsigned seen;
+
+      if (use_fpu)
+        asm volatile ("movd %0, %%xmm0" : : "r" (pattern));
+      thread_yield ();
+      if (use_fpu)
+        {
+          asm volatile ("movd %%xmm0, %0" : "=r" (seen));
+          if (seen != pattern)
+            fail ("%%xmm0 holds %#x instead of %#x after yield.",
+                  seen, pattern);
+        }
+    }
+}
+
+static void
+partner_thread (void *use_fpu)
+{
+  yield_loop (use_fpu != NULL, 0x9abcdef0, true);
+  sema_up (&partner_done);
+}
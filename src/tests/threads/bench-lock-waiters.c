@@ -0,0 +1,91 @@
+/* Measures the cost of handing a contended lock from waiter to
+   waiter.
+
+   The main thread, at PRI_MIN, holds a lock while WAITER_CNT
+   threads of mixed priorities block on it, donating their
+   priorities to it.  It then releases the lock and every waiter
+   in turn acquires it, records its priority and releases it,
+   which wakes up the highest-priority waiter left.  This is
+   repeated ROUND_CNT times.
+
+   The waiters must get the lock in order of priority.  With the
+   waiters kept in a heap, each release costs O(lg n) instead of
+   a scan of all the waiters. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define WAITER_CNT 200
+#define ROUND_CNT 20
+
+static thread_func waiter_thread;
+
+static struct lock lock;
+static struct semaphore done;
+static int order[WAITER_CNT];
+static int order_cnt;
+
+void
+test_bench_lock_waiters (void)
+{
+  uint64_t cycles = 0;
+  int64_t start;
+  int round, i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  thread_set_priority (PRI_MIN);
+  lock_init (&lock);
+  sema_init (&done, 0);
+
+  msg ("%d rounds of %d waiters on one lock.", ROUND_CNT, WAITER_CNT);
+  start = timer_ticks ();
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      uint64_t release_tsc;
+
+      lock_acquire (&lock);
+      for (i = 0; i < WAITER_CNT; i++)
+        {
+          char name[16];
+          snprintf (name, sizeof name, "waiter %d", i);
+          thread_create (name, PRI_MIN + 1 + i * 37 % (PRI_MAX - PRI_MIN),
+                         waiter_thread, NULL);
+        }
+
+      /* Let the waiters that did not preempt us block too. */
+      timer_sleep (10);
+
+      order_cnt = 0;
+      release_tsc = rdtsc ();
+      lock_release (&lock);
+      for (i = 0; i < WAITER_CNT; i++)
+        sema_down (&done);
+      cycles += rdtsc () - release_tsc;
+
+      if (order_cnt != WAITER_CNT)
+        fail ("%d waiters got the lock instead of %d.", order_cnt, WAITER_CNT);
+      for (i = 1; i < WAITER_CNT; i++)
+        if (order[i] > order[i - 1])
+          fail ("waiter %d had priority %d, after one with %d.",
+                i, order[i], order[i - 1]);
+    }
+  msg ("%"PRId64" ticks, %"PRIu64" cycles per hand-off.",
+       timer_elapsed (start), cycles / (ROUND_CNT * WAITER_CNT));
+}
+
+static void
+waiter_thread (void *aux UNUSED)
+{
+  lock_acquire (&lock);
+  order[order_cnt++] = thread_get_priority ();
+  lock_release (&lock);
+  sema_up (&done);
+}
@@ -0,0 +1,82 @@
+/* Measures the throughput of malloc() and free() for small
+   blocks.
+
+   THREAD_CNT threads each run ROUND_CNT rounds of allocating
+   BATCH blocks of sizes between 16 and 512 bytes and freeing
+   them again.  Prints the calls per second and how many times a
+   descriptor lock was taken per call.  Run it once as is and
+   once with `-malloc-no-magazines' to compare, e.g.
+   `pintos --smp=4 -- -q -malloc-no-magazines run bench-malloc'. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 4
+#define ROUND_CNT 20000
+#define BATCH 8
+
+static thread_func worker;
+
+static struct semaphore done;
+
+void
+test_bench_malloc (void)
+{
+  struct malloc_stats before, after;
+  long long ops, locks;
+  int64_t start, elapsed;
+  int i;
+
+  sema_init (&done, 0);
+
+  msg ("%d CPUs, %d threads, magazines %s.",
+       cpu_cnt, THREAD_CNT, malloc_magazines ? "on" : "off");
+  malloc_get_stats (&before);
+  start = timer_ticks ();
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "worker %d", i);
+      thread_create (name, PRI_DEFAULT, worker, NULL);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  elapsed = timer_elapsed (start);
+  malloc_get_stats (&after);
+
+  ops = after.op_cnt - before.op_cnt;
+  locks = after.lock_cnt - before.lock_cnt;
+  if (elapsed == 0)
+    elapsed = 1;
+  msg ("%lld calls in %"PRId64" ticks, %lld calls/s.",
+       ops, elapsed, ops * TIMER_FREQ / elapsed);
+  msg ("%lld lock acquisitions, %lld.%03lld per call.",
+       locks, locks / ops, locks * 1000 / ops % 1000);
+}
+
+static void
+worker (void *aux UNUSED)
+{
+  void *blocks[BATCH];
+  int round, i;
+
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      for (i = 0; i < BATCH; i++)
+        {
+          blocks[i] = malloc (16 << (i + round) % 6);
+          if (blocks[i] == NULL)
+            fail ("malloc() failed");
+        }
+      for (i = 0; i < BATCH; i++)
+        free (blocks[i]);
+    }
+  sema_up (&done);
+}
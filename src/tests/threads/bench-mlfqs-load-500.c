@@ -0,0 +1,74 @@
+/* mlfqs-load-60 scaled up to 500 threads, for measuring how
+   much scheduler work is done with interrupts off per timer tick
+   as the number of threads grows.
+
+   Starts 500 niced threads that sleep for 10 seconds, spin for
+   20 seconds and then sleep until the end of the test, printing
+   the load average every 2 seconds.  At the end it prints the
+   largest number of thread priorities the scheduler recomputed
+   in a single tick, which should stay well below the number of
+   threads.
+
+   Each thread needs a page, so run with more memory than the
+   default, e.g. `pintos -m 8 -- -q -mlfqs run bench-mlfqs-load-500'. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static int64_t start_time;
+
+static void load_thread (void *aux);
+
+#define THREAD_CNT 500
+
+void
+test_bench_mlfqs_load_500 (void)
+{
+  int i;
+
+  ASSERT (thread_mlfqs);
+
+  start_time = timer_ticks ();
+  msg ("Starting %d niced load threads...", THREAD_CNT);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+      snprintf(name, sizeof name, "load %d", i);
+      if (thread_create (name, PRI_DEFAULT, load_thread, NULL) == TID_ERROR)
+        fail ("could only start %d threads, give Pintos more memory", i);
+    }
+  msg ("Starting threads took %d seconds.",
+       timer_elapsed (start_time) / TIMER_FREQ);
+
+  for (i = 0; i < 25; i++)
+    {
+      int64_t sleep_until = start_time + TIMER_FREQ * (2 * i + 10);
+      int load_avg;
+      timer_sleep (sleep_until - timer_ticks ());
+      load_avg = thread_get_load_avg ();
+      msg ("After %d seconds, load average=%d.%02d.",
+           i * 2, load_avg / 100, load_avg % 100);
+    }
+
+  msg ("At most %d thread priorities recomputed in one tick.",
+       mlfq_max_updates_per_tick ());
+}
+
+static void
+load_thread (void *aux UNUSED)
+{
+  int64_t sleep_time = 10 * TIMER_FREQ;
+  int64_t spin_time = sleep_time + 20 * TIMER_FREQ;
+  int64_t exit_time = spin_time + 30 * TIMER_FREQ;
+
+  thread_set_nice (20);
+  timer_sleep (sleep_time - timer_elapsed (start_time));
+  while (timer_elapsed (start_time) < spin_time)
+    continue;
+  timer_sleep (exit_time - timer_elapsed (start_time));
+}
@@ -0,0 +1,84 @@
+/* Measures how long it takes to get a zeroed user page, as the
+   page fault handler does for a new stack or data page, with and
+   without the pre-zeroed pages that the idle thread keeps.
+
+   The first phase is like pt-grow-stack: ROUND_CNT times, it
+   sleeps for a tick, leaving the CPU idle, then takes one zeroed
+   page and gives it back.  The second is like page-linear: it
+   takes up to LINEAR_PAGES zeroed pages in a row, with no idle
+   time in between, so that only the first ones come pre-zeroed.
+   Each phase reports the average cycles per page and how many
+   pages came from the pre-zeroed ones.  Compare with a run with
+   `-zero-pages=0'. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/palloc.h"
+#include "devices/timer.h"
+
+#define ROUND_CNT 100
+#define LINEAR_PAGES 256
+
+static void *pages[LINEAR_PAGES];
+
+/* Takes a zeroed user page and returns it, adding the cycles it
+   took to *CYCLES. */
+static void *
+get_zeroed_page (uint64_t *cycles)
+{
+  uint64_t start = rdtsc ();
+  void *page = palloc_get_page (PAL_USER | PAL_ZERO);
+
+  *cycles += rdtsc () - start;
+  if (page == NULL)
+    fail ("out of user pages");
+  return page;
+}
+
+/* Prints the results of the phase named NAME, which took CNT
+   pages in CYCLES, given the counters from before it. */
+static void
+report (const char *name, size_t cnt, uint64_t cycles,
+        const struct palloc_zero_stats *before)
+{
+  struct palloc_zero_stats after;
+
+  palloc_get_zero_stats (&after);
+  msg ("%s: %zu pages, %"PRIu64" cycles per page, %lld pre-zeroed.",
+       name, cnt, cycles / cnt, after.hits - before->hits);
+}
+
+void
+test_bench_page_zero (void)
+{
+  struct palloc_zero_stats before;
+  uint64_t cycles;
+  size_t cnt, i;
+
+  palloc_get_zero_stats (&before);
+  msg ("Keeping up to %zu pre-zeroed pages.", before.target);
+
+  /* Let the idle thread catch up. */
+  timer_sleep (TIMER_FREQ / 10);
+
+  /* One page at a time, with the CPU idle in between. */
+  palloc_get_zero_stats (&before);
+  cycles = 0;
+  for (i = 0; i < ROUND_CNT; i++)
+    {
+      timer_sleep (1);
+      palloc_free_page (get_zeroed_page (&cycles));
+    }
+  report ("Stack growth", ROUND_CNT, cycles, &before);
+
+  /* Many pages in a row. */
+  palloc_get_zero_stats (&before);
+  cycles = 0;
+  for (cnt = 0; cnt < LINEAR_PAGES; cnt++)
+    pages[cnt] = get_zeroed_page (&cycles);
+  report ("Linear", cnt, cycles, &before);
+  for (i = 0; i < cnt; i++)
+    palloc_free_page (pages[i]);
+}
@@ -0,0 +1,66 @@
+/* Measures page allocation latency in a fragmented kernel pool.
+
+   The main thread takes every page it can get from the kernel
+   pool, one at a time, then frees every other one, so that the
+   free pages are scattered over the whole pool.  It then times
+   ROUND_CNT allocations of each size in SIZES, freeing each one
+   again right away, and reports how many cycles an allocation
+   took on average and how many failed for lack of a large
+   enough run of free pages.
+
+   A first-fit scan of a bitmap has to walk past every used page
+   to find a free run, so its cost grows with the size of the
+   pool; the buddy allocator takes a block off a free list. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+
+#define PAGE_MAX 4096
+#define ROUND_CNT 1000
+
+static void *pages[PAGE_MAX];
+
+void
+test_bench_palloc_frag (void)
+{
+  static const size_t sizes[] = { 1, 2, 4, 16 };
+  size_t page_cnt, i, j;
+
+  for (page_cnt = 0; page_cnt < PAGE_MAX; page_cnt++)
+    {
+      pages[page_cnt] = palloc_get_page (0);
+      if (pages[page_cnt] == NULL)
+        break;
+    }
+  for (i = 1; i < page_cnt; i += 2)
+    palloc_free_page (pages[i]);
+  msg ("Freed %zu of %zu kernel pages, every other one.",
+       page_cnt / 2, page_cnt);
+
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    {
+      uint64_t cycles = 0;
+      int failed = 0;
+
+      for (j = 0; j < ROUND_CNT; j++)
+        {
+          uint64_t start = rdtsc ();
+          void *p = palloc_get_multiple (0, sizes[i]);
+          cycles += rdtsc () - start;
+
+          if (p != NULL)
+            palloc_free_multiple (p, sizes[i]);
+          else
+            failed++;
+        }
+      msg ("%zu-page allocations: %"PRIu64" cycles avg, %d of %d failed.",
+           sizes[i], cycles / ROUND_CNT, failed, ROUND_CNT);
+    }
+
+  for (i = 0; i < page_cnt; i += 2)
+    palloc_free_page (pages[i]);
+}
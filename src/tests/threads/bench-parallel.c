@@ -0,0 +1,70 @@
+/* Measures how well CPU-bound work scales with the number of
+   CPUs.
+
+   Splits a fixed amount of busy work evenly among K threads, for
+   K = 1...MAX_THREAD_CNT, and prints how many ticks each split
+   took and the speedup over K = 1.  With N CPUs the speedup
+   should grow close to linearly up to K = N and stay flat after
+   that.  Run with e.g. `pintos --smp=4 -- -q run bench-parallel'. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define WORK_CNT (1 << 27)      /* Loop iterations, all threads together. */
+#define MAX_THREAD_CNT 4
+
+static thread_func worker;
+
+static struct semaphore done;
+
+void
+test_bench_parallel (void)
+{
+  int64_t base_ticks = 0;
+  int thread_cnt;
+
+  sema_init (&done, 0);
+
+  msg ("%d CPUs, %d iterations per row.", cpu_cnt, WORK_CNT);
+  for (thread_cnt = 1; thread_cnt <= MAX_THREAD_CNT; thread_cnt++)
+    {
+      int64_t start, elapsed;
+      int i;
+
+      start = timer_ticks ();
+      for (i = 0; i < thread_cnt; i++)
+        {
+          char name[16];
+          snprintf (name, sizeof name, "worker %d", i);
+          thread_create (name, PRI_DEFAULT, worker,
+                         (void *) (WORK_CNT / thread_cnt));
+        }
+      for (i = 0; i < thread_cnt; i++)
+        sema_down (&done);
+      elapsed = timer_elapsed (start);
+
+      if (thread_cnt == 1)
+        base_ticks = elapsed;
+      msg ("%d threads: %"PRId64" ticks, speedup %"PRId64".%02"PRId64"x.",
+           thread_cnt, elapsed, base_ticks / elapsed,
+           base_ticks * 100 / elapsed % 100);
+    }
+}
+
+static void
+worker (void *iter_cnt_)
+{
+  int iter_cnt = (int) iter_cnt_;
+  volatile unsigned sum = 0;
+  int i;
+
+  for (i = 0; i < iter_cnt; i++)
+    sum += i;
+  sema_up (&done);
+}
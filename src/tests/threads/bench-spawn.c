@@ -0,0 +1,66 @@
+/* Measures how fast threads can be created and destroyed.
+
+   The main thread repeatedly creates a thread of higher
+   priority, which preempts it and exits at once, and waits for
+   it to be gone before creating the next.  Dead threads' pages
+   are recycled by thread_create(), so after the first round
+   nearly every spawn should be served from that cache instead
+   of palloc.  Run it once as is and once with
+   `-thread-no-page-cache' to compare, e.g.
+   `pintos -- -q -thread-no-page-cache run bench-spawn'. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SPAWN_CNT 20000
+#define ROUND_CNT 4
+
+static thread_func exit_thread;
+
+static struct semaphore exited;
+
+void
+test_bench_spawn (void)
+{
+  int round, i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  sema_init (&exited, 0);
+
+  msg ("%d spawns per round, page cache %s.",
+       SPAWN_CNT, thread_page_caching ? "on" : "off");
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      long long hits_before, misses_before, hits, misses;
+      int64_t start, elapsed;
+
+      thread_page_stats (&hits_before, &misses_before);
+      start = timer_ticks ();
+      for (i = 0; i < SPAWN_CNT; i++)
+        {
+          thread_create ("spawn", PRI_DEFAULT + 1, exit_thread, NULL);
+          sema_down (&exited);
+        }
+      elapsed = timer_elapsed (start);
+      thread_page_stats (&hits, &misses);
+
+      msg ("round %d: %"PRId64" ticks, %"PRId64" threads/s, "
+           "%lld pages reused, %lld allocated.", round, elapsed,
+           elapsed > 0 ? SPAWN_CNT * TIMER_FREQ / elapsed : 0,
+           hits - hits_before, misses - misses_before);
+    }
+}
+
+static void
+exit_thread (void *aux UNUSED)
+{
+  sema_up (&exited);
+}
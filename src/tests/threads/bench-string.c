@@ -0,0 +1,96 @@
+/* Measures the throughput of the block and string functions in
+   lib/string.c, for blocks of 8 bytes to 64 kB.
+
+   For each size, copies, moves, sets and measures the length of
+   a block over and over, ROUND_BYTES bytes in all, and prints the
+   rate in MB/s of each function along with that of a plain byte
+   loop copy, which is how memcpy() used to work.  The source and
+   destination are page-aligned, except that memmove() moves the
+   block down by one byte, overlapping itself. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define MAX_SIZE (64 * 1024)
+#define ROUND_BYTES (4 * 1024 * 1024)
+
+static uint8_t *src, *dst;
+
+/* Copies SIZE bytes a byte at a time. */
+static void
+byte_copy (uint8_t *d, const uint8_t *s, size_t size)
+{
+  while (size-- > 0)
+    *d++ = *s++;
+}
+
+/* Returns the rate in MB/s of moving BYTES in CYCLES. */
+static uint64_t
+rate (uint64_t bytes, uint64_t cycles)
+{
+  uint64_t us = timer_cycles_to_us (cycles);
+  return us > 0 ? bytes / us : 0;
+}
+
+void
+test_bench_string (void)
+{
+  size_t size;
+
+  src = palloc_get_multiple (PAL_ASSERT, MAX_SIZE / PGSIZE + 1);
+  dst = palloc_get_multiple (PAL_ASSERT, MAX_SIZE / PGSIZE + 1);
+  memset (src, 'x', MAX_SIZE);
+  src[MAX_SIZE] = '\0';
+
+  msg ("Rates in MB/s, %d bytes per size.", ROUND_BYTES);
+  for (size = 8; size <= MAX_SIZE; size *= 8)
+    {
+      size_t reps = ROUND_BYTES / size;
+      uint64_t bytes = (uint64_t) reps * size;
+      uint64_t start, byte_loop, copy, move, set, len;
+      size_t i;
+
+      start = rdtsc ();
+      for (i = 0; i < reps; i++)
+        byte_copy (dst, src, size);
+      byte_loop = rdtsc () - start;
+
+      start = rdtsc ();
+      for (i = 0; i < reps; i++)
+        memcpy (dst, src, size);
+      copy = rdtsc () - start;
+
+      start = rdtsc ();
+      for (i = 0; i < reps; i++)
+        memmove (src, src + 1, size);
+      move = rdtsc () - start;
+
+      start = rdtsc ();
+      for (i = 0; i < reps; i++)
+        memset (dst, i, size);
+      set = rdtsc () - start;
+
+      memset (src, 'x', MAX_SIZE);
+      src[size] = '\0';
+      start = rdtsc ();
+      for (i = 0; i < reps; i++)
+        if (strlen ((char *) src) != size)
+          fail ("strlen() returned the wrong length");
+      len = rdtsc () - start;
+      src[size] = 'x';
+
+      msg ("%5zu bytes: byte loop %"PRIu64", memcpy %"PRIu64
+           ", memmove %"PRIu64", memset %"PRIu64", strlen %"PRIu64".",
+           size, rate (bytes, byte_loop), rate (bytes, copy),
+           rate (bytes, move), rate (bytes, set), rate (bytes, len));
+    }
+
+  palloc_free_multiple (src, MAX_SIZE / PGSIZE + 1);
+  palloc_free_multiple (dst, MAX_SIZE / PGSIZE + 1);
+}
@@ -0,0 +1,83 @@
+/* Measures the cost of picking the next thread to run as the
+   number of ready threads grows.
+
+   Two threads at PRI_DEFAULT ping-pong the CPU with
+   thread_yield() while an increasing number of PRI_MIN threads
+   sit in the ready queue without ever being chosen.  With an
+   O(1) ready queue the number of ticks taken for a fixed number
+   of yields should stay roughly the same for every row. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define YIELD_CNT 20000
+#define MAX_READY_CNT 256
+
+static thread_func filler_thread;
+static thread_func partner_thread;
+
+static struct semaphore fillers_done;
+static struct semaphore partner_done;
+static volatile bool stop_partner;
+
+void
+test_bench_yield (void)
+{
+  int ready_cnt;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  sema_init (&fillers_done, 0);
+  sema_init (&partner_done, 0);
+
+  msg ("%d yields per row.", YIELD_CNT);
+  for (ready_cnt = 0; ready_cnt <= MAX_READY_CNT;
+       ready_cnt = ready_cnt == 0 ? 16 : ready_cnt * 2)
+    {
+      int64_t start;
+      int i;
+
+      for (i = 0; i < ready_cnt; i++)
+        {
+          char name[16];
+          snprintf (name, sizeof name, "filler %d", i);
+          thread_create (name, PRI_MIN, filler_thread, NULL);
+        }
+
+      stop_partner = false;
+      thread_create ("partner", PRI_DEFAULT, partner_thread, NULL);
+
+      start = timer_ticks ();
+      for (i = 0; i < YIELD_CNT; i++)
+        thread_yield ();
+      msg ("%d ready threads: %"PRId64" ticks.", ready_cnt,
+           timer_elapsed (start));
+
+      /* Let the partner and then the fillers run to completion. */
+      stop_partner = true;
+      sema_down (&partner_done);
+      for (i = 0; i < ready_cnt; i++)
+        sema_down (&fillers_done);
+    }
+}
+
+static void
+filler_thread (void *aux UNUSED)
+{
+  sema_up (&fillers_done);
+}
+
+static void
+partner_thread (void *aux UNUSED)
+{
+  while (!stop_partner)
+    thread_yield ();
+  sema_up (&partner_done);
+}
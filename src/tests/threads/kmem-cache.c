@@ -0,0 +1,99 @@
+/* Checks object caches.  Allocates objects from a cache of small
+   objects with a constructor and from a cache of large objects
+   without one, checking that no object straddles a cache line
+   and that no two overlap.  Then frees every other small object
+   and allocates as many again, which must reuse the freed,
+   still constructed, objects without running the constructor.
+   Finally frees everything, which must give all but one slab of
+   each cache back to the page allocator. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/slab.h"
+
+#define OBJ_CNT 500
+
+struct small
+  {
+    int state;                  /* Set by the constructor. */
+    int value;
+    char pad[16];
+  };
+
+struct large
+  {
+    int value;
+    char pad[96];
+  };
+
+static int ctor_cnt;
+
+static void
+small_ctor (void *small_)
+{
+  struct small *small = small_;
+
+  small->state = 42;
+  ctor_cnt++;
+}
+
+static struct kmem_cache small_cache
+  = KMEM_CACHE_INITIALIZER (small_cache, "test small", struct small,
+                            small_ctor);
+static struct kmem_cache large_cache
+  = KMEM_CACHE_INITIALIZER (large_cache, "test large", struct large, NULL);
+
+static struct small *smalls[OBJ_CNT];
+static struct large *larges[OBJ_CNT];
+
+void
+test_kmem_cache (void)
+{
+  bool straddle = false;
+  int ctor_before;
+  int i;
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      smalls[i] = kmem_cache_alloc (&small_cache);
+      larges[i] = kmem_cache_alloc (&large_cache);
+      if (smalls[i] == NULL || larges[i] == NULL)
+        fail ("out of memory after %d objects", i);
+      if ((uintptr_t) smalls[i] % CACHE_LINE_SIZE + sizeof (struct small)
+          > CACHE_LINE_SIZE
+          || (uintptr_t) larges[i] % CACHE_LINE_SIZE != 0)
+        straddle = true;
+      if (smalls[i]->state != 42)
+        fail ("small object %d is not constructed", i);
+      smalls[i]->value = i;
+      larges[i]->value = i;
+    }
+  for (i = 0; i < OBJ_CNT; i++)
+    if (smalls[i]->value != i || larges[i]->value != i)
+      fail ("object %d overlaps another one", i);
+  msg ("Allocated %d objects of each size.", OBJ_CNT);
+  if (!straddle)
+    msg ("No object straddles a cache line.");
+
+  ctor_before = ctor_cnt;
+  for (i = 0; i < OBJ_CNT; i += 2)
+    kmem_cache_free (&small_cache, smalls[i]);
+  for (i = 0; i < OBJ_CNT; i += 2)
+    {
+      smalls[i] = kmem_cache_alloc (&small_cache);
+      if (smalls[i] == NULL || smalls[i]->state != 42)
+        fail ("reallocated small object %d is not constructed", i);
+    }
+  if (ctor_cnt == ctor_before)
+    msg ("Reallocating freed objects ran no constructor.");
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      kmem_cache_free (&small_cache, smalls[i]);
+      kmem_cache_free (&large_cache, larges[i]);
+    }
+  if (small_cache.slab_cnt <= 1 && small_cache.slabs_freed > 0
+      && large_cache.slab_cnt <= 1 && large_cache.slabs_freed > 0)
+    msg ("Freeing everything gave back all but one slab of each cache.");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(kmem-cache) begin
+(kmem-cache) Allocated 500 objects of each size.
+(kmem-cache) No object straddles a cache line.
+(kmem-cache) Reallocating freed objects ran no constructor.
+(kmem-cache) Freeing everything gave back all but one slab of each cache.
+(kmem-cache) end
+EOF
+pass;
@@ -13,7 +13,14 @@
    They should receive 672, 588, 492, 408, 316, 232, 152, 92, 40,
    and 8 ticks, respectively, over 30 seconds.
 
-   (The above are computed via simulation in mlfqs.pm.) */
+   (The above are computed via simulation in mlfqs.pm.)
+
+   The cfs-* tests run the same loads under the completely fair
+   scheduler, which shares the ticks in proportion to the weights
+   that the threads' nice values map to, as computed by
+   cfs_expected_ticks in mlfqs.pm.  Each "fair" test also reports
+   the ratio of the most to the fewest ticks any thread received,
+   so that both schedulers can be compared. */
 
 #include <stdio.h>
 #include <inttypes.h>
@@ -50,6 +57,30 @@ test_mlfqs_nice_10 (void)
 {
   test_mlfqs_fair (10, 0, 1);
 }
+
+void
+test_cfs_fair_2 (void) 
+{
+  test_mlfqs_fair (2, 0, 0);
+}
+
+void
+test_cfs_fair_20 (void) 
+{
+  test_mlfqs_fair (20, 0, 0);
+}
+
+void
+test_cfs_nice_2 (void) 
+{
+  test_mlfqs_fair (2, 0, 5);
+}
+
+void
+test_cfs_nice_10 (void) 
+{
+  test_mlfqs_fair (10, 0, 1);
+}
 
 #define MAX_THREAD_CNT 20
 
@@ -70,7 +101,7 @@ test_mlfqs_fair (int thread_cnt, int nice_min, int nice_step)
   int nice;
   int i;
 
-  ASSERT (thread_mlfqs);
+  ASSERT (thread_mlfqs || thread_cfs);
   ASSERT (thread_cnt <= MAX_THREAD_CNT);
   ASSERT (nice_min >= -10);
   ASSERT (nice_step >= 0);
@@ -102,6 +133,28 @@ test_mlfqs_fair (int thread_cnt, int nice_min, int nice_step)
   
   for (i = 0; i < thread_cnt; i++)
     msg ("Thread %d received %d ticks.", i, info[i].tick_count);
+
+  if (nice_step == 0)
+    {
+      int min_ticks = info[0].tick_count;
+      int max_ticks = info[0].tick_count;
+      for (i = 1; i < thread_cnt; i++)
+        {
+          if (info[i].tick_count < min_ticks)
+            min_ticks = info[i].tick_count;
+          if (info[i].tick_count > max_ticks)
+            max_ticks = info[i].tick_count;
+        }
+      if (min_ticks > 0)
+        {
+          int ratio = max_ticks * 100 / min_ticks;
+          msg ("%s: max/min CPU share ratio %d.%02d.",
+               thread_base_sched_class ()->name, ratio / 100, ratio % 100);
+        }
+      else
+        msg ("%s: a thread received no ticks.",
+             thread_base_sched_class ()->name);
+    }
 }
 
 static void
@@ -71,6 +71,27 @@ sub mlfqs_expected_ticks {
 
 sub check_mlfqs_fair {
     my ($nice, $maxdiff) = @_;
+    check_fair_ticks ($nice, $maxdiff, [mlfqs_expected_ticks (@$nice)]);
+}
+
+# Ticks that threads with the given nice values receive over 30
+# seconds from the completely fair scheduler, in proportion to
+# the weights in threads/cfs-scheduler.c.
+sub cfs_expected_ticks {
+    my (@nice) = @_;
+    my (@weight) = map (1024 / 1.25 ** $_, @nice);
+    my ($total) = 0;
+    $total += $_ foreach @weight;
+    return map (30 * 100 * $_ / $total, @weight);
+}
+
+sub check_cfs_fair {
+    my ($nice, $maxdiff) = @_;
+    check_fair_ticks ($nice, $maxdiff, [cfs_expected_ticks (@$nice)]);
+}
+
+sub check_fair_ticks {
+    my ($nice, $maxdiff, $expected) = @_;
     our ($test);
     my (@output) = read_text_file ("$test.output");
     common_checks ("run", @output);
@@ -83,9 +104,8 @@ sub check_mlfqs_fair {
         $actual[$id] = $count;
     }
 
-    my (@expected) = mlfqs_expected_ticks (@$nice);
     mlfqs_compare ("thread", "%d",
-		   \@actual, \@expected, $maxdiff, [0, $#$nice, 1],
+		   \@actual, $expected, $maxdiff, [0, $#$nice, 1],
 		   "Some tick counts were missing or differed from those "
 		   . "expected by more than $maxdiff.");
     pass;
@@ -0,0 +1,63 @@
+/* Checks reader-writer locks.  The main thread holds a
+   reader-writer lock for reading, and another reader gets in
+   alongside it.  Then a writer blocks on the lock, and so does a
+   higher-priority reader that comes after it, because writers
+   go first.  Both donate their priorities to the main thread,
+   the only reader holding the lock.  When the main thread
+   releases it, the writer gets it before the late reader. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_rwlock (void) 
+{
+  struct rwlock rwlock;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rwlock);
+  rwlock_acquire_read (&rwlock);
+  thread_create ("reader", PRI_DEFAULT + 1, reader_thread_func, &rwlock);
+  thread_create ("writer", PRI_DEFAULT + 2, writer_thread_func, &rwlock);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 2, thread_get_priority ());
+  thread_create ("late reader", PRI_DEFAULT + 3, reader_thread_func,
+                 &rwlock);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 3, thread_get_priority ());
+  rwlock_release_read (&rwlock);
+  msg ("The writer and then the late reader must already have finished.");
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+reader_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_acquire_read (rwlock);
+  msg ("%s: got the lock for reading", thread_name ());
+  rwlock_release_read (rwlock);
+}
+
+static void
+writer_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_acquire_write (rwlock);
+  msg ("%s: got the lock for writing", thread_name ());
+  rwlock_release_write (rwlock);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock) begin
+(rwlock) reader: got the lock for reading
+(rwlock) This thread should have priority 33.  Actual priority: 33.
+(rwlock) This thread should have priority 34.  Actual priority: 34.
+(rwlock) writer: got the lock for writing
+(rwlock) late reader: got the lock for reading
+(rwlock) The writer and then the late reader must already have finished.
+(rwlock) This thread should have priority 31.  Actual priority: 31.
+(rwlock) end
+EOF
+pass;
@@ -0,0 +1,86 @@
+/* Runs softirqs the default way, with interrupts turned back on
+   after the hard interrupt, while other threads sleep and wake
+   up and delayed work comes due.  The timer softirq takes
+   sched_lock to wake the sleepers, so releasing it re-enables
+   interrupts inside the softirq, which must be allowed. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/softirq.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+#define SLEEPER_CNT 5
+#define ITER_CNT 10
+
+static struct semaphore done;
+static int wake_cnt[SLEEPER_CNT];
+
+static void
+sleeper (void *i_)
+{
+  int i = (int) i_;
+  int iter;
+
+  for (iter = 0; iter < ITER_CNT; iter++)
+    {
+      timer_sleep (i + 1);
+      wake_cnt[i]++;
+    }
+  sema_up (&done);
+}
+
+static void
+count_work (void *cnt_)
+{
+  int *cnt = cnt_;
+  (*cnt)++;
+}
+
+void
+test_softirq_intr_on (void)
+{
+  static struct work delayed[ITER_CNT];
+  struct workqueue *wq;
+  int work_cnt = 0;
+  int64_t start;
+  int i;
+
+  ASSERT (!softirq_inline);
+
+  sema_init (&done, 0);
+  for (i = 0; i < SLEEPER_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      thread_create (name, PRI_DEFAULT, sleeper, (void *) i);
+    }
+
+  wq = workqueue_create ("test", 1, PRI_DEFAULT);
+  ASSERT (wq != NULL);
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      work_init (&delayed[i], count_work, &work_cnt);
+      workqueue_queue_delayed (wq, &delayed[i], i + 1);
+    }
+
+  /* Keep the CPU busy for a while, so that softirqs interrupt
+     this thread rather than the idle thread. */
+  start = timer_ticks ();
+  while (timer_elapsed (start) < 2 * ITER_CNT)
+    continue;
+
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&done);
+  workqueue_flush (wq);
+
+  for (i = 0; i < SLEEPER_CNT; i++)
+    msg ("Sleeper %d woke up %d times.", i, wake_cnt[i]);
+  msg ("%d of %d delayed items ran.", work_cnt, ITER_CNT);
+  if (intr_get_level () == INTR_ON)
+    msg ("Interrupts are still on.");
+}
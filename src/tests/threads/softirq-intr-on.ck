@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(softirq-intr-on) begin
+(softirq-intr-on) Sleeper 0 woke up 10 times.
+(softirq-intr-on) Sleeper 1 woke up 10 times.
+(softirq-intr-on) Sleeper 2 woke up 10 times.
+(softirq-intr-on) Sleeper 3 woke up 10 times.
+(softirq-intr-on) Sleeper 4 woke up 10 times.
+(softirq-intr-on) 10 of 10 delayed items ran.
+(softirq-intr-on) Interrupts are still on.
+(softirq-intr-on) end
+EOF
+pass;
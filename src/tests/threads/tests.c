@@ -38,6 +38,27 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"cfs-fair-2", test_cfs_fair_2},
+    {"cfs-fair-20", test_cfs_fair_20},
+    {"cfs-nice-2", test_cfs_nice_2},
+    {"cfs-nice-10", test_cfs_nice_10},
+    {"workqueue", test_workqueue},
+    {"rwlock", test_rwlock},
+    {"kmem-cache", test_kmem_cache},
+    {"softirq-intr-on", test_softirq_intr_on},
+    {"bench-yield", test_bench_yield},
+    {"bench-mlfqs-load-500", test_bench_mlfqs_load_500},
+    {"bench-alarm-lateness", test_bench_alarm_lateness},
+    {"bench-parallel", test_bench_parallel},
+    {"bench-donate-chain", test_bench_donate_chain},
+    {"bench-spawn", test_bench_spawn},
+    {"bench-fpu-switch", test_bench_fpu_switch},
+    {"bench-edf", test_bench_edf},
+    {"bench-lock-waiters", test_bench_lock_waiters},
+    {"bench-palloc-frag", test_bench_palloc_frag},
+    {"bench-malloc", test_bench_malloc},
+    {"bench-string", test_bench_string},
+    {"bench-page-zero", test_bench_page_zero},
   };
 
 static const char *test_name;
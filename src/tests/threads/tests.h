@@ -32,6 +32,27 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_cfs_fair_2;
+extern test_func test_cfs_fair_20;
+extern test_func test_cfs_nice_2;
+extern test_func test_cfs_nice_10;
+extern test_func test_workqueue;
+extern test_func test_rwlock;
+extern test_func test_kmem_cache;
+extern test_func test_softirq_intr_on;
+extern test_func test_bench_yield;
+extern test_func test_bench_mlfqs_load_500;
+extern test_func test_bench_alarm_lateness;
+extern test_func test_bench_parallel;
+extern test_func test_bench_donate_chain;
+extern test_func test_bench_spawn;
+extern test_func test_bench_fpu_switch;
+extern test_func test_bench_edf;
+extern test_func test_bench_lock_waiters;
+extern test_func test_bench_palloc_frag;
+extern test_func test_bench_malloc;
+extern test_func test_bench_string;
+extern test_func test_bench_page_zero;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
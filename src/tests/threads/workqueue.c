@@ -0,0 +1,88 @@
+/* Checks the work queue API: immediate work and flushing,
+   delayed work running in order of its delay, cancelling, and
+   queueing an item that is already queued. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+#define WORK_CNT 10
+
+static int run_cnt;
+static int order[4];
+static int order_cnt;
+
+static void
+count_work (void *aux UNUSED)
+{
+  enum intr_level old_level;
+
+  /* Give the other worker a chance to run too. */
+  timer_sleep (1);
+
+  old_level = intr_disable ();
+  run_cnt++;
+  intr_set_level (old_level);
+}
+
+static void
+record_work (void *delay_)
+{
+  int delay = (int) delay_;
+  enum intr_level old_level = intr_disable ();
+  order[order_cnt++] = delay;
+  intr_set_level (old_level);
+}
+
+void
+test_workqueue (void)
+{
+  static struct work counted[WORK_CNT];
+  static struct work delayed[3];
+  static struct work doomed;
+  static const int delays[3] = { 30, 10, 20 };
+  struct workqueue_stats stats;
+  struct workqueue *wq;
+  int i;
+
+  wq = workqueue_create ("test", 2, PRI_DEFAULT);
+  ASSERT (wq != NULL);
+
+  /* Immediate work, then wait for it. */
+  for (i = 0; i < WORK_CNT; i++)
+    {
+      work_init (&counted[i], count_work, NULL);
+      workqueue_queue (wq, &counted[i]);
+    }
+  workqueue_flush (wq);
+  msg ("After flush, %d of %d items ran.", run_cnt, WORK_CNT);
+
+  /* Delayed work, queued out of order, and one item that is
+     cancelled before it is due. */
+  for (i = 0; i < 3; i++)
+    {
+      work_init (&delayed[i], record_work, (void *) delays[i]);
+      workqueue_queue_delayed (wq, &delayed[i], delays[i]);
+    }
+  work_init (&doomed, record_work, (void *) 0);
+  workqueue_queue_delayed (wq, &doomed, 15);
+  if (!workqueue_queue_delayed (wq, &delayed[0], 5))
+    msg ("Queueing a queued item again is refused.");
+  if (workqueue_cancel (&doomed))
+    msg ("Cancelled a delayed item.");
+
+  timer_sleep (50);
+  workqueue_flush (wq);
+  for (i = 0; i < order_cnt; i++)
+    msg ("Item delayed by %d ticks ran.", order[i]);
+  if (!workqueue_cancel (&delayed[0]))
+    msg ("Cancelling an item that ran does nothing.");
+
+  workqueue_get_stats (wq, &stats);
+  msg ("%lld queued, %lld run, %lld cancelled, depth %d.",
+       stats.queued, stats.run, stats.cancelled, stats.depth);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue) begin
+(workqueue) After flush, 10 of 10 items ran.
+(workqueue) Queueing a queued item again is refused.
+(workqueue) Cancelled a delayed item.
+(workqueue) Item delayed by 10 ticks ran.
+(workqueue) Item delayed by 20 ticks ran.
+(workqueue) Item delayed by 30 ticks ran.
+(workqueue) Cancelling an item that ran does nothing.
+(workqueue) 14 queued, 13 run, 1 cancelled, depth 0.
+(workqueue) end
+EOF
+pass;
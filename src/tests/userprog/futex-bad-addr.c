@@ -0,0 +1,21 @@
+/* A misaligned futex address makes futex_wait() return -1.  An
+   unmapped one must terminate the process with a -1 exit code,
+   not crash the kernel. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static volatile unsigned words[2];
+
+void
+test_main (void)
+{
+  volatile unsigned *misaligned = (volatile unsigned *) ((uintptr_t) words + 1);
+
+  msg ("misaligned: futex_wait() = %d", futex_wait (misaligned, 0));
+  msg ("misaligned: futex_wake() = %d", futex_wake (misaligned, 1));
+  futex_wait ((volatile unsigned *) NULL, 0);
+  fail ("should have exited with -1");
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-bad-addr) begin
+(futex-bad-addr) misaligned: futex_wait() = -1
+(futex-bad-addr) misaligned: futex_wake() = -1
+futex-bad-addr: exit(-1)
+EOF
+pass;
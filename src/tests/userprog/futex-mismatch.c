@@ -0,0 +1,16 @@
+/* futex_wait() on a word that does not hold the expected value
+   must return -1 right away, and futex_wake() on a word nobody
+   waits on must wake no one. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static volatile unsigned word = 5;
+
+void
+test_main (void)
+{
+  msg ("futex_wait() = %d", futex_wait (&word, 4));
+  msg ("futex_wake() = %d", futex_wake (&word, 1));
+}
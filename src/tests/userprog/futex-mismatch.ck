@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-mismatch) begin
+(futex-mismatch) futex_wait() = -1
+(futex-mismatch) futex_wake() = 0
+(futex-mismatch) end
+futex-mismatch: exit(0)
+EOF
+pass;
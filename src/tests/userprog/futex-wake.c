@@ -0,0 +1,30 @@
+/* Has a thread wait on a futex, then wakes it with futex_wake(),
+   which must report that it woke one thread. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static volatile unsigned word;
+static volatile int wait_result = 1;
+
+static void
+waiter (void *aux UNUSED)
+{
+  wait_result = futex_wait (&word, 0);
+}
+
+void
+test_main (void)
+{
+  tid_t tid = thread_create (waiter, NULL);
+  CHECK (tid != TID_ERROR, "create waiter thread");
+
+  /* The waiter blocks sooner or later, since WORD stays 0. */
+  while (futex_wake (&word, 1) == 0)
+    continue;
+  msg ("woke the waiter");
+
+  CHECK (thread_join (tid) == 0, "join waiter thread");
+  msg ("futex_wait() returned %d", wait_result);
+}
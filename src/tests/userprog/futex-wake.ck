@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-wake) begin
+(futex-wake) create waiter thread
+(futex-wake) woke the waiter
+(futex-wake) join waiter thread
+(futex-wake) futex_wait() returned 0
+(futex-wake) end
+futex-wake: exit(0)
+EOF
+pass;
@@ -0,0 +1,42 @@
+/* Spins in user mode and then makes many system calls, checking
+   with getrusage() that the first phase is charged mostly to user
+   time and the second one to kernel time. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SPIN_CNT 20000000
+#define SYSCALL_CNT 20000
+
+static void
+get_usage (struct rusage *ru)
+{
+  if (getrusage (RUSAGE_THREAD, ru) != 0)
+    fail ("getrusage() failed");
+}
+
+void
+test_main (void)
+{
+  struct rusage start, spun, called, scratch;
+  volatile int i;
+
+  CHECK (getrusage (12345, &scratch) == -1, "getrusage(bad who) = -1");
+
+  get_usage (&start);
+  for (i = 0; i < SPIN_CNT; i++)
+    continue;
+  get_usage (&spun);
+  CHECK (spun.ru_utime_us > start.ru_utime_us,
+         "spinning adds user time");
+  CHECK (spun.ru_utime_us - start.ru_utime_us
+         > spun.ru_stime_us - start.ru_stime_us,
+         "spinning adds more user time than kernel time");
+
+  for (i = 0; i < SYSCALL_CNT; i++)
+    get_usage (&scratch);
+  get_usage (&called);
+  CHECK (called.ru_stime_us > spun.ru_stime_us,
+         "system calls add kernel time");
+}
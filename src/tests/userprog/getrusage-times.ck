@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(getrusage-times) begin
+(getrusage-times) getrusage(bad who) = -1
+(getrusage-times) spinning adds user time
+(getrusage-times) spinning adds more user time than kernel time
+(getrusage-times) system calls add kernel time
+(getrusage-times) end
+getrusage-times: exit(0)
+EOF
+pass;
@@ -0,0 +1,35 @@
+/* Creates several threads in this process and joins each of
+   them.  Every thread marks that it ran, so all the marks must be
+   set once the joins are done. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+
+static volatile int ran[THREAD_CNT];
+
+static void
+thread_func (void *aux)
+{
+  ran[(int) aux] = 1;
+}
+
+void
+test_main (void)
+{
+  tid_t tids[THREAD_CNT];
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      tids[i] = thread_create (thread_func, (void *) i);
+      CHECK (tids[i] != TID_ERROR, "create thread %d", i);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK (thread_join (tids[i]) == 0, "join thread %d", i);
+  for (i = 0; i < THREAD_CNT; i++)
+    if (!ran[i])
+      fail ("thread %d did not run", i);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-create) begin
+(thread-create) create thread 0
+(thread-create) create thread 1
+(thread-create) create thread 2
+(thread-create) create thread 3
+(thread-create) join thread 0
+(thread-create) join thread 1
+(thread-create) join thread 2
+(thread-create) join thread 3
+(thread-create) end
+thread-create: exit(0)
+EOF
+pass;
@@ -0,0 +1,54 @@
+/* Exits the process while its other threads are still running:
+   one spins in user mode, one waits on a futex that is never
+   woken, and one waits to join the spinning one.  All of them
+   must go away with the process, which exits with the main
+   thread's exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static volatile unsigned never;
+static volatile int spinning, waiting, joining;
+static tid_t spinner_tid;
+
+static void
+spin (void *aux UNUSED)
+{
+  spinning = 1;
+  for (;;)
+    continue;
+}
+
+static void
+wait_forever (void *aux UNUSED)
+{
+  waiting = 1;
+  for (;;)
+    futex_wait (&never, 0);
+}
+
+static void
+join_spinner (void *aux UNUSED)
+{
+  joining = 1;
+  thread_join (spinner_tid);
+  fail ("joined a thread that never exits");
+}
+
+void
+test_main (void)
+{
+  spinner_tid = thread_create (spin, NULL);
+  if (spinner_tid == TID_ERROR
+      || thread_create (wait_forever, NULL) == TID_ERROR
+      || thread_create (join_spinner, NULL) == TID_ERROR)
+    fail ("thread_create() failed");
+
+  /* Don't let the main thread race ahead of the threads. */
+  while (!spinning || !waiting || !joining)
+    continue;
+
+  msg ("exiting with threads running");
+  exit (57);
+}
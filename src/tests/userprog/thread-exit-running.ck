@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-exit-running) begin
+(thread-exit-running) exiting with threads running
+thread-exit-running: exit(57)
+EOF
+pass;
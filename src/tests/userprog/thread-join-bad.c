@@ -0,0 +1,27 @@
+/* thread_join() must return -1 for a thread id that does not
+   belong to this process and for a thread that was joined
+   already. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static void
+do_nothing (void *aux UNUSED)
+{
+}
+
+void
+test_main (void)
+{
+  tid_t tid;
+
+  msg ("join(-1) = %d", thread_join (-1));
+  msg ("join(12345) = %d", thread_join (12345));
+
+  tid = thread_create (do_nothing, NULL);
+  if (tid == TID_ERROR)
+    fail ("thread_create() failed");
+  msg ("first join = %d", thread_join (tid));
+  msg ("second join = %d", thread_join (tid));
+}
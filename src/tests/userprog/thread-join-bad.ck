@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-join-bad) begin
+(thread-join-bad) join(-1) = -1
+(thread-join-bad) join(12345) = -1
+(thread-join-bad) first join = 0
+(thread-join-bad) second join = -1
+(thread-join-bad) end
+thread-join-bad: exit(0)
+EOF
+pass;
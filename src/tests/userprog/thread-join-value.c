@@ -0,0 +1,52 @@
+/* Threads hand their results back through memory they share
+   with the joining thread: each sums a different range into a
+   slot of its own, which the main thread reads after joining it.
+   One thread leaves through thread_exit() instead of returning,
+   which must not lose its result either. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 3
+
+struct job
+  {
+    int first, last;            /* Range to sum. */
+    int sum;                    /* Result. */
+  };
+
+static struct job jobs[THREAD_CNT] = { { 1, 10, 0 }, { 1, 100, 0 }, { 1, 1000, 0 } };
+
+static void
+sum_range (void *job_)
+{
+  struct job *job = job_;
+  int i;
+
+  job->sum = 0;
+  for (i = job->first; i <= job->last; i++)
+    job->sum += i;
+  if (job == &jobs[THREAD_CNT - 1])
+    thread_exit ();
+}
+
+void
+test_main (void)
+{
+  tid_t tids[THREAD_CNT];
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      tids[i] = thread_create (sum_range, &jobs[i]);
+      if (tids[i] == TID_ERROR)
+        fail ("thread_create() failed");
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      int result = thread_join (tids[i]);
+      msg ("join = %d, sum of %d...%d = %d",
+           result, jobs[i].first, jobs[i].last, jobs[i].sum);
+    }
+}
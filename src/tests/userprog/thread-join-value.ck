@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-join-value) begin
+(thread-join-value) join = 0, sum of 1...10 = 55
+(thread-join-value) join = 0, sum of 1...100 = 5050
+(thread-join-value) join = 0, sum of 1...1000 = 500500
+(thread-join-value) end
+thread-join-value: exit(0)
+EOF
+pass;
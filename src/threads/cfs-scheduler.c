@@ -0,0 +1,254 @@
+#include "cfs-scheduler.h"
+#include "thread.h"
+#include "cpu.h"
+#include "interrupt.h"
+
+#include <debug.h>
+#include <rbtree.h>
+
+/* Completely fair scheduling, selected with "-cfs".
+
+   Every thread accumulates virtual runtime while it runs: the CPU
+   time it receives, divided by a weight that its nice value maps
+   to.  Each CPU runs the ready thread with the least virtual
+   runtime next, so over time every thread receives CPU time in
+   proportion to its weight.  Ready threads are kept in a
+   red-black tree ordered by virtual runtime, which makes finding
+   that thread O(1) and queueing a thread O(lg n).
+
+   A thread that sleeps accumulates nothing.  When it wakes up it
+   is placed no further back than SLEEPER_CREDIT behind the
+   CPU's min_vruntime, so that an interactive thread runs soon
+   after it wakes without a long sleeper being able to hog the
+   CPU to catch up. */
+
+/* Virtual runtime of one tick at nice 0. */
+#define TICK_VRUNTIME ((uint64_t) 1 << 20)
+
+/* Weight of nice 0. */
+#define NICE_0_WEIGHT 1024
+
+/* Period in which every ready thread of a CPU should get to run
+   once, and the shortest slice a thread gets, in ticks. */
+#define SCHED_LATENCY 8
+#define MIN_GRANULARITY 1
+
+/* How far behind min_vruntime a waking thread may be placed. */
+#define SLEEPER_CREDIT (SCHED_LATENCY / 2 * TICK_VRUNTIME)
+
+/* How far ahead of a thread the running thread may be before that
+   thread, waking up, preempts it. */
+#define WAKEUP_GRANULARITY TICK_VRUNTIME
+
+#define NICE_MIN -20
+#define NICE_MAX 20
+
+/* Weights of nice -20...20.  Each step is about 1.25 times the
+   next, so that a thread gets about 10% more CPU time than one
+   with one nice more. */
+static const unsigned nice_to_weight[NICE_MAX - NICE_MIN + 1] = {
+  /* -20 */ 88761, 71755, 56483, 46273, 36291,
+  /* -15 */ 29154, 23254, 18705, 14949, 11916,
+  /* -10 */ 9548, 7620, 6100, 4904, 3906,
+  /*  -5 */ 3121, 2501, 1991, 1586, 1277,
+  /*   0 */ 1024, 820, 655, 526, 423,
+  /*   5 */ 335, 272, 215, 172, 137,
+  /*  10 */ 110, 87, 70, 56, 45,
+  /*  15 */ 36, 29, 23, 18, 15,
+  /*  20 */ 12,
+};
+
+/* Ready threads of each CPU.  MIN_VRUNTIME never decreases and
+   follows the least virtual runtime of the CPU's ready and
+   running threads.  Protected by sched_lock. */
+struct cfs_run_queue {
+  struct rb_tree tree;          /* Ordered by virtual runtime. */
+  uint64_t min_vruntime;
+  unsigned long load;           /* Sum of the weights in TREE. */
+};
+static struct cfs_run_queue run_queues[CPU_MAX];
+
+static bool vruntime_less (const struct rb_node *left, const struct rb_node *right, void *_ UNUSED) {
+  return rb_entry (left, struct cfs_thread_block, node)->vruntime
+         < rb_entry (right, struct cfs_thread_block, node)->vruntime;
+}
+
+static void cfs_scheduler_init (void) {
+  for (size_t cpu = 0; cpu < CPU_MAX; cpu++) {
+    rb_init (&run_queues[cpu].tree, vruntime_less, NULL);
+    run_queues[cpu].min_vruntime = 0;
+    run_queues[cpu].load = 0;
+  }
+}
+
+static void set_nice (struct cfs_thread_block *b, int nice) {
+  if (nice < NICE_MIN)
+    nice = NICE_MIN;
+  if (nice > NICE_MAX)
+    nice = NICE_MAX;
+
+  b->nice = nice;
+  b->weight = nice_to_weight[nice - NICE_MIN];
+}
+
+static void cfs_thread_init (struct thread *t, int priority UNUSED) {
+  set_nice (&t->cfs_thread_block, running_thread ()->cfs_thread_block.nice);
+}
+
+/* Moves MIN_VRUNTIME of CPU's run queue up to the least virtual
+   runtime of its threads. */
+static void update_min_vruntime (int cpu) {
+  struct cfs_run_queue *rq = &run_queues[cpu];
+  struct thread *cur = cpus[cpu].current;
+  uint64_t least = UINT64_MAX;
+
+  if (cur != NULL && cur->sched_class == &cfs_sched_class && !is_idle_thread (cur))
+    least = cur->cfs_thread_block.vruntime;
+  if (!rb_empty (&rq->tree)) {
+    const struct cfs_thread_block *first = rb_entry (rb_min (&rq->tree), struct cfs_thread_block, node);
+    if (first->vruntime < least)
+      least = first->vruntime;
+  }
+
+  if (least != UINT64_MAX && least > rq->min_vruntime)
+    rq->min_vruntime = least;
+}
+
+/* T's virtual runtime is relative to the min_vruntime of the CPU
+   it last ran or waited on.  Makes it relative to T->cpu's
+   instead, keeping its distance from min_vruntime. */
+static void migrate (struct thread *t) {
+  struct cfs_thread_block *b = &t->cfs_thread_block;
+
+  if (b->vruntime_cpu != t->cpu) {
+    const uint64_t from = run_queues[b->vruntime_cpu].min_vruntime;
+    const uint64_t to = run_queues[t->cpu].min_vruntime;
+    b->vruntime = b->vruntime + to > from ? b->vruntime + to - from : 0;
+    b->vruntime_cpu = t->cpu;
+  }
+}
+
+/* Gives thread T, which is becoming ready without having just
+   run, its place in RQ: a new thread starts at min_vruntime, a
+   thread that slept gets at most SLEEPER_CREDIT of credit. */
+static void place (struct cfs_run_queue *rq, struct thread *t) {
+  struct cfs_thread_block *b = &t->cfs_thread_block;
+  uint64_t floor = rq->min_vruntime > SLEEPER_CREDIT ? rq->min_vruntime - SLEEPER_CREDIT : 0;
+
+  if (!b->placed) {
+    b->vruntime = rq->min_vruntime;
+    b->vruntime_cpu = t->cpu;
+    b->placed = true;
+  } else if (b->vruntime < floor) {
+    b->vruntime = floor;
+  }
+}
+
+static void cfs_enqueue (struct thread *t) {
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
+
+  struct cfs_run_queue *rq = &run_queues[t->cpu];
+  struct cfs_thread_block *b = &t->cfs_thread_block;
+
+  if (b->placed)
+    migrate (t);
+  if (t->status != THREAD_RUNNING)
+    place (rq, t);
+
+  rb_insert (&rq->tree, &b->node);
+  rq->load += b->weight;
+}
+
+static void cfs_dequeue (struct thread *t) {
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
+
+  struct cfs_run_queue *rq = &run_queues[t->cpu];
+  rb_remove (&rq->tree, &t->cfs_thread_block.node);
+  rq->load -= t->cfs_thread_block.weight;
+}
+
+static struct thread * cfs_pick_next (int cpu) {
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
+
+  struct cfs_run_queue *rq = &run_queues[cpu];
+  if (rb_empty (&rq->tree))
+    return NULL;
+
+  struct cfs_thread_block *b = rb_entry (rb_min (&rq->tree), struct cfs_thread_block, node);
+  struct thread *t = rb_entry (rb_min (&rq->tree), struct thread, cfs_thread_block.node);
+  rb_remove (&rq->tree, &b->node);
+  rq->load -= b->weight;
+  b->slice_ticks = 0;
+  update_min_vruntime (cpu);
+
+  return t;
+}
+
+/* Returns T's share of SCHED_LATENCY, given the weight of the
+   threads waiting in RQ, in ticks. */
+static int ideal_slice (const struct cfs_run_queue *rq, const struct cfs_thread_block *b) {
+  const int slice = SCHED_LATENCY * b->weight / (rq->load + b->weight);
+  return slice > MIN_GRANULARITY ? slice : MIN_GRANULARITY;
+}
+
+/* Charges running thread T for a tick and preempts it once it has
+   had its share of the CPU and another thread is waiting.  This
+   replaces the fixed TIME_SLICE. */
+static bool cfs_tick (struct thread *t) {
+  struct cfs_thread_block *b = &t->cfs_thread_block;
+  struct cfs_run_queue *rq = &run_queues[t->cpu];
+
+  migrate (t);
+  b->vruntime += TICK_VRUNTIME * NICE_0_WEIGHT / b->weight;
+  b->slice_ticks++;
+  update_min_vruntime (t->cpu);
+
+  return !rb_empty (&rq->tree) && b->slice_ticks >= ideal_slice (rq, b);
+}
+
+/* A ready thread preempts if it is far enough behind. */
+static bool cfs_yield_check (struct thread *cur, struct thread *t) {
+  return t->cfs_thread_block.vruntime + WAKEUP_GRANULARITY < cur->cfs_thread_block.vruntime;
+}
+
+/* Waiters wake in order of vruntime, without the preemption
+   check's granularity, which would not be transitive. */
+static bool cfs_wakes_before (struct thread *t, struct thread *u) {
+  return t->cfs_thread_block.vruntime < u->cfs_thread_block.vruntime;
+}
+
+/* Priorities do not mean anything to this scheduler, so reports
+   the default priority shifted by the niceness. */
+static int cfs_thread_priority (struct thread *t) {
+  const int pri = PRI_DEFAULT - t->cfs_thread_block.nice;
+  return pri < PRI_MIN ? PRI_MIN : pri > PRI_MAX ? PRI_MAX : pri;
+}
+
+/* The running thread is not in a run queue, so its weight can
+   change without touching the load.  The next tick charges it at
+   the new rate. */
+static void cfs_thread_set_nice (int nice) {
+  enum intr_level old_level = sched_lock_acquire ();
+  set_nice (&thread_current ()->cfs_thread_block, nice);
+  sched_lock_release (old_level);
+}
+
+static int cfs_thread_get_nice (struct thread *t) {
+  return t->cfs_thread_block.nice;
+}
+
+const struct sched_class cfs_sched_class = {
+  .name = "cfs",
+  .rank = 0,
+  .init = cfs_scheduler_init,
+  .thread_init = cfs_thread_init,
+  .enqueue = cfs_enqueue,
+  .dequeue = cfs_dequeue,
+  .pick_next = cfs_pick_next,
+  .tick = cfs_tick,
+  .yield_check = cfs_yield_check,
+  .wakes_before = cfs_wakes_before,
+  .priority = cfs_thread_priority,
+  .set_nice = cfs_thread_set_nice,
+  .get_nice = cfs_thread_get_nice,
+};
@@ -0,0 +1,21 @@
+#ifndef THREADS_CFS_SCHEDULER_H
+#define THREADS_CFS_SCHEDULER_H
+
+#include <rbtree.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Completely fair scheduler state of a thread.  Except for `nice'
+   and `weight', which belong to the thread itself, protected by
+   sched_lock. */
+struct cfs_thread_block {
+  int nice;                     /* Niceness, -20...20. */
+  unsigned weight;              /* Load weight that NICE maps to. */
+  uint64_t vruntime;            /* CPU time received, divided by weight. */
+  int vruntime_cpu;             /* CPU whose min_vruntime VRUNTIME is relative to. */
+  int slice_ticks;              /* Ticks run since last picked. */
+  bool placed;                  /* Ever been in a run queue? */
+  struct rb_node node;          /* Element in a run queue. */
+};
+
+#endif /* threads/cfs-scheduler.h */
@@ -0,0 +1,67 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Maximum number of CPUs brought up. */
+#define CPU_MAX 8
+
+struct thread;
+
+/* Per-CPU state.  Entry 0 is the bootstrap processor (BSP), the
+   others are the application processors (APs) started by
+   smp_init(). */
+struct cpu
+  {
+    int id;                             /* Index in cpus[]. */
+    uint8_t lapic_id;                   /* Local APIC ID. */
+    volatile bool started;              /* Set by the CPU once it runs threads. */
+
+    /* Owned by thread.c, protected by sched_lock. */
+    struct thread *current;             /* Running thread. */
+    struct thread *idle_thread;         /* Runs when the run queue is empty. */
+    int ready_cnt;                      /* # of threads in this CPU's run queue. */
+    unsigned thread_ticks;              /* # of timer ticks since last yield. */
+
+    /* Owned by threads/fpu.c. */
+    struct thread *fpu_owner;           /* Thread last loaded into the FPU. */
+    long long fpu_trap_cnt;             /* # of #NM traps. */
+    long long fpu_restore_cnt;          /* # of FXRSTORs. */
+    long long fpu_save_cnt;             /* # of FXSAVEs. */
+
+    /* Owned by threads/interrupt.c. */
+    bool in_external_intr;              /* Are we processing an external interrupt? */
+    bool yield_on_return;               /* Should we yield on interrupt return? */
+
+    /* Owned by threads/softirq.c. */
+    unsigned softirq_pending;           /* Bit N set if softirq N is pending. */
+    bool in_softirq;                    /* Running softirqs? */
+
+#ifdef USERPROG
+    /* Owned by userprog/pagedir.c and threads/smp.c. */
+    uint32_t *pagedir;                  /* Page directory loaded in CR3. */
+    volatile bool tlb_flush_pending;    /* Asked to flush its TLB? */
+#endif
+  };
+
+extern struct cpu cpus[CPU_MAX];
+
+/* Number of CPUs running threads.  1 until smp_init() starts the
+   APs. */
+extern int cpu_cnt;
+
+struct cpu *cpu_current (void);
+
+/* Returns the current CPU's time-stamp counter, which counts
+   clock cycles.  See [IA32-v2b] "RDTSC".  Counters of different
+   CPUs are not guaranteed to agree. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+#endif /* threads/cpu.h */
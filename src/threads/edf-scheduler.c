@@ -0,0 +1,245 @@
+#include "edf-scheduler.h"
+#include "thread.h"
+#include "cpu.h"
+#include "interrupt.h"
+#include "sleep.h"
+#include "devices/timer.h"
+
+#include <debug.h>
+#include <list.h>
+
+/* Earliest-deadline-first real-time scheduling.
+
+   A thread reserves RUNTIME ticks of CPU time out of every
+   PERIOD ticks with thread_set_deadline().  While it has budget
+   left in its current period it is in the EDF class, which
+   outranks the base class, and among EDF threads the one whose
+   period ends first runs.  A thread that uses up its budget is
+   throttled: it drops back to the base class until its next
+   period starts, so that an overrunning thread cannot starve the
+   other reservations.
+
+   Reservations are subject to admission control: their total
+   utilization may not exceed EDF_UTIL_LIMIT of each CPU.  Ready
+   threads stay in their CPU's run queue like everyone else's, so
+   on several CPUs this does not guarantee every deadline the way
+   it does on one, but it keeps the real-time load schedulable. */
+
+/* Utilizations are in parts per EDF_UTIL_UNIT. */
+#define EDF_UTIL_UNIT 1000000
+#define EDF_UTIL_LIMIT 950000       /* Per CPU, leaving some for the base class. */
+
+/* Ready EDF threads of each CPU, earliest deadline first.  These
+   and the rest of the state below are protected by sched_lock. */
+static struct list run_queues[CPU_MAX];
+
+/* Throttled threads, waiting for their next period. */
+static struct list throttled_list;
+
+/* Sum of the utilizations of all reservations. */
+static int64_t total_utilization;
+
+static void edf_scheduler_init (void) {
+  for (size_t cpu = 0; cpu < CPU_MAX; cpu++)
+    list_init (&run_queues[cpu]);
+  list_init (&throttled_list);
+  total_utilization = 0;
+}
+
+static bool deadline_less (const struct list_elem *left, const struct list_elem *right, void *_ UNUSED) {
+  const struct thread *left_t = list_entry (left, struct thread, elem);
+  const struct thread *right_t = list_entry (right, struct thread, elem);
+
+  return left_t->edf_thread_block.deadline < right_t->edf_thread_block.deadline;
+}
+
+static void edf_enqueue (struct thread *t) {
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
+  ASSERT (!t->edf_thread_block.throttled);
+
+  list_insert_ordered (&run_queues[t->cpu], &t->elem, deadline_less, NULL);
+}
+
+static void edf_dequeue (struct thread *t) {
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
+
+  list_remove (&t->elem);
+}
+
+static struct thread * edf_pick_next (int cpu) {
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
+
+  if (list_empty (&run_queues[cpu]))
+    return NULL;
+
+  return list_entry (list_pop_front (&run_queues[cpu]), struct thread, elem);
+}
+
+static bool edf_yield_check (struct thread *cur, struct thread *t) {
+  return t->edf_thread_block.deadline < cur->edf_thread_block.deadline;
+}
+
+static bool edf_wakes_before (struct thread *t, struct thread *u) {
+  return t->edf_thread_block.deadline < u->edf_thread_block.deadline;
+}
+
+/* Starts B's next period with a full budget: the first one that
+   starts no earlier than NOW, skipping those that went by.
+   Returns the tick it starts at. */
+static int64_t start_period (struct edf_thread_block *b, int64_t now) {
+  int64_t release = b->deadline;
+  if (release < now)
+    release += (now - release + b->period - 1) / b->period * b->period;
+
+  b->deadline = release + b->period;
+  b->budget = b->runtime;
+  return release;
+}
+
+/* Takes T off the throttled list, if it is on it. */
+static void unthrottle (struct thread *t) {
+  if (t->edf_thread_block.throttled) {
+    list_remove (&t->edf_thread_block.throttle_elem);
+    t->edf_thread_block.throttled = false;
+  }
+}
+
+/* Charges running thread T for a tick and throttles it once its
+   budget is gone.  Until then, T gets the usual TIME_SLICE. */
+static bool edf_tick (struct thread *t) {
+  struct edf_thread_block *b = &t->edf_thread_block;
+  if (--b->budget > 0)
+    return cpu_current ()->thread_ticks >= TIME_SLICE;
+
+  b->throttled = true;
+  list_push_back (&throttled_list, &b->throttle_elem);
+  thread_set_sched_class (t, thread_base_sched_class ());
+  return true;
+}
+
+/* Gives the throttled threads whose next period has come their
+   new budget back, and with it their place in the EDF class. */
+static void edf_system_tick (int64_t ticks) {
+  struct list_elem *e = list_begin (&throttled_list);
+  while (e != list_end (&throttled_list)) {
+    struct thread *t = list_entry (e, struct thread, edf_thread_block.throttle_elem);
+    e = list_next (e);
+
+    if (t->edf_thread_block.deadline <= ticks) {
+      unthrottle (t);
+      start_period (&t->edf_thread_block, ticks);
+      thread_set_sched_class (t, &edf_sched_class);
+    }
+  }
+}
+
+/* The next period of a throttled thread must start on time. */
+static int64_t edf_next_event (int64_t now UNUSED, int64_t limit) {
+  struct list_elem *e;
+  for (e = list_begin (&throttled_list); e != list_end (&throttled_list); e = list_next (e)) {
+    const struct thread *t = list_entry (e, struct thread, edf_thread_block.throttle_elem);
+    if (t->edf_thread_block.deadline < limit)
+      limit = t->edf_thread_block.deadline;
+  }
+
+  return limit;
+}
+
+const struct sched_class edf_sched_class = {
+  .name = "edf",
+  .rank = 1,
+  .init = edf_scheduler_init,
+  .enqueue = edf_enqueue,
+  .dequeue = edf_dequeue,
+  .pick_next = edf_pick_next,
+  .tick = edf_tick,
+  .system_tick = edf_system_tick,
+  .next_event = edf_next_event,
+  .yield_check = edf_yield_check,
+  .wakes_before = edf_wakes_before,
+};
+
+/* Reserves RUNTIME ticks of CPU time out of every PERIOD ticks
+   for the current thread, replacing its previous reservation if
+   any, and makes it a real-time thread whose first period starts
+   now.  Returns false, changing nothing, if RUNTIME or PERIOD is
+   out of range or if the reservation fails admission control. */
+bool thread_set_deadline (int64_t runtime, int64_t period) {
+  ASSERT (!intr_context ());
+
+  if (runtime <= 0 || period < runtime)
+    return false;
+
+  struct thread *cur = thread_current ();
+  struct edf_thread_block *b = &cur->edf_thread_block;
+  const int64_t utilization = runtime * EDF_UTIL_UNIT / period;
+  const int64_t now = timer_ticks ();
+
+  enum intr_level old_level = sched_lock_acquire ();
+  const int64_t new_total = total_utilization - b->utilization + utilization;
+  if (new_total > (int64_t) EDF_UTIL_LIMIT * cpu_cnt) {
+    sched_lock_release (old_level);
+    return false;
+  }
+
+  total_utilization = new_total;
+  unthrottle (cur);
+  b->runtime = runtime;
+  b->period = period;
+  b->utilization = utilization;
+  b->deadline = now + period;
+  b->budget = runtime;
+  thread_set_sched_class (cur, &edf_sched_class);
+  sched_lock_release (old_level);
+
+  return true;
+}
+
+/* Gives up the current thread's reservation, if any, making it
+   an ordinary thread of the base class again. */
+void thread_clear_deadline (void) {
+  struct thread *cur = thread_current ();
+
+  enum intr_level old_level = sched_lock_acquire ();
+  edf_thread_exit (cur);
+  thread_set_sched_class (cur, thread_base_sched_class ());
+  sched_lock_release (old_level);
+}
+
+/* Ends the current job of the current thread, which must hold a
+   reservation, and sleeps until its next period starts.  Returns
+   true if the job was done by its deadline, false if it missed
+   it, in which case the periods that went by are skipped. */
+bool thread_wait_period (void) {
+  struct thread *cur = thread_current ();
+  struct edf_thread_block *b = &cur->edf_thread_block;
+
+  ASSERT (!intr_context ());
+  ASSERT (b->runtime > 0);
+
+  const int64_t now = timer_ticks ();
+
+  enum intr_level old_level = sched_lock_acquire ();
+  const bool met = now <= b->deadline;
+  unthrottle (cur);
+  const int64_t release = start_period (b, now);
+  thread_set_sched_class (cur, &edf_sched_class);
+  sched_lock_release (old_level);
+
+  sleep_curr_thread (release);
+  return met;
+}
+
+/* Releases T's reservation, if any, when T exits. */
+void edf_thread_exit (struct thread *t) {
+  struct edf_thread_block *b = &t->edf_thread_block;
+
+  enum intr_level old_level = sched_lock_acquire ();
+  if (b->runtime > 0) {
+    unthrottle (t);
+    total_utilization -= b->utilization;
+    b->runtime = b->period = b->utilization = 0;
+    b->deadline = b->budget = 0;
+  }
+  sched_lock_release (old_level);
+}
@@ -0,0 +1,28 @@
+#ifndef THREADS_EDF_SCHEDULER_H
+#define THREADS_EDF_SCHEDULER_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+struct thread;
+
+/* Earliest-deadline-first scheduler state of a thread.  All zero
+   for a thread without a reservation.  Protected by sched_lock. */
+struct edf_thread_block {
+  int64_t runtime;                  /* Ticks of CPU time reserved per period. */
+  int64_t period;                   /* Period length, in ticks. */
+  int64_t utilization;              /* RUNTIME / PERIOD, in parts per EDF_UTIL_UNIT. */
+  int64_t deadline;                 /* End of the current period. */
+  int64_t budget;                   /* Reserved ticks left in the current period. */
+  bool throttled;                   /* Out of budget, in the base class until DEADLINE. */
+  struct list_elem throttle_elem;   /* Element in the throttled threads list. */
+};
+
+bool thread_set_deadline (int64_t runtime, int64_t period);
+void thread_clear_deadline (void);
+bool thread_wait_period (void);
+
+void edf_thread_exit (struct thread *t);
+
+#endif /* threads/edf-scheduler.h */
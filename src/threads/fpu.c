@@ -0,0 +1,219 @@
+#include "threads/fpu.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+
+/* Lazy switching of x87 FPU, MMX and SSE state.
+
+   The kernel itself is built with -msoft-float and never touches
+   these registers, so a thread's FPU state only needs to be
+   switched if the thread uses it.  Every context switch sets
+   CR0.TS, which makes the next FPU or SSE instruction raise #NM
+   (device not available).  The #NM handler then clears CR0.TS
+   and loads the thread's state, unless it is still in the
+   registers because no other thread has used this CPU's FPU
+   since.  Threads that never touch the FPU cost nothing beyond
+   the CR0 update.
+
+   A thread that used the FPU has its state saved with FXSAVE
+   when it is switched out.  Leaving it in the registers until
+   another thread wants them would save more work, but a ready
+   thread may be picked up by any CPU, and only the CPU holding
+   the registers could save them. */
+
+/* Flags in control registers 0 and 4.  See [IA32-v3a] 2.5
+   "Control Registers". */
+#define CR0_MP 0x00000002       /* Monitor coprocessor. */
+#define CR0_EM 0x00000004       /* (Floating-point) Emulation. */
+#define CR0_TS 0x00000008       /* Task switched. */
+#define CR0_NE 0x00000020       /* Numeric error (native #MF). */
+#define CR4_OSFXSR 0x00000200   /* FXSAVE, FXRSTOR and SSE enabled. */
+#define CR4_OSXMMEXCPT 0x00000400 /* #XF for SSE exceptions. */
+
+/* CPUID leaf 1 feature flags in EDX. */
+#define CPUID_FXSR (1u << 24)   /* FXSAVE and FXRSTOR. */
+#define CPUID_SSE (1u << 25)    /* SSE. */
+
+/* Size and alignment of the FXSAVE area. */
+#define FXSAVE_SIZE 512
+#define FXSAVE_ALIGN 16
+
+/* MXCSR after reset: all SIMD exceptions masked. */
+#define MXCSR_DEFAULT 0x1f80
+
+/* Does the CPU support FXSAVE and SSE? */
+static bool fpu_present;
+
+static intr_handler_func fpu_trap;
+
+static inline uint32_t
+read_cr0 (void)
+{
+  uint32_t cr0;
+  asm volatile ("movl %%cr0, %0" : "=r" (cr0));
+  return cr0;
+}
+
+static inline void
+write_cr0 (uint32_t cr0)
+{
+  asm volatile ("movl %0, %%cr0" : : "r" (cr0) : "memory");
+}
+
+/* Returns the 16-byte aligned FXSAVE area of thread T. */
+static inline void *
+fxsave_area (struct thread *t)
+{
+  return (void *) (((uintptr_t) t->fpu_area + FXSAVE_ALIGN - 1)
+                   & ~(uintptr_t) (FXSAVE_ALIGN - 1));
+}
+
+/* Enables the FPU and SSE if the CPU supports them, and installs
+   the #NM handler.  Must be called once, on the BSP, after
+   intr_init(). */
+void
+fpu_init (void) 
+{
+  uint32_t eax, ebx, ecx, edx;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  fpu_present = (edx & CPUID_FXSR) && (edx & CPUID_SSE);
+  if (!fpu_present)
+    return;
+
+  fpu_init_cpu ();
+  intr_register_int (7, 0, INTR_ON, fpu_trap,
+                     "#NM Device Not Available Exception");
+}
+
+/* Enables the FPU and SSE on the current CPU, with CR0.TS set so
+   that the first thread to use them traps. */
+void
+fpu_init_cpu (void) 
+{
+  uint32_t cr4;
+
+  if (!fpu_present)
+    return;
+
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+  asm volatile ("movl %0, %%cr4" : : "r" (cr4));
+  write_cr0 ((read_cr0 () & ~CR0_EM) | CR0_MP | CR0_NE | CR0_TS);
+  cpu_current ()->fpu_owner = NULL;
+}
+
+/* Returns true if threads can use the FPU and SSE. */
+bool
+fpu_available (void) 
+{
+  return fpu_present;
+}
+
+/* #NM handler: the running thread used the FPU for the first
+   time since it was switched in. */
+static void
+fpu_trap (struct intr_frame *f UNUSED) 
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
+  struct cpu *cpu;
+  bool fresh = false;
+
+  /* First use ever: allocate room to save the state in.  This
+     may sleep, which is fine, because CR0.TS stays set until we
+     clear it below. */
+  if (t->fpu_area == NULL) 
+    {
+      t->fpu_area = malloc (FXSAVE_SIZE + FXSAVE_ALIGN - 1);
+      if (t->fpu_area == NULL)
+        PANIC ("no memory for FPU state of thread %s", t->name);
+      fresh = true;
+    }
+
+  old_level = intr_disable ();
+  cpu = cpu_current ();
+  asm volatile ("clts");
+  cpu->fpu_trap_cnt++;
+  if (fresh) 
+    {
+      uint32_t mxcsr = MXCSR_DEFAULT;
+      asm volatile ("fninit; ldmxcsr %0" : : "m" (mxcsr));
+    }
+  else if (cpu->fpu_owner != t || t->fpu_cpu != cpu->id) 
+    {
+      asm volatile ("fxrstor %0" : : "m" (*(char (*)[FXSAVE_SIZE]) fxsave_area (t)));
+      cpu->fpu_restore_cnt++;
+    }
+  cpu->fpu_owner = t;
+  t->fpu_cpu = cpu->id;
+  intr_set_level (old_level);
+}
+
+/* Called by the scheduler on the current CPU just before it
+   switches away from CUR.  Saves CUR's FPU state if it used the
+   FPU since it was switched in, and makes the next thread to use
+   the FPU trap. */
+void
+fpu_switch_out (struct thread *cur) 
+{
+  uint32_t cr0;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!fpu_present)
+    return;
+
+  cr0 = read_cr0 ();
+  if (cr0 & CR0_TS)
+    return;
+
+  ASSERT (cpu_current ()->fpu_owner == cur);
+  asm volatile ("fxsave %0" : "=m" (*(char (*)[FXSAVE_SIZE]) fxsave_area (cur)));
+  cpu_current ()->fpu_save_cnt++;
+  write_cr0 (cr0 | CR0_TS);
+}
+
+/* Frees the FPU state of the running thread, which is exiting.
+   The registers are abandoned first, so that switching away from
+   the thread won't save them into the freed memory. */
+void
+fpu_thread_exit (void) 
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
+  void *area;
+
+  old_level = intr_disable ();
+  if (fpu_present)
+    write_cr0 (read_cr0 () | CR0_TS);
+  area = t->fpu_area;
+  t->fpu_area = NULL;
+  intr_set_level (old_level);
+
+  free (area);
+}
+
+/* Prints FPU statistics. */
+void
+fpu_print_stats (void) 
+{
+  long long trap_cnt = 0, restore_cnt = 0, save_cnt = 0;
+  int i;
+
+  if (!fpu_present)
+    return;
+
+  for (i = 0; i < cpu_cnt; i++) 
+    {
+      trap_cnt += cpus[i].fpu_trap_cnt;
+      restore_cnt += cpus[i].fpu_restore_cnt;
+      save_cnt += cpus[i].fpu_save_cnt;
+    }
+  printf ("FPU: %lld traps, %lld restores, %lld saves\n",
+          trap_cnt, restore_cnt, save_cnt);
+}
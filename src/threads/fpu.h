@@ -0,0 +1,17 @@
+#ifndef THREADS_FPU_H
+#define THREADS_FPU_H
+
+#include <stdbool.h>
+
+struct thread;
+
+void fpu_init (void);
+void fpu_init_cpu (void);
+bool fpu_available (void);
+
+void fpu_switch_out (struct thread *);
+void fpu_thread_exit (void);
+
+void fpu_print_stats (void);
+
+#endif /* threads/fpu.h */
@@ -15,12 +15,17 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/sched-trace.h"
+#include "threads/softirq.h"
+#include "threads/workqueue.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -115,6 +120,7 @@ pintos_init (void)
 
   /* Initialize interrupt handlers. */
   intr_init ();
+  fpu_init ();
   timer_init ();
   kbd_init ();
   input_init ();
@@ -128,6 +134,12 @@ pintos_init (void)
   serial_init_queue ();
   timer_calibrate ();
 
+  /* Start the other CPUs, if any. */
+  smp_init ();
+
+  /* Start the kernel's worker threads. */
+  workqueue_init ();
+
 #ifdef FILESYS
   /* Initialize file system. */
   ide_init ();
@@ -275,6 +287,26 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-cfs"))
+        thread_cfs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-softirq-inline"))
+        softirq_inline = true;
+      else if (!strcmp (name, "-sched-trace"))
+        sched_trace_start ();
+      else if (!strcmp (name, "-malloc-no-magazines"))
+        malloc_magazines = false;
+      else if (!strcmp (name, "-thread-no-page-cache"))
+        thread_page_caching = false;
+      else if (!strcmp (name, "-zero-pages"))
+        palloc_zero_pages = atoi (value);
+      else if (!strcmp (name, "-wq-workers"))
+        {
+          system_wq_workers = atoi (value);
+          if (system_wq_workers < 1)
+            PANIC ("-wq-workers needs at least one worker");
+        }
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -283,6 +315,9 @@ parse_options (char **argv)
         PANIC ("unknown option `%s' (use -h for help)", name);
     }
 
+  if (thread_mlfqs && thread_cfs)
+    PANIC ("-mlfqs and -cfs are mutually exclusive");
+
   /* Initialize the random number generator based on the system
      time.  This has no effect if an "-rs" option was specified.
 
@@ -334,6 +369,7 @@ run_actions (char **argv)
       {"rm", 2, fsutil_rm},
       {"extract", 1, fsutil_extract},
       {"append", 2, fsutil_append},
+      {"sched-trace-save", 2, sched_trace_save},
 #endif
       {NULL, 0, NULL},
     };
@@ -383,6 +419,7 @@ usage (void)
           "Use these actions indirectly via `pintos' -g and -p options:\n"
           "  extract            Untar from scratch device into file system.\n"
           "  append FILE        Append FILE to tar file on scratch device.\n"
+          "  sched-trace-save FILE  Save the scheduler trace as FILE.\n"
 #endif
           "\nOptions:\n"
           "  -h                 Print this help message and power off.\n"
@@ -398,6 +435,14 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -cfs               Use completely fair scheduler.\n"
+          "  -tickless          Stop the timer interrupt while idle.\n"
+          "  -softirq-inline    Run deferred interrupt work with interrupts off.\n"
+          "  -sched-trace       Record scheduler events, see sched-trace.h.\n"
+          "  -malloc-no-magazines  Don't cache free malloc() blocks per CPU.\n"
+          "  -thread-no-page-cache  Don't reuse dead threads' pages.\n"
+          "  -zero-pages=N      Keep N user pages zeroed in advance (def. 64).\n"
+          "  -wq-workers=N      Run the system work queue with N threads.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
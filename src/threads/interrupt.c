@@ -6,9 +6,16 @@
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/cpu.h"
+#include "threads/softirq.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "devices/lapic.h"
 #include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/process.h"
+#endif
 
 /* Programmable Interrupt Controller (PIC) registers.
    A PC has two PICs, called the master and slave PICs, with the
@@ -43,9 +50,27 @@ static unsigned int unexpected_cnt[INTR_CNT];
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
-static bool in_external_intr;   /* Are we processing an external interrupt? */
-static bool yield_on_return;    /* Should we yield on interrupt return? */
+   interrupt returns.  Each CPU tracks this in its struct cpu.
+
+   Besides the PIC's vectors 0x20...0x2f, the vectors used by the
+   local APICs (see devices/lapic.h), 0xf0...0xff, are external
+   too. */
+#define is_external_vec(VEC) \
+        (((VEC) >= 0x20 && (VEC) <= 0x2f) || (VEC) >= 0xf0)
+
+/* Index of external vector VEC in the statistics below. */
+#define EXT_VEC_CNT 32
+#define ext_vec_idx(VEC) ((VEC) < 0xf0 ? (VEC) - 0x20 : (VEC) - 0xf0 + 16)
+
+/* Number of external interrupts taken, per CPU and vector, and
+   the time spent handling them with interrupts off. */
+static long long hard_cnt[CPU_MAX][EXT_VEC_CNT];
+static uint64_t hard_cycles[CPU_MAX][EXT_VEC_CNT];
+
+/* True once smp_init() has routed the device interrupts through
+   the I/O APIC: the PICs are then masked and interrupts are
+   acknowledged to the local APIC. */
+static bool use_apic;
 
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
@@ -83,12 +108,15 @@ intr_set_level (enum intr_level level)
   return level == INTR_ON ? intr_enable () : intr_disable ();
 }
 
-/* Enables interrupts and returns the previous interrupt status. */
+/* Enables interrupts and returns the previous interrupt status.
+   Not allowed while handling an external interrupt, but allowed
+   in softirqs, which run with interrupts on unless softirq_inline
+   is set. */
 enum intr_level
 intr_enable (void) 
 {
   enum intr_level old_level = intr_get_level ();
-  ASSERT (!intr_context ());
+  ASSERT (!cpu_current ()->in_external_intr);
 
   /* Enable interrupts by setting the interrupt flag.
 
@@ -158,6 +186,29 @@ intr_init (void)
   intr_names[19] = "#XF SIMD Floating-Point Exception";
 }
 
+/* Loads the IDT built by intr_init() on an application
+   processor. */
+void
+intr_init_ap (void)
+{
+  uint64_t idtr_operand = make_idtr_operand (sizeof idt - 1, idt);
+  asm volatile ("lidt %0" : : "m" (idtr_operand));
+}
+
+/* Stops using the PICs, whose interrupts have been routed through
+   the I/O APIC instead. */
+void
+intr_use_apic (void)
+{
+  enum intr_level old_level = intr_disable ();
+
+  outb (PIC0_DATA, 0xff);
+  outb (PIC1_DATA, 0xff);
+  use_apic = true;
+
+  intr_set_level (old_level);
+}
+
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
    privilege level DPL.  Names the interrupt NAME for debugging
    purposes.  The interrupt handler will be invoked with
@@ -182,7 +233,7 @@ void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
                    const char *name) 
 {
-  ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+  ASSERT (is_external_vec (vec_no));
   register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
@@ -203,27 +254,29 @@ void
 intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
                    intr_handler_func *handler, const char *name)
 {
-  ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+  ASSERT (!is_external_vec (vec_no));
   register_handler (vec_no, dpl, level, handler, name);
 }
 
-/* Returns true during processing of an external interrupt
-   and false at all other times. */
+/* Returns true during processing of an external interrupt,
+   including the softirqs run on its way out, and false at all
+   other times. */
 bool
 intr_context (void) 
 {
-  return in_external_intr;
+  struct cpu *cpu = cpu_current ();
+  return cpu->in_external_intr || cpu->in_softirq;
 }
 
-/* During processing of an external interrupt, directs the
-   interrupt handler to yield to a new process just before
-   returning from the interrupt.  May not be called at any other
-   time. */
+/* During processing of an external interrupt or a softirq,
+   directs the interrupt handler to yield to a new process just
+   before returning from the interrupt.  May not be called at any
+   other time. */
 void
 intr_yield_on_return (void) 
 {
   ASSERT (intr_context ());
-  yield_on_return = true;
+  cpu_current ()->yield_on_return = true;
 }
 
 /* 8259A Programmable Interrupt Controller. */
@@ -347,26 +400,41 @@ intr_handler (struct intr_frame *frame)
 {
   bool external;
   intr_handler_func *handler;
+  struct cpu *cpu;
+  uint64_t start = 0;
+
+#ifdef USERPROG
+  /* Time up to here was spent in user mode. */
+  if (frame->cs == SEL_UCSEG)
+    thread_usage_kernel_entry ();
+#endif
 
   /* External interrupts are special.
      We only handle one at a time (so interrupts must be off)
      and they need to be acknowledged on the PIC (see below).
      An external interrupt handler cannot sleep. */
-  external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+  external = is_external_vec (frame->vec_no);
   if (external) 
     {
       ASSERT (intr_get_level () == INTR_OFF);
-      ASSERT (!intr_context ());
 
-      in_external_intr = true;
-      yield_on_return = false;
+      cpu = cpu_current ();
+      ASSERT (!cpu->in_external_intr);
+      cpu->in_external_intr = true;
+
+      /* An interrupt that arrives while softirqs run leaves the
+         yield to the interrupt that ran them. */
+      if (!cpu->in_softirq)
+        cpu->yield_on_return = false;
+      start = rdtsc ();
     }
 
   /* Invoke the interrupt's handler. */
   handler = intr_handlers[frame->vec_no];
   if (handler != NULL)
     handler (frame);
-  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f)
+  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f
+           || frame->vec_no == LAPIC_SPURIOUS_VEC)
     {
       /* There is no handler, but this interrupt can trigger
          spuriously due to a hardware fault or hardware race
@@ -381,12 +449,64 @@ intr_handler (struct intr_frame *frame)
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (intr_context ());
 
-      in_external_intr = false;
-      pic_end_of_interrupt (frame->vec_no); 
+      if (softirq_inline)
+        softirq_run ();
+
+      cpu->in_external_intr = false;
+      if (frame->vec_no == LAPIC_SPURIOUS_VEC)
+        {
+          /* Spurious local APIC interrupts are not acknowledged. */
+        }
+      else if (use_apic || frame->vec_no >= 0xf0)
+        lapic_eoi ();
+      else
+        pic_end_of_interrupt (frame->vec_no); 
 
-      if (yield_on_return) 
+      hard_cycles[cpu->id][ext_vec_idx (frame->vec_no)] += rdtsc () - start;
+      hard_cnt[cpu->id][ext_vec_idx (frame->vec_no)]++;
+
+      /* Now that other interrupts can come in again, do the work
+         the handler deferred. */
+      softirq_run ();
+
+      if (cpu->yield_on_return && !cpu->in_softirq) 
         thread_yield (); 
     }
+
+#ifdef USERPROG
+  /* Another thread of the process may have called exit() while
+     this one was away from user mode. */
+  if (frame->cs == SEL_UCSEG)
+    {
+      process_exit_if_exiting ();
+      thread_usage_kernel_exit ();
+    }
+#endif
+}
+
+/* Prints the number of interrupts taken on each external vector
+   and the average time spent in them with interrupts off. */
+void
+intr_print_stats (void)
+{
+  int idx, i;
+
+  for (idx = 0; idx < EXT_VEC_CNT; idx++)
+    {
+      const int vec = idx < 16 ? 0x20 + idx : 0xf0 + idx - 16;
+      long long cnt = 0;
+      uint64_t cycles = 0;
+
+      for (i = 0; i < cpu_cnt; i++)
+        {
+          cnt += hard_cnt[i][idx];
+          cycles += hard_cycles[i][idx];
+        }
+      if (cnt > 0)
+        printf ("Interrupt %#04x (%s): %lld taken, %llu cycles avg\n",
+                vec, intr_names[vec], cnt,
+                (unsigned long long) (cycles / cnt));
+    }
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
@@ -5,6 +5,8 @@
 
 #include "kernel_shell.h"
 #include "../devices/input.h"
+#include "malloc.h"
+#include "synch.h"
 
 #define BUFFER_SIZE 10
 
@@ -18,6 +20,14 @@ handle_command(char* line) {
     printf ("Bye bye\n");
     return false;
   }
+#ifdef LOCK_PROFILE
+  else if (strcmp(line, "locks") == 0)
+    lock_print_profile ();
+#endif
+#ifdef MALLOC_PROFILE
+  else if (strcmp(line, "heap") == 0)
+    malloc_print_profile ();
+#endif
   else 
     printf("You entered: %s\n", line);
 
@@ -24,6 +24,10 @@
 #define LOADER_ARGS_LEN 128
 #define LOADER_ARG_CNT_LEN 4
 
+/* Physical address the application processors start executing
+   at, in real mode.  See threads/ap-start.S. */
+#define AP_START_PHYS 0x8000
+
 /* GDT selectors defined by loader.
    More selectors are defined by userprog/gdt.h. */
 #define SEL_NULL        0x00    /* Null selector. */
@@ -5,7 +5,10 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
+#include "threads/spinlock.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -32,15 +35,28 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   In front of the descriptors, each CPU keeps a "magazine" per
+   descriptor [Bonwick and Adams, "Magazines and Vmem", USENIX
+   2001]: a small stack of free blocks that it allocates from and
+   frees to with interrupts off, but without taking the
+   descriptor's lock.  Only when its magazine is empty or full
+   does a CPU take the lock, to move several blocks between the
+   magazine and the free list at once.  Blocks in magazines count
+   as allocated, so they keep their arenas from being freed. */
 
 /* Descriptor. */
 struct desc
   {
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
+    size_t mag_size;            /* Most blocks in a magazine. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
+    long long lock_cnt;         /* # of times LOCK was acquired. */
+    size_t arena_cnt;           /* Number of arenas. */
+    size_t free_block_cnt;      /* Number of blocks in FREE_LIST. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -64,8 +80,131 @@ struct block
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Capacity of the largest magazine. */
+#define MAG_MAX 16
+
+/* A magazine: free blocks of one descriptor, owned by a CPU. */
+struct magazine
+  {
+    size_t cnt;                         /* Number of blocks. */
+    struct block *blocks[MAG_MAX];      /* Blocks, most recently freed last. */
+  };
+
+/* Per-CPU state.  Accessed only by its CPU, with interrupts
+   off. */
+struct cpu_cache
+  {
+    struct magazine mags[sizeof descs / sizeof *descs];
+    long long op_cnt;                   /* # of malloc() and free() calls. */
+  };
+static struct cpu_cache cpu_caches[CPU_MAX];
+
+/* Use magazines?  Turned off by kernel command-line option
+   "-malloc-no-magazines", to compare. */
+bool malloc_magazines = true;
+
+#ifdef MALLOC_PROFILE
+/* Heap profiling, enabled by building with `make
+   MALLOC_PROFILE=1'.
+
+   Each block starts with a struct tag that records who allocated
+   it and how many bytes they asked for, and a table keeps the
+   blocks and bytes that each call site of malloc(), calloc() and
+   realloc() has live.  malloc_print_profile() prints the sites
+   with the most live bytes, at shutdown and on the kernel
+   shell's `heap' command.  Give the addresses on its "Call
+   sites:" line to utils/backtrace to turn them into function
+   names and line numbers. */
+
+/* Magic number for detecting tag corruption and double frees. */
+#define TAG_MAGIC 0x7a61a110
+
+/* Header of a profiled block.  16 bytes, to keep blocks
+   aligned. */
+struct tag
+  {
+    unsigned magic;             /* Always set to TAG_MAGIC. */
+    void *caller;               /* Return address of the allocation. */
+    size_t size;                /* Bytes asked for. */
+    size_t taken;               /* Bytes taken, with the tag. */
+  };
+
+/* Allocations of one call site. */
+struct site
+  {
+    void *caller;               /* Return address, null if unused. */
+    long long alloc_cnt;        /* # of blocks allocated. */
+    long long free_cnt;         /* # of those freed. */
+    size_t live_bytes;          /* Bytes asked for by live blocks. */
+    size_t live_taken;          /* Bytes taken by live blocks. */
+    size_t peak_bytes;          /* Most LIVE_BYTES ever. */
+  };
+
+/* Number of call sites tracked.  Sites past that many share
+   sites[SITE_CNT], whose caller is null. */
+#define SITE_CNT 256
+
+/* Number of call sites printed by malloc_print_profile(). */
+#define PROFILE_TOP_CNT 20
+
+static struct site sites[SITE_CNT + 1];
+static struct spinlock profile_lock = SPINLOCK_INITIALIZER ("malloc profile");
+
+/* Returns CALLER's entry in sites[], claiming one if needed.
+   profile_lock must be held. */
+static struct site *
+find_site (void *caller)
+{
+  size_t h = (uintptr_t) caller % SITE_CNT;
+  size_t i;
+
+  for (i = 0; i < SITE_CNT; i++)
+    {
+      struct site *s = &sites[(h + i) % SITE_CNT];
+      if (s->caller == caller)
+        return s;
+      if (s->caller == NULL)
+        {
+          s->caller = caller;
+          return s;
+        }
+    }
+  return &sites[SITE_CNT];
+}
+
+/* Charges the block tagged T to its call site when it is
+   allocated, if ALLOCATED, or credits it back when freed. */
+static void
+profile_update (const struct tag *t, bool allocated)
+{
+  enum intr_level old_level = intr_disable ();
+  struct site *s;
+
+  spinlock_acquire (&profile_lock);
+  s = find_site (t->caller);
+  if (allocated)
+    {
+      s->alloc_cnt++;
+      s->live_bytes += t->size;
+      s->live_taken += t->taken;
+      if (s->live_bytes > s->peak_bytes)
+        s->peak_bytes = s->live_bytes;
+    }
+  else
+    {
+      s->free_cnt++;
+      s->live_bytes -= t->size;
+      s->live_taken -= t->taken;
+    }
+  spinlock_release (&profile_lock);
+  intr_set_level (old_level);
+}
+#endif
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void *malloc_from (size_t, void *caller);
+static size_t block_size (void *);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -79,19 +218,126 @@ malloc_init (void)
       ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+      d->mag_size = d->blocks_per_arena / 2;
+      if (d->mag_size > MAG_MAX)
+        d->mag_size = MAG_MAX;
+      else if (d->mag_size < 1)
+        d->mag_size = 1;
       list_init (&d->free_list);
       lock_init (&d->lock);
+      d->lock_cnt = 0;
+      d->arena_cnt = 0;
+      d->free_block_cnt = 0;
+    }
+}
+
+/* Returns the running CPU's magazine for D.  Interrupts must be
+   off. */
+static struct magazine *
+cpu_magazine (struct desc *d)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  return &cpu_caches[cpu_current ()->id].mags[d - descs];
+}
+
+/* Takes up to CNT blocks off D's free list, creating arenas as
+   needed, and stores them in BLOCKS.  Returns the number of
+   blocks taken, which is less than CNT only if memory ran out. */
+static size_t
+take_blocks (struct desc *d, struct block *blocks[], size_t cnt)
+{
+  size_t taken;
+
+  lock_acquire (&d->lock);
+  d->lock_cnt++;
+  for (taken = 0; taken < cnt; taken++)
+    {
+      struct arena *a;
+
+      /* If the free list is empty, create a new arena. */
+      if (list_empty (&d->free_list))
+        {
+          size_t i;
+
+          /* Allocate a page. */
+          a = palloc_get_page (0);
+          if (a == NULL) 
+            break;
+
+          /* Initialize arena and add its blocks to the free list. */
+          a->magic = ARENA_MAGIC;
+          a->desc = d;
+          a->free_cnt = d->blocks_per_arena;
+          for (i = 0; i < d->blocks_per_arena; i++) 
+            {
+              struct block *b = arena_to_block (a, i);
+              list_push_back (&d->free_list, &b->free_elem);
+            }
+          d->arena_cnt++;
+          d->free_block_cnt += d->blocks_per_arena;
+        }
+
+      /* Get a block from free list. */
+      blocks[taken] = list_entry (list_pop_front (&d->free_list),
+                                  struct block, free_elem);
+      a = block_to_arena (blocks[taken]);
+      a->free_cnt--;
+      d->free_block_cnt--;
+    }
+  lock_release (&d->lock);
+
+  return taken;
+}
+
+/* Returns the CNT blocks in BLOCKS to D's free list, giving each
+   arena that becomes entirely unused back to the page
+   allocator. */
+static void
+give_blocks (struct desc *d, struct block *blocks[], size_t cnt)
+{
+  size_t j;
+
+  lock_acquire (&d->lock);
+  d->lock_cnt++;
+  for (j = 0; j < cnt; j++)
+    {
+      struct block *b = blocks[j];
+      struct arena *a = block_to_arena (b);
+
+      /* Add block to free list. */
+      list_push_front (&d->free_list, &b->free_elem);
+      d->free_block_cnt++;
+
+      /* If the arena is now entirely unused, free it. */
+      if (++a->free_cnt >= d->blocks_per_arena) 
+        {
+          size_t i;
+
+          ASSERT (a->free_cnt == d->blocks_per_arena);
+          for (i = 0; i < d->blocks_per_arena; i++) 
+            {
+              struct block *b = arena_to_block (a, i);
+              list_remove (&b->free_elem);
+            }
+          palloc_free_page (a);
+          d->arena_cnt--;
+          d->free_block_cnt -= d->blocks_per_arena;
+        }
     }
+  lock_release (&d->lock);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
    Returns a null pointer if memory is not available. */
-void *
-malloc (size_t size) 
+static void *
+alloc_block (size_t size) 
 {
   struct desc *d;
   struct block *b;
   struct arena *a;
+  struct block *batch[MAG_MAX + 1];
+  enum intr_level old_level;
+  size_t cnt;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
@@ -119,38 +365,74 @@ malloc (size_t size)
       return a + 1;
     }
 
-  lock_acquire (&d->lock);
-
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
+  /* Take a block from this CPU's magazine, if it has one. */
+  old_level = intr_disable ();
+  cpu_caches[cpu_current ()->id].op_cnt++;
+  if (malloc_magazines)
     {
-      size_t i;
-
-      /* Allocate a page. */
-      a = palloc_get_page (0);
-      if (a == NULL) 
+      struct magazine *m = cpu_magazine (d);
+      if (m->cnt > 0)
         {
-          lock_release (&d->lock);
-          return NULL; 
+          b = m->blocks[--m->cnt];
+          intr_set_level (old_level);
+          return b;
         }
+    }
+  intr_set_level (old_level);
 
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
-        {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
-        }
+  /* Otherwise take a batch of blocks from the free list, keep one
+     and load the others into the magazine. */
+  cnt = take_blocks (d, batch, malloc_magazines ? d->mag_size / 2 + 1 : 1);
+  if (cnt == 0)
+    return NULL;
+  if (cnt > 1)
+    {
+      struct magazine *m;
+
+      old_level = intr_disable ();
+      m = cpu_magazine (d);
+      while (cnt > 1 && m->cnt < d->mag_size)
+        m->blocks[m->cnt++] = batch[--cnt];
+      intr_set_level (old_level);
+
+      /* Another thread on this CPU may have filled the magazine
+         meanwhile. */
+      if (cnt > 1)
+        give_blocks (d, batch + 1, cnt - 1);
     }
+  return batch[0];
+}
 
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
-  lock_release (&d->lock);
-  return b;
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size) 
+{
+  return malloc_from (size, __builtin_return_address (0));
+}
+
+/* Does the work of malloc() and the other allocation functions,
+   on behalf of the call at CALLER. */
+static void *
+malloc_from (size_t size, void *caller UNUSED)
+{
+#ifdef MALLOC_PROFILE
+  struct tag *t;
+
+  if (size == 0 || size + sizeof *t < size)
+    return NULL;
+  t = alloc_block (size + sizeof *t);
+  if (t == NULL)
+    return NULL;
+  t->magic = TAG_MAGIC;
+  t->caller = caller;
+  t->size = size;
+  t->taken = block_size (t);
+  profile_update (t, true);
+  return t + 1;
+#else
+  return alloc_block (size);
+#endif
 }
 
 /* Allocates and return A times B bytes initialized to zeroes.
@@ -167,7 +449,7 @@ calloc (size_t a, size_t b)
     return NULL;
 
   /* Allocate and zero memory. */
-  p = malloc (size);
+  p = malloc_from (size, __builtin_return_address (0));
   if (p != NULL)
     memset (p, 0, size);
 
@@ -201,10 +483,14 @@ realloc (void *old_block, size_t new_size)
     }
   else 
     {
-      void *new_block = malloc (new_size);
+      void *new_block = malloc_from (new_size, __builtin_return_address (0));
       if (old_block != NULL && new_block != NULL)
         {
+#ifdef MALLOC_PROFILE
+          size_t old_size = ((struct tag *) old_block - 1)->size;
+#else
           size_t old_size = block_size (old_block);
+#endif
           size_t min_size = new_size < old_size ? new_size : old_size;
           memcpy (new_block, old_block, min_size);
           free (old_block);
@@ -213,10 +499,9 @@ realloc (void *old_block, size_t new_size)
     }
 }
 
-/* Frees block P, which must have been previously allocated with
-   malloc(), calloc(), or realloc(). */
-void
-free (void *p) 
+/* Frees block P, which was obtained from alloc_block(). */
+static void
+free_block (void *p) 
 {
   if (p != NULL)
     {
@@ -227,32 +512,36 @@ free (void *p)
       if (d != NULL) 
         {
           /* It's a normal block.  We handle it here. */
+          struct block *batch[MAG_MAX + 1];
+          enum intr_level old_level;
+          size_t cnt = 0;
 
 #ifndef NDEBUG
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
-  
-          lock_acquire (&d->lock);
-
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
 
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
+          /* Put the block in this CPU's magazine.  If that is
+             full, give half of the magazine's blocks back to the
+             free list along with it. */
+          old_level = intr_disable ();
+          cpu_caches[cpu_current ()->id].op_cnt++;
+          if (malloc_magazines)
             {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
+              struct magazine *m = cpu_magazine (d);
+              if (m->cnt < d->mag_size)
                 {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
+                  m->blocks[m->cnt++] = b;
+                  intr_set_level (old_level);
+                  return;
                 }
-              palloc_free_page (a);
+              while (m->cnt > d->mag_size / 2)
+                batch[cnt++] = m->blocks[--m->cnt];
             }
+          batch[cnt++] = b;
+          intr_set_level (old_level);
 
-          lock_release (&d->lock);
+          give_blocks (d, batch, cnt);
         }
       else
         {
@@ -263,6 +552,124 @@ free (void *p)
     }
 }
 
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p) 
+{
+#ifdef MALLOC_PROFILE
+  if (p != NULL)
+    {
+      struct tag *t = (struct tag *) p - 1;
+
+      ASSERT (t->magic == TAG_MAGIC);
+      t->magic = 0;
+      profile_update (t, false);
+      p = t;
+    }
+#endif
+  free_block (p);
+}
+
+/* Stores the allocator's counters in *STATS.  The counters are
+   read without locking, so calls in progress meanwhile may or
+   may not be counted. */
+void
+malloc_get_stats (struct malloc_stats *stats)
+{
+  size_t i;
+
+  stats->op_cnt = 0;
+  for (i = 0; i < CPU_MAX; i++)
+    stats->op_cnt += cpu_caches[i].op_cnt;
+  stats->lock_cnt = 0;
+  for (i = 0; i < desc_cnt; i++)
+    stats->lock_cnt += descs[i].lock_cnt;
+}
+
+/* Prints the allocator's counters. */
+void
+malloc_print_stats (void)
+{
+  struct malloc_stats s;
+
+  malloc_get_stats (&s);
+  printf ("Malloc: %lld calls, %lld lock acquisitions, magazines %s\n",
+          s.op_cnt, s.lock_cnt, malloc_magazines ? "on" : "off");
+}
+
+#ifdef MALLOC_PROFILE
+/* Prints the call sites with the most live bytes, and how many
+   pages the arenas of each size class take up.  The counts are
+   read without locking. */
+void
+malloc_print_profile (void)
+{
+  struct site top[PROFILE_TOP_CNT];
+  enum intr_level old_level;
+  int cnt = 0;
+  int i;
+  size_t j;
+
+  /* Copy the top sites out, since printing needs a lock. */
+  old_level = intr_disable ();
+  spinlock_acquire (&profile_lock);
+  for (j = 0; j <= SITE_CNT; j++)
+    {
+      struct site *s = &sites[j];
+      if (s->alloc_cnt == 0)
+        continue;
+
+      for (i = cnt < PROFILE_TOP_CNT ? cnt++ : PROFILE_TOP_CNT;
+           i > 0 && top[i - 1].live_bytes < s->live_bytes; i--)
+        if (i < PROFILE_TOP_CNT)
+          top[i] = top[i - 1];
+      if (i < PROFILE_TOP_CNT)
+        top[i] = *s;
+    }
+  spinlock_release (&profile_lock);
+  intr_set_level (old_level);
+
+  printf ("Heap profile, by live bytes:\n");
+  printf ("%10s %8s %10s %10s %10s %10s %10s\n", "site", "live",
+          "bytes", "taken", "peak", "allocs", "frees");
+  for (i = 0; i < cnt; i++)
+    {
+      if (top[i].caller != NULL)
+        printf ("%10p", top[i].caller);
+      else
+        printf ("%10s", "(other)");
+      printf (" %8lld %10zu %10zu %10zu %10lld %10lld\n",
+              top[i].alloc_cnt - top[i].free_cnt, top[i].live_bytes,
+              top[i].live_taken, top[i].peak_bytes, top[i].alloc_cnt,
+              top[i].free_cnt);
+    }
+  printf ("Call sites:");
+  for (i = 0; i < cnt; i++)
+    if (top[i].caller != NULL)
+      printf (" %p", top[i].caller);
+  printf (".\n");
+
+  printf ("Arenas by size class:\n");
+  printf ("%6s %6s %10s %10s %10s\n", "class", "pages", "used", "free",
+          "magazines");
+  for (j = 0; j < desc_cnt; j++)
+    {
+      struct desc *d = &descs[j];
+      size_t mag_cnt = 0;
+      size_t k;
+
+      if (d->arena_cnt == 0)
+        continue;
+      for (k = 0; k < CPU_MAX; k++)
+        mag_cnt += cpu_caches[k].mags[j].cnt;
+      printf ("%6zu %6zu %10zu %10zu %10zu\n", d->block_size, d->arena_cnt,
+              d->arena_cnt * d->blocks_per_arena - d->free_block_cnt - mag_cnt,
+              d->free_block_cnt, mag_cnt);
+    }
+}
+#endif
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
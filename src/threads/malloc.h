@@ -2,12 +2,29 @@
 #define THREADS_MALLOC_H
 
 #include <debug.h>
+#include <stdbool.h>
 #include <stddef.h>
 
+/* Counters of the allocator, for blocks of up to 1 kB. */
+struct malloc_stats
+  {
+    long long op_cnt;           /* # of malloc() and free() calls. */
+    long long lock_cnt;         /* # of descriptor lock acquisitions. */
+  };
+
+/* Use per-CPU magazines?  Controlled by kernel command-line option
+   "-malloc-no-magazines". */
+extern bool malloc_magazines;
+
 void malloc_init (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
+void malloc_get_stats (struct malloc_stats *);
+void malloc_print_stats (void);
+#ifdef MALLOC_PROFILE
+void malloc_print_profile (void);
+#endif
 
 #endif /* threads/malloc.h */
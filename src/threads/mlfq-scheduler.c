@@ -1,14 +1,27 @@
 #include "thread.h"
 #include "mlfq-scheduler.h"
+#include "cpu.h"
 #include "interrupt.h"
 #include "list.h"
 #include "synch.h"
+#include "devices/timer.h"
 
 #include <kernel/fixed-point.h>
+#include <kernel/priority-bitmap.h>
 #include <debug.h>
 
 #define NUMBER_QUEUES (PRI_MAX + 1)
 
+/* Number of past per-second decay coefficients that are kept.
+   A thread that has not been examined for longer than this
+   (a long sleeper) gets the oldest kept coefficient for the
+   seconds that fell out of the history. */
+#define DECAY_HISTORY 256
+
+/* Maximum number of ready threads brought up to date on each
+   quantum tick. */
+#define SWEEP_BATCH 32
+
 #define CUTOFF_RANGE(val, min, max) \
 ({ \
   __typeof__ (val) _val = (val); \
@@ -17,30 +30,57 @@
   _val < _min ? _min : ( _val > _max ? _max : _val); \
 })
 
-static struct list mlfqs[NUMBER_QUEUES];
-static struct lock mlfqs_lock;
-static int ready_threads;
+/* Ready queues of each CPU, one per priority.  Bit N of a CPU's
+   bitmap is set iff its queue N is non-empty.  These and the
+   rest of the scheduler state below are protected by sched_lock. */
+struct mlfq_run_queue {
+  struct list queues[NUMBER_QUEUES];
+  struct priority_bitmap bitmap;
+};
+static struct mlfq_run_queue run_queues[CPU_MAX];
+static int ready_threads;       /* # of ready threads, all CPUs together. */
+
+/* Ready threads ordered by decay_epoch, oldest first, so that the
+   quantum tick can refresh the most out of date ones first. */
+static struct list sweep_list;
 
 static struct fixed_point load_avg;
 
+/* Seconds elapsed since boot, and the recent_cpu decay
+   coefficient (2*load_avg)/(2*load_avg + 1) of each of the last
+   DECAY_HISTORY seconds.  recent_cpu is decayed lazily, when a
+   thread is next looked at, instead of for every thread on every
+   second. */
+static unsigned epoch;
+static struct fixed_point decay_history[DECAY_HISTORY];
+
+/* Statistics. */
+static int updates_this_tick;   /* # of threads recomputed during this tick. */
+static int max_updates_per_tick; /* Largest value updates_this_tick reached. */
+
 void mlfq_scheduler_init (void) {
-  for (size_t i = 0; i < NUMBER_QUEUES; i++) {
-    list_init (&mlfqs[i]);
-  }
+  for (size_t cpu = 0; cpu < CPU_MAX; cpu++) {
+    for (size_t i = 0; i < NUMBER_QUEUES; i++) {
+      list_init (&run_queues[cpu].queues[i]);
+    }
 
-  lock_init (&mlfqs_lock);
+    priority_bitmap_init (&run_queues[cpu].bitmap);
+  }
+  list_init (&sweep_list);
 
   struct thread* main_t = running_thread ();
   main_t->thread_mlfq_block.nice = 0;
   main_t->thread_mlfq_block.recent_cpu = fixed_point_build (0);
+  main_t->thread_mlfq_block.decay_epoch = 0;
 
   load_avg = fixed_point_build (0);
   ready_threads = 0;
+  epoch = 0;
 }
 
 static void mlfq_update_thread_pri (struct thread_mlfq_block* t) {
-  const struct fixed_point recent_er = fixed_point_div_int (t->recent_cpu, 4);  
-  const struct fixed_point nice_er = fixed_point_build (t->nice * 2);  
+  const struct fixed_point recent_er = fixed_point_div_int (t->recent_cpu, 4);
+  const struct fixed_point nice_er = fixed_point_build (t->nice * 2);
 
   struct fixed_point pri = fixed_point_build (PRI_MAX);
   pri = fixed_point_sub_real (pri, recent_er);
@@ -48,32 +88,80 @@ static void mlfq_update_thread_pri (struct thread_mlfq_block* t) {
 
   const int pri_int = fixed_point_to_nearest_int (pri);
   t->priority = CUTOFF_RANGE (pri_int, PRI_MIN, PRI_MAX);
+
+  updates_this_tick++;
 }
 
-static void mlfq_update_ready_thread_pri (struct thread* t) {
-  ASSERT (t->status == THREAD_READY);
+/* Applies the recent_cpu decay of every second that passed since
+   T was last brought up to date, then recomputes its priority. */
+static void mlfq_catch_up (struct thread_mlfq_block* t) {
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
 
-  // thread READY
-  if (! lock_try_acquire (&mlfqs_lock))
+  if (t->decay_epoch == epoch)
     return;
 
+  if (epoch - t->decay_epoch > DECAY_HISTORY) {
+    const struct fixed_point oldest = decay_history[(epoch + 1) % DECAY_HISTORY];
+    while (epoch - t->decay_epoch > DECAY_HISTORY) {
+      t->recent_cpu = fixed_point_mult_real (oldest, t->recent_cpu);
+      t->recent_cpu = fixed_point_add_int (t->recent_cpu, t->nice);
+      t->decay_epoch++;
+    }
+  }
+
+  while (t->decay_epoch != epoch) {
+    t->decay_epoch++;
+    const struct fixed_point coeff = decay_history[t->decay_epoch % DECAY_HISTORY];
+    t->recent_cpu = fixed_point_mult_real (coeff, t->recent_cpu);
+    t->recent_cpu = fixed_point_add_int (t->recent_cpu, t->nice);
+  }
+
+  mlfq_update_thread_pri (t);
+}
+
+/* Queues T in the run queue of CPU T->cpu. */
+static void mlfq_queue_push (struct thread* t) {
+  struct mlfq_run_queue *rq = &run_queues[t->cpu];
+  const int pri = t->thread_mlfq_block.priority;
+
+  ASSERT (pri >= PRI_MIN && pri <= PRI_MAX);
+
+  list_push_back (&rq->queues[pri], &t->elem);
+  priority_bitmap_set (&rq->bitmap, pri);
+}
+
+static void mlfq_queue_remove (struct thread* t, int pri) {
+  struct mlfq_run_queue *rq = &run_queues[t->cpu];
+
+  list_remove (&t->elem);
+  if (list_empty (&rq->queues[pri]))
+    priority_bitmap_clear (&rq->bitmap, pri);
+}
+
+static void mlfq_update_ready_thread_pri (struct thread* t) {
+  ASSERT (t->status == THREAD_READY);
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
+
   const int prev_pri = mlfq_thread_priority(t);
-  mlfq_update_thread_pri (&t->thread_mlfq_block);
+  mlfq_catch_up (&t->thread_mlfq_block);
   const int new_pri = mlfq_thread_priority(t);
-  
+
   if (new_pri != prev_pri) {
-    list_remove (&t->elem); // remove thread from previous queue
-    list_push_back (&mlfqs[new_pri], &t->elem); // add thread to new queue
+    mlfq_queue_remove (t, prev_pri); // remove thread from previous queue
+    mlfq_queue_push (t); // add thread to new queue
   }
-  
-  lock_release (&mlfqs_lock);
 }
 
 void mlfq_thread_init (struct thread *t) {
 
   struct thread* parent_t = running_thread ();
+  enum intr_level old_level = sched_lock_acquire ();
+  mlfq_catch_up (&parent_t->thread_mlfq_block);
+  sched_lock_release (old_level);
+
   t->thread_mlfq_block.nice = parent_t->thread_mlfq_block.nice;
   t->thread_mlfq_block.recent_cpu = parent_t->thread_mlfq_block.recent_cpu;
+  t->thread_mlfq_block.decay_epoch = parent_t->thread_mlfq_block.decay_epoch;
 
   mlfq_update_thread_pri (&t->thread_mlfq_block);
 }
@@ -83,40 +171,45 @@ int mlfq_thread_priority (struct thread* t) {
 }
 
 
-struct thread * mlfq_next_thread_to_run (void) 
+struct thread * mlfq_next_thread_to_run (int cpu)
 {
-  lock_acquire (&mlfqs_lock);
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
 
-  struct thread * next_thread = NULL;
-  for (int i = NUMBER_QUEUES - 1; i >= 0; i--) {
-    struct list* queue = &mlfqs[i];
-    if (! list_empty (queue)) {
-      struct list_elem * next_elem = list_pop_front (queue);
-      next_thread = list_entry (next_elem, struct thread, elem);
+  struct mlfq_run_queue *rq = &run_queues[cpu];
+  const int pri = priority_bitmap_highest (&rq->bitmap);
+  if (pri < 0)
+    return NULL;
 
-      ready_threads--;
-      ASSERT (ready_threads >= 0);
+  struct list_elem * next_elem = list_pop_front (&rq->queues[pri]);
+  if (list_empty (&rq->queues[pri]))
+    priority_bitmap_clear (&rq->bitmap, pri);
 
-      break;
-    }
-  }
+  struct thread * next_thread = list_entry (next_elem, struct thread, elem);
+  list_remove (&next_thread->thread_mlfq_block.sweep_elem);
+
+  ready_threads--;
+  ASSERT (ready_threads >= 0);
 
-  lock_release (&mlfqs_lock);
   return next_thread;
 }
 
-void mlfq_insert_ready_thread (struct thread* t) {
-  const int pri = t->thread_mlfq_block.priority;
+/* Takes ready thread T out of its run queue. */
+static void mlfq_dequeue_thread (struct thread* t) {
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
 
-  ASSERT (pri >= PRI_MIN && pri <= PRI_MAX);
+  mlfq_queue_remove (t, mlfq_thread_priority (t));
+  list_remove (&t->thread_mlfq_block.sweep_elem);
 
-  enum intr_level old_level = intr_disable ();
-  // lock_acquire (&mlfqs_lock);
-  list_push_back (&mlfqs[pri], &t->elem);
+  ready_threads--;
+  ASSERT (ready_threads >= 0);
+}
+
+void mlfq_insert_ready_thread (struct thread* t) {
+  mlfq_catch_up (&t->thread_mlfq_block);
+  mlfq_queue_push (t);
+  list_push_back (&sweep_list, &t->thread_mlfq_block.sweep_elem);
   ready_threads++;
-  // lock_release (&mlfqs_lock);
-  intr_set_level (old_level);
-} 
+}
 
 void mlfq_thread_set_nice (int nice) {
   nice = CUTOFF_RANGE (nice, -20, 20);
@@ -124,10 +217,13 @@ void mlfq_thread_set_nice (int nice) {
   struct thread * t = thread_current ();
 
   const int inital_pri = mlfq_thread_priority (t);
-  
-  t->thread_mlfq_block.nice = nice;
 
+  enum intr_level old_level = sched_lock_acquire ();
+  mlfq_catch_up (&t->thread_mlfq_block);
+  t->thread_mlfq_block.nice = nice;
   mlfq_update_thread_pri (&t->thread_mlfq_block);
+  sched_lock_release (old_level);
+
   const int final_pri = mlfq_thread_priority (t);
   if (final_pri < inital_pri) {
     thread_yield ();
@@ -138,49 +234,54 @@ int mlfq_thread_get_nice (struct thread* t) {
   return t->thread_mlfq_block.nice;
 }
 
-int mlfq_get_load_avg () { 
+int mlfq_get_load_avg () {
   struct fixed_point real = fixed_point_mult_int (load_avg, 100);
   return fixed_point_to_nearest_int (real);
 }
 
 int mlfq_get_recent_cpu (struct thread_mlfq_block* t) {
+  enum intr_level old_level = sched_lock_acquire ();
+  mlfq_catch_up (t);
+  sched_lock_release (old_level);
+
   struct fixed_point real = fixed_point_mult_int (t->recent_cpu, 100);
   return fixed_point_to_nearest_int (real);
 }
 
-static void mlfq_thread_quantum_priority_update_func (struct thread *t, void *aux UNUSED) {
-  if (t->status != THREAD_READY) {
-    mlfq_update_thread_pri (&t->thread_mlfq_block);
-    return;
-  }
+/* Brings up to SWEEP_BATCH of the most out of date ready threads
+   up to date, moving them to their new queue if needed.  Keeps
+   the priorities of threads that sit in the ready queues for a
+   long time current without ever walking every thread. */
+static void mlfq_sweep_ready_threads (void) {
+  for (int i = 0; i < SWEEP_BATCH && !list_empty (&sweep_list); i++) {
+    struct list_elem * e = list_front (&sweep_list);
+    struct thread * t = list_entry (e, struct thread, thread_mlfq_block.sweep_elem);
+    if (t->thread_mlfq_block.decay_epoch == epoch)
+      break;
 
-  mlfq_update_ready_thread_pri (t);
+    mlfq_update_ready_thread_pri (t);
+    list_remove (e);
+    list_push_back (&sweep_list, e);
+  }
 }
 
 void mlfq_thread_quantum_tick () {
-  thread_foreach (mlfq_thread_quantum_priority_update_func, NULL);
-}
-
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
 
-static void mlfq_thread_recent_cpu_update (struct thread *t, void *aux UNUSED) {
-  const struct fixed_point load_avg_x_2 = fixed_point_mult_int (load_avg, 2);
-  const struct fixed_point load_avg_x_2_p_1 = fixed_point_add_int (load_avg_x_2, 1);
-
-  const struct fixed_point load_avg_bit = fixed_point_div_real (load_avg_x_2, load_avg_x_2_p_1);
-
-  struct fixed_point recent_cpu = fixed_point_mult_real (load_avg_bit, t->thread_mlfq_block.recent_cpu);
-  recent_cpu = fixed_point_add_int (recent_cpu, t->thread_mlfq_block.nice);
+  for (int i = 0; i < cpu_cnt; i++) {
+    struct thread * t = cpus[i].current;
+    if (t != NULL && !is_idle_thread (t)) {
+      mlfq_catch_up (&t->thread_mlfq_block);
+      mlfq_update_thread_pri (&t->thread_mlfq_block);
+    }
+  }
 
-  t->thread_mlfq_block.recent_cpu = recent_cpu;  
+  mlfq_sweep_ready_threads ();
 }
 
 static void update_load_avg (void) {
-  int num_ready_threads = ready_threads; // 1 for running thread
-
-  struct thread* t = running_thread ();
-  if (t->status == THREAD_RUNNING && !is_idle_thread (t)) {
-    num_ready_threads++;
-  }
+  // plus 1 for each running thread
+  int num_ready_threads = ready_threads + thread_running_cnt ();
 
   struct fixed_point ready_real = fixed_point_build (num_ready_threads);
   ready_real = fixed_point_div_int (ready_real, 60);
@@ -195,9 +296,82 @@ static void update_load_avg (void) {
 void mlfq_thread_second_tick (void) {
   update_load_avg ();
 
-  thread_foreach (mlfq_thread_recent_cpu_update, NULL);
+  const struct fixed_point load_avg_x_2 = fixed_point_mult_int (load_avg, 2);
+  const struct fixed_point load_avg_x_2_p_1 = fixed_point_add_int (load_avg_x_2, 1);
+
+  epoch++;
+  decay_history[epoch % DECAY_HISTORY] = fixed_point_div_real (load_avg_x_2, load_avg_x_2_p_1);
+}
+
+/* Starts counting the priority updates of a new timer tick.
+   Called for every tick, whether it was taken or skipped by the
+   tickless timer, and whether or not any CPU was busy. */
+void mlfq_tick_boundary (void) {
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
+
+  if (updates_this_tick > max_updates_per_tick)
+    max_updates_per_tick = updates_this_tick;
+  updates_this_tick = 0;
 }
 
 void mlfq_thread_tick (struct thread_mlfq_block* t) {
+  mlfq_catch_up (t);
   t->recent_cpu = fixed_point_add_int (t->recent_cpu, 1);
-}
\ No newline at end of file
+}
+
+/* Returns the largest number of thread priorities recomputed
+   during a single timer tick since boot. */
+int mlfq_max_updates_per_tick (void) {
+  return max_updates_per_tick;
+}
+
+static void mlfq_class_thread_init (struct thread *t, int priority UNUSED) {
+  mlfq_thread_init (t);
+}
+
+static bool mlfq_class_tick (struct thread *t) {
+  mlfq_thread_tick (&t->thread_mlfq_block);
+  return cpu_current ()->thread_ticks >= TIME_SLICE;
+}
+
+static void mlfq_system_tick (int64_t ticks) {
+  mlfq_tick_boundary ();
+
+  if (ticks % TIME_SLICE == 0)
+    mlfq_thread_quantum_tick ();
+
+  if (ticks % TIMER_FREQ == 0)
+    mlfq_thread_second_tick ();
+}
+
+/* load_avg must be updated at the start of every second. */
+static int64_t mlfq_next_event (int64_t now, int64_t limit) {
+  const int64_t next_second = (now / TIMER_FREQ + 1) * TIMER_FREQ;
+  return next_second < limit ? next_second : limit;
+}
+
+static bool mlfq_yield_check (struct thread *cur, struct thread *t) {
+  return mlfq_thread_priority (t) > mlfq_thread_priority (cur);
+}
+
+static bool mlfq_wakes_before (struct thread *t, struct thread *u) {
+  return mlfq_thread_priority (t) > mlfq_thread_priority (u);
+}
+
+const struct sched_class mlfq_sched_class = {
+  .name = "mlfqs",
+  .rank = 0,
+  .init = mlfq_scheduler_init,
+  .thread_init = mlfq_class_thread_init,
+  .enqueue = mlfq_insert_ready_thread,
+  .dequeue = mlfq_dequeue_thread,
+  .pick_next = mlfq_next_thread_to_run,
+  .tick = mlfq_class_tick,
+  .system_tick = mlfq_system_tick,
+  .next_event = mlfq_next_event,
+  .yield_check = mlfq_yield_check,
+  .wakes_before = mlfq_wakes_before,
+  .priority = mlfq_thread_priority,
+  .get_nice = mlfq_thread_get_nice,
+  .set_nice = mlfq_thread_set_nice,
+};
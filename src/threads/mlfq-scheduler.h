@@ -9,12 +9,14 @@ struct thread_mlfq_block {
   int nice;
   int priority;
   struct fixed_point recent_cpu;  
+  unsigned decay_epoch;           /* Last second whose decay is applied to recent_cpu. */
+  struct list_elem sweep_elem;    /* Element in the ready threads sweep list. */
 };
 
 
 void mlfq_scheduler_init (void);
 int mlfq_thread_priority (struct thread* t);
-struct thread * mlfq_next_thread_to_run (void);
+struct thread * mlfq_next_thread_to_run (int cpu);
 void mlfq_insert_ready_thread (struct thread* t);
 void mlfq_thread_init (struct thread *t);
 void mlfq_thread_set_nice (int nice);
@@ -26,8 +28,11 @@ int mlfq_get_load_avg (void);
 void mlfq_thread_quantum_tick (void);
 void mlfq_thread_second_tick (void);
 
+void mlfq_tick_boundary (void);
 void mlfq_thread_tick (struct thread_mlfq_block* t);
 
 int mlfq_get_recent_cpu (struct thread_mlfq_block* t);
 
+int mlfq_max_updates_per_tick (void);
+
 #endif
\ No newline at end of file
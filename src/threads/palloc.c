@@ -1,14 +1,15 @@
 #include "threads/palloc.h"
-#include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
+#include "threads/spinlock.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -25,20 +26,75 @@
    half to the user pool.  That should be huge overkill for the
    kernel pool, but that's just fine for demonstration purposes. */
 
+/* Pages are handed out by a binary buddy system [Knuth,
+   "The Art of Computer Programming", vol. 1, 2.5].  A pool's
+   pages are split into blocks of 2**ORDER pages, each aligned to
+   its own size relative to the pool's base, and each pool keeps
+   one list of free blocks per order.  A request for N pages takes
+   a block of the smallest order that fits N, splitting a larger
+   one in halves if need be, and gives back the pages past N.  A
+   freed block merges with its "buddy", the other half of the
+   block it was split from, as long as that is free too.
+   Allocating and freeing therefore take O(lg n) time, however
+   fragmented the pool is.
+
+   A free block keeps its list element in its first page.  A byte
+   per page, in the pool's `orders' array, records whether a page
+   starts a free block and the block's order. */
+
+/* Number of block orders.  The largest block has
+   2**(ORDER_CNT - 1) pages. */
+#define ORDER_CNT 20
+
+/* Flag in `orders' marking the first page of a free block; the
+   rest of the byte is the block's order. */
+#define FREE_HEAD 0x80
+
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    struct spinlock lock;               /* Mutual exclusion. */
+    uint8_t *orders;                    /* Free block state, per page. */
+    size_t page_cnt;                    /* Number of pages. */
     uint8_t *base;                      /* Base of pool. */
+    struct list free_lists[ORDER_CNT];  /* Free blocks of each order. */
+    size_t free_cnt[ORDER_CNT];         /* Number of free blocks of each order. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Pre-zeroed user pages.
+
+   A page fault that brings in a new user page asks for a zeroed
+   page, and zeroing it used to take a 4 kB memset() inside the
+   fault.  Instead, the idle thread takes free pages out of the
+   user pool, zeroes them, and keeps up to zeroed_target of them
+   on hand, so that a request for a single zeroed user page can
+   usually be served without touching the page at all.  The
+   zeroed pages go back to the user pool when it runs out.
+
+   The members below are protected by the user pool's lock. */
+
+/* Most pre-zeroed pages that can be kept on hand. */
+#define ZEROED_MAX 256
+
+/* -zero-pages: Number of pre-zeroed user pages to keep on hand,
+   0 to zero every page on request. */
+size_t palloc_zero_pages = 64;
+
+static void *zeroed_pages[ZEROED_MAX];  /* Pre-zeroed pages. */
+static size_t zeroed_cnt;               /* Number of pre-zeroed pages. */
+static volatile size_t zeroing_cnt;     /* # of pages being zeroed now. */
+static size_t zeroed_target;            /* Most pre-zeroed pages to keep. */
+static long long zeroed_hits;           /* # of requests served by them. */
+static long long zeroed_misses;         /* # of requests zeroed on the spot. */
+static long long zeroed_filled;         /* # of pages zeroed while idle. */
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -59,6 +115,182 @@ palloc_init (size_t user_page_limit)
   init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
   init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
              user_pages, "user pool");
+
+  /* Don't let the pre-zeroed pages tie up much of the user pool. */
+  zeroed_target = palloc_zero_pages;
+  if (zeroed_target > ZEROED_MAX)
+    zeroed_target = ZEROED_MAX;
+  if (zeroed_target > user_pool.page_cnt / 8)
+    zeroed_target = user_pool.page_cnt / 8;
+}
+
+/* Returns the smallest order whose blocks have at least PAGE_CNT
+   pages. */
+static int
+order_for (size_t page_cnt)
+{
+  int order = 0;
+
+  while (((size_t) 1 << order) < page_cnt)
+    order++;
+  return order;
+}
+
+/* Returns the first page of the free block whose list element is
+   ELEM. */
+static size_t
+block_idx (const struct pool *pool, struct list_elem *elem)
+{
+  return pg_no (elem) - pg_no (pool->base);
+}
+
+/* Adds the block of 2**ORDER pages at PAGE_IDX to POOL's free
+   lists, without merging it. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order)
+{
+  struct list_elem *elem = (struct list_elem *) (pool->base
+                                                 + page_idx * PGSIZE);
+
+  pool->orders[page_idx] = FREE_HEAD | order;
+  list_push_front (&pool->free_lists[order], elem);
+  pool->free_cnt[order]++;
+}
+
+/* Removes the free block at PAGE_IDX, of order ORDER, from POOL's
+   free lists. */
+static void
+remove_block (struct pool *pool, size_t page_idx, int order)
+{
+  ASSERT (pool->orders[page_idx] == (FREE_HEAD | order));
+
+  list_remove ((struct list_elem *) (pool->base + page_idx * PGSIZE));
+  pool->orders[page_idx] = 0;
+  pool->free_cnt[order]--;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX into POOL,
+   merging it with its buddy for as long as that is free. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order)
+{
+  while (order < ORDER_CNT - 1)
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+
+      if (buddy + ((size_t) 1 << order) > pool->page_cnt
+          || pool->orders[buddy] != (FREE_HEAD | order))
+        break;
+      remove_block (pool, buddy, order);
+      if (buddy < page_idx)
+        page_idx = buddy;
+      order++;
+    }
+  push_block (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX into POOL, as the
+   fewest aligned blocks that cover them. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  size_t end = page_idx + page_cnt;
+
+  while (page_idx < end)
+    {
+      int order = 0;
+
+      ASSERT (pool->orders[page_idx] == 0);
+
+      while (order < ORDER_CNT - 1
+             && page_idx % ((size_t) 2 << order) == 0
+             && page_idx + ((size_t) 2 << order) <= end)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+    }
+}
+
+/* Takes PAGE_CNT contiguous pages out of POOL and returns the
+   index of the first one, or SIZE_MAX if no free block is large
+   enough. */
+static size_t
+alloc_pages (struct pool *pool, size_t page_cnt)
+{
+  int order = order_for (page_cnt);
+  size_t page_idx;
+  int j;
+
+  if (order >= ORDER_CNT)
+    return SIZE_MAX;
+
+  /* Take the smallest free block that is large enough. */
+  for (j = order; j < ORDER_CNT; j++)
+    if (!list_empty (&pool->free_lists[j]))
+      break;
+  if (j == ORDER_CNT)
+    return SIZE_MAX;
+  page_idx = block_idx (pool, list_front (&pool->free_lists[j]));
+  remove_block (pool, page_idx, j);
+
+  /* Split it down to ORDER, freeing the upper halves. */
+  while (j > order)
+    {
+      j--;
+      push_block (pool, page_idx + ((size_t) 1 << j), j);
+    }
+
+  /* Give back the pages past PAGE_CNT. */
+  if (((size_t) 1 << order) > page_cnt)
+    free_range (pool, page_idx + page_cnt, ((size_t) 1 << order) - page_cnt);
+
+  return page_idx;
+}
+
+/* Takes a page out of the pre-zeroed pages and returns it, or
+   returns a null pointer if there is none.  The user pool's lock
+   must be held. */
+static void *
+take_zeroed (void)
+{
+  ASSERT (spinlock_held_by_current_cpu (&user_pool.lock));
+
+  if (zeroed_cnt == 0)
+    {
+      zeroed_misses++;
+      return NULL;
+    }
+  zeroed_hits++;
+  return zeroed_pages[--zeroed_cnt];
+}
+
+/* Gives the pre-zeroed pages back to the user pool, after waiting
+   for those that other CPUs are zeroing.  Returns true if there
+   were any.  The user pool's lock must be held, with interrupts
+   off; it is dropped while waiting.  No page can be halfway
+   zeroed on this CPU, because palloc_zero_idle() keeps
+   interrupts off. */
+static bool
+reclaim_zeroed (void)
+{
+  ASSERT (spinlock_held_by_current_cpu (&user_pool.lock));
+
+  if (zeroed_cnt == 0 && zeroing_cnt == 0)
+    return false;
+
+  while (zeroing_cnt > 0)
+    {
+      spinlock_release (&user_pool.lock);
+      while (zeroing_cnt > 0)
+        asm volatile ("pause");
+      spinlock_acquire (&user_pool.lock);
+    }
+  while (zeroed_cnt > 0)
+    {
+      void *page = zeroed_pages[--zeroed_cnt];
+      free_range (&user_pool, pg_no (page) - pg_no (user_pool.base), 1);
+    }
+  return true;
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
@@ -71,24 +303,36 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-  void *pages;
+  enum intr_level old_level;
+  void *pages = NULL;
+  bool zero = (flags & PAL_ZERO) != 0;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
-
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
+  old_level = intr_disable ();
+  spinlock_acquire (&pool->lock);
+  if (pool == &user_pool && page_cnt == 1 && zero)
+    {
+      pages = take_zeroed ();
+      if (pages != NULL)
+        zero = false;
+    }
+  if (pages == NULL)
+    {
+      page_idx = alloc_pages (pool, page_cnt);
+      if (page_idx == SIZE_MAX && pool == &user_pool && reclaim_zeroed ())
+        page_idx = alloc_pages (pool, page_cnt);
+      if (page_idx != SIZE_MAX)
+        pages = pool->base + PGSIZE * page_idx;
+    }
+  spinlock_release (&pool->lock);
+  intr_set_level (old_level);
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      if (zero)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else 
@@ -118,6 +362,7 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
@@ -132,13 +377,17 @@ palloc_free_multiple (void *pages, size_t page_cnt)
     NOT_REACHED ();
 
   page_idx = pg_no (pages) - pg_no (pool->base);
+  ASSERT (page_idx + page_cnt <= pool->page_cnt);
 
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  old_level = intr_disable ();
+  spinlock_acquire (&pool->lock);
+  free_range (pool, page_idx, page_cnt);
+  spinlock_release (&pool->lock);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,25 +397,137 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Zeroes a free user page and adds it to the pre-zeroed pages, if
+   there are fewer of them than the target.  Returns true if it
+   did, false if there was nothing to do.
+
+   Called by the idle threads when there is nothing else to run.
+   Interrupts must be off, and stay off while the page is zeroed,
+   about a microsecond, so that the page is done by the time the
+   CPU is needed again. */
+bool
+palloc_zero_idle (void)
+{
+  size_t page_idx = SIZE_MAX;
+  void *page;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  spinlock_acquire (&user_pool.lock);
+  if (zeroed_cnt + zeroing_cnt < zeroed_target)
+    {
+      page_idx = alloc_pages (&user_pool, 1);
+      if (page_idx != SIZE_MAX)
+        zeroing_cnt++;
+    }
+  spinlock_release (&user_pool.lock);
+  if (page_idx == SIZE_MAX)
+    return false;
+
+  page = user_pool.base + PGSIZE * page_idx;
+  memset (page, 0, PGSIZE);
+
+  spinlock_acquire (&user_pool.lock);
+  zeroed_pages[zeroed_cnt++] = page;
+  zeroed_filled++;
+  zeroing_cnt--;
+  spinlock_release (&user_pool.lock);
+  return true;
+}
+
+/* Copies the pre-zeroed page counters into *STATS. */
+void
+palloc_get_zero_stats (struct palloc_zero_stats *stats)
+{
+  enum intr_level old_level = intr_disable ();
+
+  spinlock_acquire (&user_pool.lock);
+  stats->ready = zeroed_cnt;
+  stats->target = zeroed_target;
+  stats->hits = zeroed_hits;
+  stats->misses = zeroed_misses;
+  stats->filled = zeroed_filled;
+  spinlock_release (&user_pool.lock);
+  intr_set_level (old_level);
+}
+
+/* Prints the number of free blocks of each order in POOL, named
+   NAME. */
+static void
+print_pool_stats (struct pool *pool, const char *name)
+{
+  size_t free_cnt[ORDER_CNT];
+  size_t free_pages = 0;
+  enum intr_level old_level;
+  int order, top = 0;
+
+  old_level = intr_disable ();
+  spinlock_acquire (&pool->lock);
+  memcpy (free_cnt, pool->free_cnt, sizeof free_cnt);
+  spinlock_release (&pool->lock);
+  intr_set_level (old_level);
+
+  for (order = 0; order < ORDER_CNT; order++)
+    {
+      free_pages += free_cnt[order] << order;
+      if (free_cnt[order] != 0)
+        top = order + 1;
+    }
+
+  printf ("Palloc %s: %zu of %zu pages free, blocks by order:",
+          name, free_pages, pool->page_cnt);
+  for (order = 0; order < top; order++)
+    printf (" %zu", free_cnt[order]);
+  printf ("\n");
+}
+
+/* Prints the free blocks of each order in both pools, and how
+   well the pre-zeroed pages served requests for zeroed pages. */
+void
+palloc_print_stats (void) 
+{
+  struct palloc_zero_stats z;
+  long long requests;
+
+  print_pool_stats (&kernel_pool, "kernel");
+  print_pool_stats (&user_pool, "user");
+
+  palloc_get_zero_stats (&z);
+  requests = z.hits + z.misses;
+  printf ("Palloc zeroed: %zu of %zu pages ready, %lld hits, %lld misses "
+          "(%lld%% hits), %lld zeroed while idle\n",
+          z.ready, z.target, z.hits, z.misses,
+          requests > 0 ? z.hits * 100 / requests : 0, z.filled);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's orders array at its base.
+     Calculate the space needed for it
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  size_t meta_pages = DIV_ROUND_UP (page_cnt, PGSIZE);
+  int order;
+  if (meta_pages > page_cnt)
+    PANIC ("Not enough memory in %s for block orders.", name);
+  page_cnt -= meta_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  spinlock_init (&p->lock, name);
+  p->orders = base;
+  memset (p->orders, 0, page_cnt);
+  p->page_cnt = page_cnt;
+  p->base = base + meta_pages * PGSIZE;
+  for (order = 0; order < ORDER_CNT; order++)
+    {
+      list_init (&p->free_lists[order]);
+      p->free_cnt[order] = 0;
+    }
+  free_range (p, 0, page_cnt);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -176,7 +537,7 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 /* How to allocate pages. */
@@ -11,10 +12,25 @@ enum palloc_flags
     PAL_USER = 004              /* User page. */
   };
 
+/* Counters of the pre-zeroed user pages. */
+struct palloc_zero_stats
+  {
+    size_t ready;               /* Pre-zeroed pages on hand. */
+    size_t target;              /* Most pre-zeroed pages kept. */
+    long long hits;             /* # of requests served pre-zeroed. */
+    long long misses;           /* # of requests zeroed on the spot. */
+    long long filled;           /* # of pages zeroed while idle. */
+  };
+
+extern size_t palloc_zero_pages;
+
 void palloc_init (size_t user_page_limit);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+bool palloc_zero_idle (void);
+void palloc_get_zero_stats (struct palloc_zero_stats *);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
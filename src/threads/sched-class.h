@@ -0,0 +1,100 @@
+#ifndef THREADS_SCHED_CLASS_H
+#define THREADS_SCHED_CLASS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct thread;
+
+/* A scheduling class, that is, one scheduling policy.
+
+   Every thread belongs to one class, pointed to by its
+   `sched_class' member, and thread.c only reaches the policies
+   through these hooks.  Classes are ranked: a ready thread of a
+   higher-ranked class always runs before the threads of the lower
+   ones, so thread.c asks each class in turn, highest rank first,
+   for the next thread to run.
+
+   The lowest-ranked class is the base class that new threads
+   start in: round-robin (scheduler.c), with "-mlfqs" the
+   multi-level feedback queue scheduler (mlfq-scheduler.c), or
+   with "-cfs" the completely fair scheduler (cfs-scheduler.c).
+   Above it sits the earliest-deadline-first class
+   (edf-scheduler.c) for threads that declared a reservation.
+
+   Hooks marked "optional" may be null.  Except for init(),
+   thread_init(), set_priority() and set_nice(), every hook is
+   called with sched_lock held. */
+struct sched_class
+  {
+    const char *name;
+    int rank;                   /* Higher ranks run first. */
+
+    /* Initializes the class.  Called once by thread_init(),
+       before any thread exists.  Optional. */
+    void (*init) (void);
+
+    /* Initializes the class's state in new thread T, created
+       with PRIORITY.  Only called on the base class.  Optional. */
+    void (*thread_init) (struct thread *t, int priority);
+
+    /* Puts ready thread T in the run queue of CPU T->cpu. */
+    void (*enqueue) (struct thread *t);
+
+    /* Takes ready thread T out of its run queue. */
+    void (*dequeue) (struct thread *t);
+
+    /* Removes and returns the thread that should run next from
+       CPU's run queue, or returns a null pointer if it is
+       empty. */
+    struct thread *(*pick_next) (int cpu);
+
+    /* Called on each timer tick for T, which is running on the
+       current CPU and has run for the current CPU's thread_ticks
+       ticks, this one included.  May move T to another class.
+       Returns true if T should be preempted.  Optional: without
+       it, T is preempted after TIME_SLICE ticks. */
+    bool (*tick) (struct thread *t);
+
+    /* Called on each timer tick by the CPU that counts
+       timer_ticks(), which is TICKS.  Optional. */
+    void (*system_tick) (int64_t ticks);
+
+    /* Returns the first tick after NOW at which system_tick()
+       must run, or LIMIT if none comes before it.  Lets the
+       tickless timer hold the timer interrupt off.  Optional. */
+    int64_t (*next_event) (int64_t now, int64_t limit);
+
+    /* Returns true if ready thread T should take the CPU from
+       CUR.  Both belong to this class. */
+    bool (*yield_check) (struct thread *cur, struct thread *t);
+
+    /* Returns true if T, waiting on a semaphore or condition
+       variable, should be woken before U.  Both belong to this
+       class.  Unlike yield_check(), which may leave some slack,
+       this must be a strict weak order, because it orders the
+       waiter heaps. */
+    bool (*wakes_before) (struct thread *t, struct thread *u);
+
+    /* Returns T's priority, as reported by thread_get_priority(),
+       and sets the current thread's.  Only called on the base
+       class; set_priority() is optional. */
+    int (*priority) (struct thread *t);
+    void (*set_priority) (int priority);
+
+    /* Return T's nice value, as reported by thread_get_nice(),
+       and set the current thread's.  Only called on the base
+       class.  Optional, both or neither. */
+    int (*get_nice) (struct thread *t);
+    void (*set_nice) (int nice);
+  };
+
+extern const struct sched_class rr_sched_class;
+extern const struct sched_class mlfq_sched_class;
+extern const struct sched_class cfs_sched_class;
+extern const struct sched_class edf_sched_class;
+
+const struct sched_class *thread_base_sched_class (void);
+void thread_set_sched_class (struct thread *, const struct sched_class *);
+
+#endif /* threads/sched-class.h */
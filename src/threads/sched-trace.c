@@ -0,0 +1,194 @@
+#include "threads/sched-trace.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include <kernel/ringbuffer.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/spinlock.h"
+#include "devices/timer.h"
+#ifdef FILESYS
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#endif
+
+/* Number of events the ring holds. */
+#define SCHED_TRACE_SIZE 4096
+
+/* Bytes per line of a console dump. */
+#define DUMP_LINE 32
+
+typedef struct sched_event sched_event_t;
+RINGBUFFER (sched_event_t, SCHED_TRACE_SIZE);
+
+bool sched_trace_enabled;
+
+/* The ring and the count of events pushed out of it, protected
+   by trace_lock.  Tracing happens inside the scheduler, which
+   holds sched_lock, so trace_lock must be a lock of its own that
+   nothing else is taken under. */
+static struct ringbuffer_sched_event_t ring;
+static uint32_t dropped;
+static struct spinlock trace_lock = SPINLOCK_INITIALIZER ("sched-trace");
+
+/* When tracing started, to calibrate the TSC against the timer. */
+static uint64_t start_tsc;
+static int64_t start_ticks;
+
+/* Header of the trace, filled in by sched_trace_stop(). */
+static struct sched_trace_header header;
+static bool stopped;
+
+/* Starts tracing, for the "-sched-trace" option. */
+void
+sched_trace_start (void)
+{
+  RINGBUFFER_INIT (ring, SCHED_TRACE_SIZE);
+  start_tsc = rdtsc ();
+  start_ticks = timer_ticks ();
+  sched_trace_enabled = true;
+}
+
+/* Records an event of TYPE about thread TID.  Don't call
+   directly, use SCHED_TRACE. */
+void
+sched_trace_record (enum sched_event_type type, int tid, int arg, int aux)
+{
+  enum intr_level old_level = intr_disable ();
+  sched_event_t ev;
+
+  ev.tsc = rdtsc ();
+  ev.tid = tid;
+  ev.arg = arg;
+  ev.type = type;
+  ev.cpu = cpu_current ()->id;
+  ev.aux = aux;
+
+  spinlock_acquire (&trace_lock);
+  if (sched_trace_enabled)
+    {
+      if (RINGBUFFER_IS_FULL (ring))
+        dropped++;
+      RINGBUFFER_PUSH (ring, ev);
+    }
+  spinlock_release (&trace_lock);
+  intr_set_level (old_level);
+}
+
+/* Stops tracing for good and fills in the header, so that the
+   trace can be read out. */
+static void
+sched_trace_stop (void)
+{
+  enum intr_level old_level;
+
+  if (stopped)
+    return;
+
+  /* Once trace_lock is released, no event is being recorded
+     any more. */
+  old_level = intr_disable ();
+  spinlock_acquire (&trace_lock);
+  sched_trace_enabled = false;
+  stopped = true;
+  spinlock_release (&trace_lock);
+  intr_set_level (old_level);
+
+  memcpy (header.magic, SCHED_TRACE_MAGIC, sizeof header.magic);
+  header.version = SCHED_TRACE_VERSION;
+  header.event_size = sizeof (struct sched_event);
+  header.event_cnt = start_tsc != 0 ? RINGBUFFER_COUNT (ring) : 0;
+  header.dropped = dropped;
+
+  const int64_t elapsed = timer_elapsed (start_ticks);
+  if (start_tsc != 0 && elapsed > 0)
+    header.tsc_hz = (rdtsc () - start_tsc) * TIMER_FREQ / elapsed;
+}
+
+/* Returns the size of the trace, in bytes. */
+static size_t
+sched_trace_size (void)
+{
+  ASSERT (stopped);
+  return sizeof header + header.event_cnt * sizeof (struct sched_event);
+}
+
+/* Copies up to SIZE bytes of the trace, from byte OFFSET, into
+   BUFFER.  Returns the number of bytes copied. */
+static size_t
+sched_trace_read (void *buffer_, size_t offset, size_t size)
+{
+  uint8_t *buffer = buffer_;
+  size_t total = sched_trace_size ();
+  size_t n;
+
+  for (n = 0; n < size && offset < total; n++, offset++)
+    if (offset < sizeof header)
+      buffer[n] = ((const uint8_t *) &header)[offset];
+    else
+      {
+        size_t ev_ofs = offset - sizeof header;
+        const sched_event_t *ev
+          = &RINGBUFFER_AT (ring, ev_ofs / sizeof *ev);
+        buffer[n] = ((const uint8_t *) ev)[ev_ofs % sizeof *ev];
+      }
+  return n;
+}
+
+/* Stops tracing and dumps the trace to the console in hex, if
+   tracing is on.  Called at shutdown. */
+void
+sched_trace_print (void)
+{
+  uint8_t line[DUMP_LINE];
+  size_t offset, n, i;
+
+  if (!sched_trace_enabled)
+    return;
+
+  sched_trace_stop ();
+  printf ("sched-trace: begin %zu bytes\n", sched_trace_size ());
+  for (offset = 0; (n = sched_trace_read (line, offset, sizeof line)) > 0;
+       offset += n)
+    {
+      printf ("ST ");
+      for (i = 0; i < n; i++)
+        printf ("%02x", line[i]);
+      printf ("\n");
+    }
+  printf ("sched-trace: end\n");
+}
+
+#ifdef FILESYS
+/* "sched-trace-save FILE" action: stops tracing and saves the
+   trace as FILE in the file system, from where `pintos -g' can
+   copy it out. */
+void
+sched_trace_save (char **argv)
+{
+  const char *file_name = argv[1];
+  struct file *file;
+  uint8_t *buffer;
+  size_t offset, n;
+
+  sched_trace_stop ();
+  printf ("Saving scheduler trace to '%s'...\n", file_name);
+
+  if (!filesys_create (file_name, sched_trace_size ()))
+    PANIC ("%s: create failed", file_name);
+  file = filesys_open (file_name);
+  if (file == NULL)
+    PANIC ("%s: open failed", file_name);
+
+  buffer = palloc_get_page (PAL_ASSERT);
+  for (offset = 0; (n = sched_trace_read (buffer, offset, PGSIZE)) > 0;
+       offset += n)
+    if ((size_t) file_write (file, buffer, n) != n)
+      PANIC ("%s: write failed", file_name);
+
+  palloc_free_page (buffer);
+  file_close (file);
+}
+#endif /* FILESYS */
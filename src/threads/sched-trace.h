@@ -0,0 +1,72 @@
+#ifndef THREADS_SCHED_TRACE_H
+#define THREADS_SCHED_TRACE_H
+
+#include <packed.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Scheduler event tracing.
+
+   With the "-sched-trace" kernel option, the scheduler records
+   what it does into a fixed-size ring, overwriting the oldest
+   events once it is full.  The ring is dumped to the console at
+   shutdown, or, in kernels with a file system, saved to a file
+   by the "sched-trace-save FILE" action, to be copied out of the
+   VM with `pintos -g FILE'.  utils/sched-trace-report analyzes
+   either form.
+
+   The values below are part of the trace format: append to them,
+   don't renumber them. */
+enum sched_event_type
+  {
+    SCHED_EV_SWITCH = 1,        /* TID starts running, ARG stopped, AUX its status. */
+    SCHED_EV_WAKEUP = 2,        /* TID made ready by ARG, on CPU AUX. */
+    SCHED_EV_BLOCK = 3,         /* TID blocks. */
+    SCHED_EV_DONATE = 4,        /* TID donates priority AUX to ARG. */
+    SCHED_EV_PREEMPT = 5        /* TID asked to yield, for ARG or -1 at slice end. */
+  };
+
+/* One recorded event. */
+struct sched_event
+  {
+    uint64_t tsc;               /* Time stamp counter of CPU. */
+    int32_t tid;                /* Thread the event is about. */
+    int32_t arg;                /* Depends on TYPE. */
+    uint8_t type;               /* A sched_event_type. */
+    uint8_t cpu;                /* CPU the event happened on. */
+    int16_t aux;                /* Depends on TYPE. */
+  } PACKED;
+
+/* Start of a saved or dumped trace, followed by EVENT_CNT
+   struct sched_events, oldest first.  All little-endian. */
+#define SCHED_TRACE_MAGIC "PSCHEDTR"
+#define SCHED_TRACE_VERSION 1
+struct sched_trace_header
+  {
+    char magic[8];              /* SCHED_TRACE_MAGIC, without null. */
+    uint32_t version;           /* SCHED_TRACE_VERSION. */
+    uint32_t event_size;        /* sizeof (struct sched_event). */
+    uint32_t event_cnt;         /* # of events that follow. */
+    uint32_t dropped;           /* # of older events overwritten. */
+    uint64_t tsc_hz;            /* TSC ticks per second, 0 if unknown. */
+  } PACKED;
+
+/* True while tracing.  Tested inline, so that a trace point
+   costs a single, normally not taken, branch when off. */
+extern bool sched_trace_enabled;
+
+#define SCHED_TRACE(TYPE, TID, ARG, AUX)                        \
+        do                                                      \
+          {                                                     \
+            if (__builtin_expect (sched_trace_enabled, 0))      \
+              sched_trace_record (TYPE, TID, ARG, AUX);         \
+          }                                                     \
+        while (0)
+
+void sched_trace_start (void);
+void sched_trace_record (enum sched_event_type, int tid, int arg, int aux);
+void sched_trace_print (void);
+void sched_trace_save (char **argv);
+
+#endif /* threads/sched-trace.h */
@@ -1,87 +1,195 @@
 #include "thread.h"
 #include "scheduler.h"
+#include "cpu.h"
 #include "interrupt.h"
 #include "list.h"
 #include "synch.h"
+#include "sched-trace.h"
 
-#define MAX_RECURSION 10
+#include <kernel/priority-bitmap.h>
 
+#define NUMBER_QUEUES (PRI_MAX + 1)
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running, one FIFO queue per
+   effective priority for each CPU.  Bit N of a CPU's bitmap is
+   set iff its queue N is non-empty.  Protected by sched_lock. */
+struct rr_run_queue {
+  struct list queues[NUMBER_QUEUES];
+  struct priority_bitmap bitmap;
+};
+static struct rr_run_queue run_queues[CPU_MAX];
 
 void rr_scheduler_init (void) {
-  list_init (&ready_list);
+  for (size_t cpu = 0; cpu < CPU_MAX; cpu++) {
+    for (size_t i = 0; i < NUMBER_QUEUES; i++) {
+      list_init (&run_queues[cpu].queues[i]);
+    }
+
+    priority_bitmap_init (&run_queues[cpu].bitmap);
+  }
 }
 
-static bool thread_list_eq_func (const struct list_elem *list_elem, const struct list_elem *target, void *aux UNUSED) {
-  return list_elem == target;
+/* Returns T's effective priority.  This is cached in T and
+   kept up to date by the donation code below, so it takes no
+   locks and can be used freely by comparators. */
+int rr_thread_priority (struct thread * t) {
+  ASSERT (t != NULL);
+
+  return t->rr_thread_block.effective_priority;
+} 
+
+/* Queues T at the back of the queue of CPU T->cpu matching its
+   effective priority. */
+static void ready_queue_push (struct thread* t) {
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
+
+  struct rr_run_queue *rq = &run_queues[t->cpu];
+  const int pri = t->rr_thread_block.effective_priority;
+  list_push_back (&rq->queues[pri], &t->elem);
+  priority_bitmap_set (&rq->bitmap, pri);
 }
 
-static struct thread * find_thread (struct list* threads, struct thread* target) {
+static void ready_queue_remove (struct thread* t) {
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
 
-  struct list_elem * found = list_find (threads, thread_list_eq_func, &target->elem, NULL); 
-  if (found == NULL)
-    return NULL;
+  struct rr_run_queue *rq = &run_queues[t->cpu];
+  const int pri = t->rr_thread_block.effective_priority;
+  list_remove (&t->elem);
+  if (list_empty (&rq->queues[pri]))
+    priority_bitmap_clear (&rq->bitmap, pri);
+}
 
-  return list_entry (found, struct thread, elem);
+/* Sets T's effective priority to PRI, moving T to the matching
+   ready queue if it is ready. */
+static void set_effective_priority (struct thread* t, int pri) {
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
+
+  if (t->rr_thread_block.effective_priority == pri)
+    return;
+
+  /* A ready thread of another class is in that class's queue. */
+  if (t->status == THREAD_READY && t->sched_class == &rr_sched_class) {
+    ready_queue_remove (t);
+    t->rr_thread_block.effective_priority = pri;
+    ready_queue_push (t);
+  } else {
+    t->rr_thread_block.effective_priority = pri;
+    synch_waiter_rekey (t);
+  }
 }
 
-static int rr_thread_priority_recursive (struct thread * t, unsigned int max_recursions) {
-  if (t == NULL || max_recursions == 0) {
-    return PRI_MIN;
+/* Returns the highest of T's base priority, its donors'
+   effective priorities and the priorities of the threads waiting
+   for the reader-writer locks it holds.  T must be the running
+   thread. */
+static int donated_priority (struct thread* t) {
+  int pri = MAX(t->rr_thread_block.priority, rwlock_waiter_priority (t));
+
+  struct list_elem *e;
+  for (e = list_begin (&t->rr_thread_block.donors); e != list_end (&t->rr_thread_block.donors); e = list_next (e)) {
+    const struct thread *donor = list_entry (e, struct thread, rr_thread_block.donor_elem);
+    pri = MAX(pri, donor->rr_thread_block.effective_priority);
   }
 
-  lock_acquire (&t->rr_thread_block.priority_donors_lock);
-  int max_pri = t->rr_thread_block.priority;
-  for (size_t i = 0; i < t->rr_thread_block.priority_donors.curr_size; i++) {
-    const int parent_pri = rr_thread_priority_recursive (t->rr_thread_block.priority_donors.data[i], max_recursions - 1);
-    max_pri = MAX(max_pri, parent_pri); 
+  return pri;
+}
+
+/* Raises the effective priority of every thread along the
+   donation chain starting at T to at least PRI.  Stops at the
+   first thread that already has it, since the rest of the chain
+   then has it too. */
+static void propagate_donation (struct thread* t, int pri) {
+  for (; t != NULL && t->rr_thread_block.effective_priority < pri; t = t->rr_thread_block.donee)
+    set_effective_priority (t, pri);
+}
+
+/* DONATOR is about to wait for LOCK: donates its priority to the
+   holder of LOCK, and through it to the whole chain of holders it
+   waits for. */
+void rr_donate_priority (struct thread* donator, struct lock* lock) {
+  enum intr_level old_level = sched_lock_acquire ();
+
+  /* The holder may have released LOCK since the caller looked. */
+  struct thread *holder = lock->holder;
+  if (holder != NULL) {
+    list_push_back (&holder->rr_thread_block.donors, &donator->rr_thread_block.donor_elem);
+    donator->rr_thread_block.donee = holder;
+    donator->rr_thread_block.waiting_lock = lock;
+    SCHED_TRACE (SCHED_EV_DONATE, donator->tid, holder->tid,
+                 donator->rr_thread_block.effective_priority);
+    propagate_donation (holder, donator->rr_thread_block.effective_priority);
   }
-  lock_release (&t->rr_thread_block.priority_donors_lock);
 
-  return max_pri;
+  sched_lock_release (old_level);
 }
 
-int rr_thread_priority (struct thread * t) {
-  ASSERT (t != NULL);
+/* The current thread is releasing LOCK: takes back the donations
+   of the threads waiting for it. */
+void rr_undonate_priority (struct lock* lock) {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level = sched_lock_acquire ();
+
+  struct list_elem *e = list_begin (&cur->rr_thread_block.donors);
+  while (e != list_end (&cur->rr_thread_block.donors)) {
+    struct thread *donor = list_entry (e, struct thread, rr_thread_block.donor_elem);
+    if (donor->rr_thread_block.waiting_lock == lock) {
+      e = list_remove (e);
+      donor->rr_thread_block.donee = NULL;
+      donor->rr_thread_block.waiting_lock = NULL;
+    } else {
+      e = list_next (e);
+    }
+  }
+
+  /* Running threads wait for no lock, so there is nothing to
+     propagate. */
+  set_effective_priority (cur, donated_priority (cur));
 
-  return rr_thread_priority_recursive (t, MAX_RECURSION);
+  sched_lock_release (old_level);
 } 
 
-void rr_try_donate_priority (struct thread* donator, struct thread* recepient) {
-  
-  lock_acquire (&recepient->rr_thread_block.priority_donors_lock);
-  ARRAY_TRY_PUSH (recepient->rr_thread_block.priority_donors, donator);
-  lock_release (&recepient->rr_thread_block.priority_donors_lock);
+/* DONATOR is about to wait for RW: donates its priority to every
+   thread holding RW, readers included, and through each to the
+   chain of lock holders it waits for.  A donation does not go on
+   past a holder that itself waits for a reader-writer lock. */
+void rr_donate_priority_rw (struct thread* donator, struct rwlock* rw) {
+  enum intr_level old_level = sched_lock_acquire ();
+
+  const int pri = donator->rr_thread_block.effective_priority;
+  struct list_elem *e;
+  for (e = list_begin (&rw->holders); e != list_end (&rw->holders); e = list_next (e)) {
+    struct rwlock_hold *hold = list_entry (e, struct rwlock_hold, elem);
+    SCHED_TRACE (SCHED_EV_DONATE, donator->tid, hold->thread->tid, pri);
+    propagate_donation (hold->thread, pri);
+  }
 
+  sched_lock_release (old_level);
 }
 
-void rr_try_undonate_priority (struct list* search_threads, struct thread* target) {
-  lock_acquire (&target->rr_thread_block.priority_donors_lock);
+/* The current thread released a reader-writer lock: takes back
+   the donations of the threads waiting for it. */
+void rr_undonate_priority_rw (void) {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level = sched_lock_acquire ();
 
-  for (size_t i = 0; i < target->rr_thread_block.priority_donors.curr_size; ) {
-    struct thread * found = find_thread (search_threads, target->rr_thread_block.priority_donors.data[i]);
-    if (found != NULL) {
-      
-      ARRAY_REMOVE(target->rr_thread_block.priority_donors, i);
-    } else {
-      i++;
-    } 
-  }
+  set_effective_priority (cur, donated_priority (cur));
 
-  lock_release (&target->rr_thread_block.priority_donors_lock);
-} 
+  sched_lock_release (old_level);
+}
 
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void
 rr_thread_set_priority (int new_priority) 
 {
+  struct thread *cur = thread_current ();
   const int curr_pri = thread_get_priority();
   
-  // TODO maybe add lock here? Is it necessary?
-  thread_current ()->rr_thread_block.priority = new_priority;
+  enum intr_level old_level = sched_lock_acquire ();
+  cur->rr_thread_block.priority = new_priority;
+  set_effective_priority (cur, donated_priority (cur));
+  sched_lock_release (old_level);
   
   const int new_pri = thread_get_priority();
   if (new_pri < curr_pri)
@@ -91,18 +199,52 @@ rr_thread_set_priority (int new_priority)
 void 
 rr_thread_init (struct thread *t, int priority) {
   t->rr_thread_block.priority = priority;
-  ARRAY_INIT(t->rr_thread_block.priority_donors, DONORS_ARR_SIZE);
-  lock_init (&t->rr_thread_block.priority_donors_lock);
+  t->rr_thread_block.effective_priority = priority;
+  list_init (&t->rr_thread_block.donors);
+  t->rr_thread_block.donee = NULL;
+  t->rr_thread_block.waiting_lock = NULL;
 }
 
 void rr_insert_ready_thread (struct thread* t) {
-  list_push_back (&ready_list, &t->elem);
+  ready_queue_push (t);
 }
 
-struct thread * rr_next_thread_to_run (void) 
+struct thread * rr_next_thread_to_run (int cpu) 
 {
-  if (list_empty (&ready_list))
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
+
+  struct rr_run_queue *rq = &run_queues[cpu];
+  const int pri = priority_bitmap_highest (&rq->bitmap);
+  if (pri < 0)
     return NULL;
-  
-  return pop_highest_priority_thread (&ready_list); 
-}
\ No newline at end of file
+
+  struct list_elem * next_elem = list_pop_front (&rq->queues[pri]);
+  if (list_empty (&rq->queues[pri]))
+    priority_bitmap_clear (&rq->bitmap, pri);
+
+  return list_entry (next_elem, struct thread, elem); 
+}
+
+/* A ready thread of higher effective priority preempts. */
+static bool rr_yield_check (struct thread *cur, struct thread *t) {
+  return rr_thread_priority (t) > rr_thread_priority (cur);
+}
+
+/* Waiters of higher effective priority wake first. */
+static bool rr_wakes_before (struct thread *t, struct thread *u) {
+  return rr_thread_priority (t) > rr_thread_priority (u);
+}
+
+const struct sched_class rr_sched_class = {
+  .name = "rr",
+  .rank = 0,
+  .init = rr_scheduler_init,
+  .thread_init = rr_thread_init,
+  .enqueue = rr_insert_ready_thread,
+  .dequeue = ready_queue_remove,
+  .pick_next = rr_next_thread_to_run,
+  .yield_check = rr_yield_check,
+  .wakes_before = rr_wakes_before,
+  .priority = rr_thread_priority,
+  .set_priority = rr_thread_set_priority,
+};
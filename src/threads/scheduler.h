@@ -4,24 +4,33 @@
 #include "thread.h"
 #include <stdbool.h>
 
-#define DONORS_ARR_SIZE 5
-
 struct thread;
-ARRAY_TYPE(thread_arr, struct thread *, DONORS_ARR_SIZE);
+struct lock;
+struct rwlock;
 
+/* Round-robin scheduler state of a thread.  Except for
+   `priority', which belongs to the thread itself, protected by
+   sched_lock. */
 struct rr_thread_block {
-  int priority;                       /* Priority. */
-  struct lock priority_donors_lock;
-  struct array_thread_arr priority_donors;
+  int priority;                       /* Base priority. */
+  int effective_priority;             /* Base priority or highest donation, whichever is higher. */
+  struct list donors;                 /* Threads donating to this one. */
+  struct list_elem donor_elem;        /* Element in the donee's `donors'. */
+  struct thread* donee;               /* Thread this one is donating to, if any. */
+  struct lock* waiting_lock;          /* Lock this one waits for, while donating. */
 };
 
 void rr_scheduler_init (void);
 
 int rr_thread_priority (struct thread * t);
 
-void rr_try_donate_priority (struct thread* donator, struct thread* recepient);
+void rr_donate_priority (struct thread* donator, struct lock* lock);
+
+void rr_undonate_priority (struct lock* lock);
+
+void rr_donate_priority_rw (struct thread* donator, struct rwlock* rw);
 
-void rr_try_undonate_priority (struct list* search_threads, struct thread* target);
+void rr_undonate_priority_rw (void);
 
 void rr_thread_set_priority (int new_priority);
 
@@ -29,6 +38,6 @@ void rr_thread_init (struct thread *t, int priority);
 
 void rr_insert_ready_thread (struct thread* t);
 
-struct thread * rr_next_thread_to_run (void);
+struct thread * rr_next_thread_to_run (int cpu);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Each slab is a single page, which starts with a struct slab.
+   The objects follow, from the first cache line boundary after
+   the header.  A bitmap in the header marks the free objects, so
+   that a free object's memory is left alone and keeps the state
+   its constructor gave it. */
+
+/* Smallest distance between objects, in bytes. */
+#define MIN_STRIDE 16
+
+/* Most objects a slab can hold. */
+#define MAX_OBJS (PGSIZE / MIN_STRIDE)
+
+/* Number of words in a slab's free map. */
+#define MAP_WORDS (MAX_OBJS / 32)
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* A slab. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in the cache's partial list. */
+    size_t free_cnt;            /* Number of free objects. */
+    uint32_t free_map[MAP_WORDS];  /* 1-bits mark free objects. */
+  };
+
+/* All caches that have been used, for statistics. */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+static struct spinlock all_caches_lock = SPINLOCK_INITIALIZER ("kmem caches");
+
+/* Works out the layout of CACHE's slabs, on its first use.
+   CACHE's lock must be held. */
+static void
+setup_cache (struct kmem_cache *cache)
+{
+  size_t stride;
+
+  ASSERT (spinlock_held_by_current_cpu (&cache->lock));
+
+  if (cache->size >= CACHE_LINE_SIZE)
+    stride = ROUND_UP (cache->size, CACHE_LINE_SIZE);
+  else
+    for (stride = MIN_STRIDE; stride < cache->size; stride *= 2)
+      continue;
+
+  cache->obj_ofs = ROUND_UP (sizeof (struct slab), CACHE_LINE_SIZE);
+  if (cache->obj_ofs + stride > PGSIZE)
+    PANIC ("%s objects are too big for a slab", cache->name);
+  cache->obj_cnt = (PGSIZE - cache->obj_ofs) / stride;
+  cache->stride = stride;
+
+  spinlock_acquire (&all_caches_lock);
+  list_push_back (&all_caches, &cache->elem);
+  spinlock_release (&all_caches_lock);
+}
+
+/* Returns object IDX of SLAB. */
+static void *
+slab_object (struct slab *slab, size_t idx)
+{
+  return (uint8_t *) slab + slab->cache->obj_ofs + idx * slab->cache->stride;
+}
+
+/* Turns PAGE into a new slab of CACHE, constructing each of its
+   objects, and returns it. */
+static struct slab *
+create_slab (struct kmem_cache *cache, void *page)
+{
+  struct slab *slab = page;
+  size_t i;
+
+  slab->magic = SLAB_MAGIC;
+  slab->cache = cache;
+  slab->free_cnt = cache->obj_cnt;
+  memset (slab->free_map, 0, sizeof slab->free_map);
+  for (i = 0; i < cache->obj_cnt; i++)
+    {
+      slab->free_map[i / 32] |= 1u << (i % 32);
+      if (cache->ctor != NULL)
+        cache->ctor (slab_object (slab, i));
+    }
+  return slab;
+}
+
+/* Takes a free object out of SLAB and returns it. */
+static void *
+take_object (struct slab *slab)
+{
+  size_t w = 0, idx;
+
+  ASSERT (slab->free_cnt > 0);
+
+  while (slab->free_map[w] == 0)
+    w++;
+  idx = w * 32 + __builtin_ctz (slab->free_map[w]);
+  slab->free_map[w] &= ~(1u << (idx % 32));
+  slab->free_cnt--;
+  return slab_object (slab, idx);
+}
+
+/* Obtains and returns an object from CACHE.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *cache)
+{
+  enum intr_level old_level;
+  struct slab *slab;
+  void *object;
+
+  ASSERT (cache != NULL);
+
+  old_level = intr_disable ();
+  spinlock_acquire (&cache->lock);
+  if (cache->stride == 0)
+    setup_cache (cache);
+
+  /* Find a slab with a free object, creating a new one if need
+     be.  The new page's objects are constructed without holding
+     the lock. */
+  if (!list_empty (&cache->partial))
+    slab = list_entry (list_front (&cache->partial), struct slab, elem);
+  else if (cache->spare != NULL)
+    {
+      slab = cache->spare;
+      cache->spare = NULL;
+      list_push_front (&cache->partial, &slab->elem);
+    }
+  else
+    {
+      void *page;
+
+      spinlock_release (&cache->lock);
+      intr_set_level (old_level);
+
+      page = palloc_get_page (0);
+      if (page == NULL)
+        return NULL;
+      slab = create_slab (cache, page);
+
+      old_level = intr_disable ();
+      spinlock_acquire (&cache->lock);
+      cache->slab_cnt++;
+      list_push_front (&cache->partial, &slab->elem);
+    }
+
+  /* Take an object out of it. */
+  object = take_object (slab);
+  if (slab->free_cnt == 0)
+    list_remove (&slab->elem);
+  cache->in_use++;
+  cache->allocs++;
+  spinlock_release (&cache->lock);
+  intr_set_level (old_level);
+
+  return object;
+}
+
+/* Gives OBJECT, which must have been obtained from CACHE, back to
+   it. */
+void
+kmem_cache_free (struct kmem_cache *cache, void *object)
+{
+  struct slab *slab = pg_round_down (object);
+  struct slab *unused = NULL;
+  enum intr_level old_level;
+  size_t ofs, idx;
+
+  if (object == NULL)
+    return;
+
+  ASSERT (slab->magic == SLAB_MAGIC);
+  ASSERT (slab->cache == cache);
+  ofs = (uint8_t *) object - (uint8_t *) slab - cache->obj_ofs;
+  ASSERT (ofs % cache->stride == 0);
+  idx = ofs / cache->stride;
+  ASSERT (idx < cache->obj_cnt);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     it has to stay constructed. */
+  if (cache->ctor == NULL)
+    memset (object, 0xcc, cache->size);
+#endif
+
+  old_level = intr_disable ();
+  spinlock_acquire (&cache->lock);
+  ASSERT ((slab->free_map[idx / 32] & (1u << (idx % 32))) == 0);
+  slab->free_map[idx / 32] |= 1u << (idx % 32);
+  if (slab->free_cnt++ == 0)
+    list_push_front (&cache->partial, &slab->elem);
+  if (slab->free_cnt == cache->obj_cnt)
+    {
+      /* SLAB is unused.  Keep it as the spare, or give it back. */
+      list_remove (&slab->elem);
+      if (cache->spare == NULL)
+        cache->spare = slab;
+      else
+        {
+          unused = slab;
+          cache->slab_cnt--;
+          cache->slabs_freed++;
+        }
+    }
+  cache->in_use--;
+  cache->frees++;
+  spinlock_release (&cache->lock);
+  intr_set_level (old_level);
+
+  if (unused != NULL)
+    {
+      unused->magic = 0;
+      palloc_free_page (unused);
+    }
+}
+
+/* Prints the usage of every cache that was used.  The waste is
+   the part of the cache's slabs that does not hold an allocated
+   object: padding, headers, the ends of pages and free objects. */
+void
+kmem_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e))
+    {
+      struct kmem_cache *cache = list_entry (e, struct kmem_cache, elem);
+      struct kmem_cache c;
+      enum intr_level old_level = intr_disable ();
+      size_t bytes, waste;
+
+      spinlock_acquire (&cache->lock);
+      c = *cache;
+      spinlock_release (&cache->lock);
+      intr_set_level (old_level);
+
+      bytes = c.slab_cnt * PGSIZE;
+      waste = bytes > 0 ? 100 - c.in_use * c.size * 100 / bytes : 0;
+      printf ("Slab %s: %zu of %zu-byte objects in use, %zu slabs, "
+              "%zu%% waste, %lld allocs, %lld frees, %lld slabs freed\n",
+              c.name, c.in_use, c.size, c.slab_cnt, waste,
+              c.allocs, c.frees, c.slabs_freed);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/spinlock.h"
+
+/* Object caches [Bonwick, "The Slab Allocator: An Object-Caching
+   Kernel Memory Allocator", USENIX Summer 1994].
+
+   A kmem_cache hands out objects of a single type, which it
+   carves out of pages, called slabs, obtained from the page
+   allocator.  Compared with malloc(), it needs no search for the
+   right size class and wastes no memory on rounding to a power
+   of 2, and each cache has a lock of its own.
+
+   Objects are laid out so that none straddles a cache line: an
+   object of at least CACHE_LINE_SIZE bytes starts on a line
+   boundary, and a smaller one is padded to a power of 2.
+
+   If a cache has a constructor, it runs on each object once,
+   when the object's slab is created, not on every allocation.
+   Objects come out of kmem_cache_alloc() in their constructed
+   state and must be given back to kmem_cache_free() in it, e.g.
+   with their locks released and their lists empty.  Without a
+   constructor, the contents of a new object are undefined.
+
+   A slab none of whose objects is in use is given back to the
+   page allocator, except that each cache keeps one such slab in
+   reserve, so that freeing and allocating the same object over
+   and over does not go to the page allocator every time.
+
+   Define a cache with KMEM_CACHE_INITIALIZER; it sets itself up
+   on first use.  kmem_cache_alloc() and kmem_cache_free() may be
+   called from interrupt handlers. */
+
+/* Size of a CPU cache line, in bytes. */
+#define CACHE_LINE_SIZE 64
+
+/* Puts a newly created object into its constructed state. */
+typedef void kmem_ctor (void *object);
+
+struct slab;
+
+/* An object cache.  The members are owned by slab.c. */
+struct kmem_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t size;                /* Size of an object, in bytes. */
+    kmem_ctor *ctor;            /* Constructor, or null. */
+    struct spinlock lock;       /* Protects the members below. */
+    size_t stride;              /* Bytes between objects, 0 before first use. */
+    size_t obj_ofs;             /* Offset of the first object in a slab. */
+    size_t obj_cnt;             /* Number of objects per slab. */
+    struct list partial;        /* Slabs with objects both used and free. */
+    struct slab *spare;         /* Slab with no objects used, or null. */
+    size_t slab_cnt;            /* Number of slabs, including SPARE. */
+    size_t in_use;              /* Number of objects allocated. */
+    long long allocs;           /* # of kmem_cache_alloc() calls. */
+    long long frees;            /* # of kmem_cache_free() calls. */
+    long long slabs_freed;      /* # of slabs given back to palloc. */
+    struct list_elem elem;      /* Element in list of all caches. */
+  };
+
+/* Initializer for a cache named NAME, stored in variable CACHE,
+   of objects of type TYPE, constructed by CTOR if it is not
+   null. */
+#define KMEM_CACHE_INITIALIZER(CACHE, NAME, TYPE, CTOR)                 \
+        { .name = NAME, .size = sizeof (TYPE), .ctor = CTOR,            \
+          .lock = SPINLOCK_INITIALIZER (NAME),                          \
+          .partial = LIST_INITIALIZER ((CACHE).partial) }
+
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -3,78 +3,208 @@
 #include <debug.h>
 
 #include "threads/sleep.h"
-#include "threads/synch.h"
-#include "threads/malloc.h"
+#include "threads/cpu.h"
+#include "threads/thread.h"
 #include "threads/interrupt.h"
+#include "threads/smp.h"
+#include "threads/softirq.h"
 #include "devices/timer.h"
 
+/* Sleeping threads are kept in a hierarchical timing wheel.
+
+   Level L has WHEEL_SLOTS slots, each covering WHEEL_SLOTS^L
+   ticks.  A sleeper whose deadline is less than WHEEL_SLOTS^(L+1)
+   ticks away goes in level L, in the slot selected by the
+   corresponding bits of its deadline.  Every tick the level 0
+   slot for that tick is expired, and whenever the low bits of the
+   tick roll over to zero the due slot of the level above is
+   cascaded, that is, its sleepers are inserted again, now into a
+   lower level.  Insertion is O(1) and each sleeper is moved at
+   most WHEEL_LEVELS times, so expiry is amortized O(1).
+
+   The wheel is protected by sched_lock, which is only held with
+   interrupts off and for short times, so the timer interrupt
+   never has to skip a tick because someone else holds it. */
+
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+
 struct sleep_node
 {
   struct list_elem list_elem;
   int64_t target_tick;
-  struct condition waiter;
+  struct thread *thread;
 };
 
-
-static struct sleep_queue {
-  struct list sorted_threads;
-  struct lock monitor_lock;
+static struct timing_wheel {
+  struct list slots[WHEEL_LEVELS][WHEEL_SLOTS];
+  int64_t now;                  /* Last tick that was expired. */
 } sleeping_threads;
 
 void
 sleep_init (void) {
-  list_init (&sleeping_threads.sorted_threads);
-  lock_init (&sleeping_threads.monitor_lock);
+  for (int level = 0; level < WHEEL_LEVELS; level++)
+    for (int slot = 0; slot < WHEEL_SLOTS; slot++)
+      list_init (&sleeping_threads.slots[level][slot]);
+
+  sleeping_threads.now = timer_ticks ();
+  softirq_register (SOFTIRQ_TIMER, thread_sleep_tick, "timer");
+}
+
+/* Returns the slot of LEVEL that TICK falls in. */
+static inline int
+wheel_slot (int64_t tick, int level)
+{
+  return (tick >> (level * WHEEL_BITS)) & WHEEL_MASK;
+}
+
+static void
+wheel_insert (struct sleep_node *node)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  const int64_t now = sleeping_threads.now;
+  const int64_t delta = node->target_tick > now ? node->target_tick - now : 0;
+  struct list *slot = NULL;
+
+  for (int level = 0; level < WHEEL_LEVELS; level++)
+    if (delta < (int64_t) 1 << ((level + 1) * WHEEL_BITS))
+      {
+        const int64_t tick = delta == 0 ? now : node->target_tick;
+        slot = &sleeping_threads.slots[level][wheel_slot (tick, level)];
+        break;
+      }
+
+  /* Too far away even for the top level: park it in the top level
+     slot that is cascaded last, it will be inserted again then. */
+  if (slot == NULL)
+    slot = &sleeping_threads.slots[WHEEL_LEVELS - 1][wheel_slot (now, WHEEL_LEVELS - 1)];
+
+  list_push_back (slot, &node->list_elem);
+}
+
+/* Re-inserts every sleeper of slot SLOT of LEVEL. */
+static void
+wheel_cascade (int level, int slot)
+{
+  struct list *list = &sleeping_threads.slots[level][slot];
+  struct list pending;
+
+  list_init (&pending);
+  while (!list_empty (list))
+    list_push_back (&pending, list_pop_front (list));
+
+  while (!list_empty (&pending))
+    wheel_insert (list_entry (list_pop_front (&pending), struct sleep_node, list_elem));
+}
+
+/* Advances the wheel by one tick, waking up the sleepers whose
+   deadline it is.  Returns the number of threads woken up. */
+static int
+wheel_advance (void)
+{
+  const int64_t now = ++sleeping_threads.now;
+  int woken = 0;
+
+  /* Cascade from the highest level that rolled over downwards, so
+     that sleepers can move down several levels in one tick. */
+  int top = 0;
+  while (top + 1 < WHEEL_LEVELS && wheel_slot (now, top) == 0)
+    top++;
+  for (int level = top; level > 0; level--)
+    wheel_cascade (level, wheel_slot (now, level));
+
+  struct list *expired = &sleeping_threads.slots[0][wheel_slot (now, 0)];
+  while (!list_empty (expired))
+    {
+      struct sleep_node *node = list_entry (list_pop_front (expired), struct sleep_node, list_elem);
+      ASSERT (node->target_tick <= now);
+
+      thread_unblock (node->thread);
+      woken++;
+    }
+
+  return woken;
 }
 
+/* Returns true if advancing the wheel to TICK has anything to do:
+   sleepers to wake up or a non-empty upper level slot to cascade. */
 static bool
-sleep_node_list_less_func (const struct list_elem *left_e, const struct list_elem *right_e, void *_aux UNUSED) 
+wheel_has_work (int64_t tick)
+{
+  if (!list_empty (&sleeping_threads.slots[0][wheel_slot (tick, 0)]))
+    return true;
+
+  for (int level = 1; level < WHEEL_LEVELS && wheel_slot (tick, level - 1) == 0; level++)
+    if (!list_empty (&sleeping_threads.slots[level][wheel_slot (tick, level)]))
+      return true;
+
+  return false;
+}
+
+/* Returns the first tick after the last one the wheel expired at
+   which the wheel has work to do, or LIMIT if there is none
+   before it.  Used to decide how long the timer interrupt may be
+   held off while idle, so it only scans up to LIMIT. */
+int64_t
+sleep_next_event (int64_t limit)
 {
-  struct sleep_node* left = list_entry(left_e, struct sleep_node, list_elem);
-  struct sleep_node* right = list_entry(right_e, struct sleep_node, list_elem);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  int64_t tick;
+  spinlock_acquire (&sched_lock);
+  for (tick = sleeping_threads.now + 1; tick < limit; tick++)
+    if (wheel_has_work (tick))
+      break;
+  spinlock_release (&sched_lock);
 
-  return left->target_tick < right->target_tick;
+  return tick;
 }
 
-void 
-sleep_curr_thread (int64_t target_tick) 
+void
+sleep_curr_thread (int64_t target_tick)
 {
   ASSERT (!intr_context ());
-  
+
   struct sleep_node node;
   node.target_tick = target_tick;
-  cond_init(&node.waiter); 
+  node.thread = thread_current ();
+
+  enum intr_level old_level = sched_lock_acquire ();
 
-  lock_acquire (&sleeping_threads.monitor_lock);
-  list_insert_ordered (&sleeping_threads.sorted_threads, &node.list_elem, sleep_node_list_less_func, NULL);
+  if (target_tick > sleeping_threads.now) {
+    wheel_insert (&node);
 
-  cond_wait(&node.waiter, &sleeping_threads.monitor_lock); // sleep
+    /* The BSP, which runs the wheel, may be idle with the timer
+       interrupt held off past TARGET_TICK: make it look again. */
+    if (timer_tickless && cpu_current ()->id != 0)
+      smp_send_resched (&cpus[0]);
 
-  lock_release (&sleeping_threads.monitor_lock);
-  ASSERT (cond_no_waiters(&node.waiter));
+    thread_block (); // sleep
+  }
+
+  sched_lock_release (old_level);
 }
 
-void 
+/* Wakes up the sleepers whose deadline has come.  Runs as the
+   timer softirq, which the timer interrupt raises every tick, so
+   it may have several ticks to catch up on. */
+void
 thread_sleep_tick ()
 {
   ASSERT (intr_context ());
 
   const int64_t curr_ticks = timer_ticks ();
-  if (lock_held_by_current_thread(&sleeping_threads.monitor_lock) || ! lock_try_acquire (&sleeping_threads.monitor_lock))
-    return;
-
-  for (struct list_elem *e = list_begin (&sleeping_threads.sorted_threads); e != list_end (&sleeping_threads.sorted_threads); )
-  {
-    struct sleep_node *node = list_entry (e, struct sleep_node, list_elem); 
-    if (node->target_tick <= curr_ticks) {
-      ASSERT (! cond_no_waiters (&node->waiter));
-      
-      e = list_remove (e);
-      cond_signal_with_yielding (&node->waiter, &sleeping_threads.monitor_lock, false);
-    } else {
-      break;
-    }
-  } 
+  int woken = 0;
+  enum intr_level old_level = sched_lock_acquire ();
+  while (sleeping_threads.now < curr_ticks)
+    woken += wheel_advance ();
+  sched_lock_release (old_level);
 
-  lock_release_with_locking (&sleeping_threads.monitor_lock, false);
-}
\ No newline at end of file
+  /* Don't leave freshly woken threads waiting for the idle
+     thread's time slice to run out. */
+  if (woken > 0 && is_idle_thread (thread_current ()))
+    intr_yield_on_return ();
+}
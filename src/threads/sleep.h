@@ -10,5 +10,8 @@ sleep_curr_thread (int64_t target_tick);
 void 
 thread_sleep_tick (void);
 
+int64_t
+sleep_next_event (int64_t limit);
+
 
 #endif
\ No newline at end of file
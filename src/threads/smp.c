@@ -0,0 +1,535 @@
+#include "threads/smp.h"
+#include <debug.h>
+#include <packed.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/ioapic.h"
+#include "devices/lapic.h"
+#include "devices/timer.h"
+#include "threads/cpu.h"
+#include "threads/fpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/spinlock.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#endif
+
+/* Multiprocessor support.
+
+   The BIOS leaves every CPU but one, the bootstrap processor
+   (BSP), halted.  smp_init() finds the others, the application
+   processors (APs), in the MP configuration table the BIOS
+   builds (see [MP] chapter 4), starts each of them with the
+   code in ap-start.S, and sets up the interrupt hardware so that
+   they can interrupt each other: a local APIC per CPU, and an
+   I/O APIC that now delivers the device interrupts in place of
+   the PICs.  All device interrupts, including the 8254 timer,
+   still go to the BSP; the APs get a local APIC timer of their
+   own, used for preemption only.
+
+   On a machine with a single CPU nothing changes: the PICs stay
+   in use and cpu_cnt stays 1. */
+
+struct cpu cpus[CPU_MAX];
+int cpu_cnt = 1;
+
+/* MP floating pointer structure.  See [MP] 4.1. */
+struct mp_float
+  {
+    char signature[4];          /* "_MP_". */
+    uint32_t config_phys;       /* Physical address of the table. */
+    uint8_t length;             /* In 16-byte units. */
+    uint8_t spec_rev;
+    uint8_t checksum;
+    uint8_t type;               /* 0 if there is a table. */
+    uint8_t imcr;               /* Bit 7: IMCR present. */
+    uint8_t reserved[3];
+  } PACKED;
+
+/* MP configuration table header.  See [MP] 4.2. */
+struct mp_config
+  {
+    char signature[4];          /* "PCMP". */
+    uint16_t length;            /* Base table length, header included. */
+    uint8_t spec_rev;
+    uint8_t checksum;
+    char oem_id[8];
+    char product_id[12];
+    uint32_t oem_table_phys;
+    uint16_t oem_table_size;
+    uint16_t entry_cnt;
+    uint32_t lapic_phys;        /* Address of the local APICs. */
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+  } PACKED;
+
+/* MP configuration table entries.  See [MP] 4.3. */
+enum mp_entry_type
+  {
+    MP_PROCESSOR = 0,           /* struct mp_processor, 20 bytes. */
+    MP_BUS = 1,                 /* struct mp_bus, 8 bytes. */
+    MP_IOAPIC = 2,              /* struct mp_ioapic, 8 bytes. */
+    MP_IOINTR = 3,              /* struct mp_intr, 8 bytes. */
+    MP_LINTR = 4                /* struct mp_intr, 8 bytes. */
+  };
+
+struct mp_processor
+  {
+    uint8_t type;
+    uint8_t lapic_id;
+    uint8_t lapic_version;
+    uint8_t flags;              /* MP_CPU_* flags. */
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+  } PACKED;
+
+#define MP_CPU_ENABLED 0x1      /* Usable. */
+#define MP_CPU_BSP 0x2          /* The bootstrap processor. */
+
+struct mp_bus
+  {
+    uint8_t type;
+    uint8_t bus_id;
+    char bus_type[6];           /* "ISA   ", "PCI   ", ... */
+  } PACKED;
+
+struct mp_ioapic
+  {
+    uint8_t type;
+    uint8_t ioapic_id;
+    uint8_t version;
+    uint8_t flags;
+    uint32_t ioapic_phys;       /* Address of the I/O APIC. */
+  } PACKED;
+
+struct mp_intr
+  {
+    uint8_t type;
+    uint8_t intr_type;          /* 0: vectored interrupt. */
+    uint16_t flags;             /* Polarity in bits 0-1, trigger mode in 2-3. */
+    uint8_t src_bus;
+    uint8_t src_irq;
+    uint8_t dst_ioapic;
+    uint8_t dst_pin;
+  } PACKED;
+
+/* What smp_init() learned from the MP table. */
+static uint8_t ap_lapic_ids[CPU_MAX];   /* Local APIC IDs of the APs. */
+static int ap_cnt;                      /* # of APs. */
+static uintptr_t lapic_phys;
+static uintptr_t ioapic_phys;
+static bool has_imcr;
+
+/* I/O APIC pin and redirection flags of each ISA IRQ. */
+#define ISA_IRQ_CNT 16
+static int irq_pin[ISA_IRQ_CNT];
+static uint32_t irq_flags[ISA_IRQ_CNT];
+
+#ifdef USERPROG
+/* Serializes TLB shootdowns. */
+static struct spinlock shootdown_lock;
+
+/* # of CPUs that have yet to flush their TLB. */
+static volatile int shootdown_pending;
+#endif
+
+/* Application processor startup code, in ap-start.S. */
+extern const uint8_t ap_start[], ap_stack[], ap_start_end[];
+void ap_main (void) NO_RETURN;
+
+static bool parse_mp_table (void);
+static void map_mmio (uintptr_t phys);
+static void route_isa_irqs (void);
+static bool start_ap (int id, uint8_t apic_id);
+static intr_handler_func ap_timer_interrupt;
+static intr_handler_func resched_interrupt;
+#ifdef USERPROG
+static intr_handler_func tlb_interrupt;
+#endif
+
+/* Returns the running CPU. */
+struct cpu *
+cpu_current (void)
+{
+  /* Until there is more than one CPU, struct thread's `cpu' may
+     not be set up yet. */
+  return &cpus[cpu_cnt > 1 ? running_thread ()->cpu : 0];
+}
+
+/* Starts the APs listed in the MP table, if there are any.
+   Must be called by the BSP with interrupts on, after the timer
+   is calibrated and before any user process exists. */
+void
+smp_init (void)
+{
+  int i;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  if (!parse_mp_table () || ap_cnt == 0)
+    return;
+
+  map_mmio (lapic_phys);
+  map_mmio (ioapic_phys);
+
+  /* Bring up the BSP's local APIC and move the device interrupts
+     from the PICs to the I/O APIC.  If the IMCR is there, the
+     PICs are wired straight to the BSP: route them through the
+     APICs instead, see [MP] 3.6.2.1. */
+  lapic_init ((volatile void *) lapic_phys);
+  cpus[0].lapic_id = lapic_id ();
+  lapic_init_cpu ();
+  if (has_imcr)
+    {
+      outb (0x22, 0x70);
+      outb (0x23, inb (0x23) | 1);
+    }
+  ioapic_init ((volatile void *) ioapic_phys);
+  route_isa_irqs ();
+  intr_use_apic ();
+
+  intr_register_ext (LAPIC_TIMER_VEC, ap_timer_interrupt, "AP timer");
+  intr_register_ext (LAPIC_RESCHED_VEC, resched_interrupt, "Reschedule IPI");
+#ifdef USERPROG
+  spinlock_init (&shootdown_lock, "shootdown");
+  intr_register_ext (LAPIC_TLB_VEC, tlb_interrupt, "TLB shootdown IPI");
+#endif
+  lapic_timer_calibrate ();
+
+  for (i = 0; i < ap_cnt; i++)
+    if (!start_ap (i + 1, ap_lapic_ids[i]))
+      {
+        printf ("smp: CPU with APIC ID %d did not start.\n",
+                ap_lapic_ids[i]);
+        break;
+      }
+
+  printf ("smp: %d CPUs running.\n", cpu_cnt);
+}
+
+/* Interrupts CPU, which must be another CPU, so that it picks
+   the next thread to run again. */
+void
+smp_send_resched (struct cpu *cpu)
+{
+  ASSERT (cpu != cpu_current ());
+
+  if (cpu->started)
+    lapic_send_ipi (cpu->lapic_id, LAPIC_RESCHED_VEC);
+}
+
+/* Returns the sum of the SIZE bytes at P, mod 256. */
+static uint8_t
+checksum (const void *p, size_t size)
+{
+  const uint8_t *q = p;
+  uint8_t sum = 0;
+
+  while (size-- > 0)
+    sum += *q++;
+  return sum;
+}
+
+/* Looks for the MP floating pointer structure in the SIZE bytes
+   of physical memory at PHYS.  Returns it or a null pointer. */
+static struct mp_float *
+search_mp_float (uintptr_t phys, size_t size)
+{
+  uint8_t *p;
+
+  for (p = ptov (phys); p < (uint8_t *) ptov (phys) + size; p += 16)
+    if (!memcmp (p, "_MP_", 4) && checksum (p, sizeof (struct mp_float)) == 0)
+      return (struct mp_float *) p;
+  return NULL;
+}
+
+/* Finds the MP floating pointer structure in one of the places
+   [MP] 4 says it may be: the first kB of the extended BIOS data
+   area, the last kB of base memory, or the BIOS ROM. */
+static struct mp_float *
+find_mp_float (void)
+{
+  uintptr_t ebda = *(uint16_t *) ptov (0x40e) << 4;
+  struct mp_float *mp = NULL;
+
+  if (ebda != 0)
+    mp = search_mp_float (ebda, 1024);
+  if (mp == NULL)
+    mp = search_mp_float (0x9fc00, 1024);
+  if (mp == NULL)
+    mp = search_mp_float (0xf0000, 0x10000);
+  return mp;
+}
+
+/* Reads the MP configuration table into the variables above.
+   Returns false if there is no usable table. */
+static bool
+parse_mp_table (void)
+{
+  struct mp_float *mp = find_mp_float ();
+  struct mp_config *conf;
+  uint8_t *entry;
+  int isa_bus = -1;
+  int i;
+
+  if (mp == NULL || mp->type != 0 || mp->config_phys == 0
+      || mp->config_phys >= init_ram_pages * PGSIZE)
+    return false;
+  conf = ptov (mp->config_phys);
+  if (memcmp (conf->signature, "PCMP", 4)
+      || checksum (conf, conf->length) != 0)
+    return false;
+
+  lapic_phys = conf->lapic_phys;
+  has_imcr = (mp->imcr & 0x80) != 0;
+  for (i = 0; i < ISA_IRQ_CNT; i++)
+    {
+      irq_pin[i] = i;
+      irq_flags[i] = 0;
+    }
+
+  entry = (uint8_t *) (conf + 1);
+  for (i = 0; i < conf->entry_cnt; i++)
+    switch (*entry)
+      {
+      case MP_PROCESSOR:
+        {
+          struct mp_processor *p = (struct mp_processor *) entry;
+          if ((p->flags & MP_CPU_ENABLED) && !(p->flags & MP_CPU_BSP)
+              && ap_cnt < CPU_MAX - 1)
+            ap_lapic_ids[ap_cnt++] = p->lapic_id;
+          entry += sizeof *p;
+        }
+        break;
+
+      case MP_BUS:
+        {
+          struct mp_bus *b = (struct mp_bus *) entry;
+          if (!memcmp (b->bus_type, "ISA", 3))
+            isa_bus = b->bus_id;
+          entry += sizeof *b;
+        }
+        break;
+
+      case MP_IOAPIC:
+        {
+          struct mp_ioapic *io = (struct mp_ioapic *) entry;
+          if (ioapic_phys == 0)
+            ioapic_phys = io->ioapic_phys;
+          entry += sizeof *io;
+        }
+        break;
+
+      case MP_IOINTR:
+        {
+          /* An ISA IRQ that is not wired to the pin of the same
+             number, or not edge-triggered active high. */
+          struct mp_intr *in = (struct mp_intr *) entry;
+          if (in->intr_type == 0 && in->src_bus == isa_bus
+              && in->src_irq < ISA_IRQ_CNT)
+            {
+              irq_pin[in->src_irq] = in->dst_pin;
+              irq_flags[in->src_irq] =
+                ((in->flags & 0x3) == 0x3 ? IOAPIC_ACTIVE_LOW : 0)
+                | ((in->flags & 0xc) == 0xc ? IOAPIC_LEVEL : 0);
+            }
+          entry += sizeof *in;
+        }
+        break;
+
+      case MP_LINTR:
+        entry += sizeof (struct mp_intr);
+        break;
+
+      default:
+        /* Unknown entry: we can't tell its size. */
+        return false;
+      }
+
+  return lapic_phys != 0 && ioapic_phys != 0;
+}
+
+/* Maps the page of memory-mapped I/O registers at PHYS into
+   init_page_dir, at the same virtual address, with caching off.
+   Processes inherit the mapping because pagedir_create() copies
+   init_page_dir, so this must be done before the first one is
+   created. */
+static void
+map_mmio (uintptr_t phys)
+{
+  uint32_t *pde = init_page_dir + pd_no ((void *) phys);
+  uint32_t *pt;
+
+  ASSERT (phys >= (uintptr_t) PHYS_BASE);
+
+  if (*pde == 0)
+    *pde = pde_create (palloc_get_page (PAL_ASSERT | PAL_ZERO));
+  pt = pde_get_pt (*pde);
+  pt[pt_no ((void *) phys)] = (phys & PTE_ADDR) | PTE_P | PTE_W
+                              | PTE_PCD | PTE_PWT;
+}
+
+/* Routes each ISA IRQ to the BSP with the vector the PICs used
+   for it.  IRQ 2 is the PICs' cascade, which does not exist on
+   the I/O APIC. */
+static void
+route_isa_irqs (void)
+{
+  int irq;
+
+  for (irq = 0; irq < ISA_IRQ_CNT; irq++)
+    if (irq != 2)
+      ioapic_route (irq_pin[irq], 0x20 + irq, irq_flags[irq],
+                    cpus[0].lapic_id);
+}
+
+/* Starts the AP with local APIC ID APIC_ID as CPU ID and waits up
+   to a second for it to start running threads.  Returns true if
+   successful. */
+static bool
+start_ap (int id, uint8_t apic_id)
+{
+  struct cpu *cpu = &cpus[id];
+  uint8_t *code = ptov (AP_START_PHYS);
+  enum intr_level old_level;
+  int64_t start;
+  void *stack;
+
+  cpu->id = id;
+  cpu->lapic_id = apic_id;
+  stack = thread_create_ap_idle (id);
+  if (stack == NULL)
+    return false;
+
+  memcpy (code, ap_start, ap_start_end - ap_start);
+  *(void **) (code + (ap_stack - ap_start)) = stack;
+
+  /* Count the new CPU in already: it relies on cpu_current() as
+     soon as it runs C code.  It has no thread in its run queue
+     and isn't idle yet, so no one will try to give it any before
+     it is ready. */
+  old_level = sched_lock_acquire ();
+  cpu_cnt = id + 1;
+  sched_lock_release (old_level);
+
+  lapic_start_ap (apic_id, AP_START_PHYS);
+  start = timer_ticks ();
+  while (!cpu->started && timer_elapsed (start) < TIMER_FREQ)
+    barrier ();
+
+  if (!cpu->started)
+    {
+      old_level = sched_lock_acquire ();
+      cpu_cnt = id;
+      sched_lock_release (old_level);
+      return false;
+    }
+  return true;
+}
+
+/* C entry point of an AP, called by ap-start.S on the stack of
+   its idle thread, with interrupts off. */
+void
+ap_main (void)
+{
+  /* Switch to the kernel's own page directory, and load the
+     descriptor tables. */
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)) : "memory");
+#ifdef USERPROG
+  cpu_current ()->pagedir = init_page_dir;
+  gdt_init_ap ();
+#endif
+  intr_init_ap ();
+  fpu_init_cpu ();
+
+  lapic_init_cpu ();
+  lapic_timer_start ();
+  thread_run_ap ();
+}
+
+/* Local APIC timer interrupt handler, on the APs. */
+static void
+ap_timer_interrupt (struct intr_frame *args UNUSED)
+{
+  thread_tick ();
+}
+
+/* Reschedule IPI handler: another CPU made a thread ready for
+   this CPU to run. */
+static void
+resched_interrupt (struct intr_frame *args UNUSED)
+{
+  intr_yield_on_return ();
+}
+
+#ifdef USERPROG
+/* If the current CPU was asked to flush its TLB, does so and
+   tells the CPU that asked. */
+static void
+tlb_flush_if_pending (void)
+{
+  struct cpu *cpu = cpu_current ();
+
+  if (cpu->tlb_flush_pending)
+    {
+      cpu->tlb_flush_pending = false;
+      asm volatile ("movl %0, %%cr3" : : "r" (vtop (cpu->pagedir)) : "memory");
+      asm volatile ("lock decl %0" : "+m" (shootdown_pending));
+    }
+}
+
+/* TLB shootdown IPI handler. */
+static void
+tlb_interrupt (struct intr_frame *args UNUSED)
+{
+  tlb_flush_if_pending ();
+}
+
+/* Makes every other CPU that has page directory PD active flush
+   its TLB, and waits until they have.  The current CPU's TLB is
+   the caller's business. */
+void
+smp_tlb_shootdown (uint32_t *pd)
+{
+  struct cpu *self;
+  enum intr_level old_level;
+  int i;
+
+  if (cpu_cnt == 1)
+    return;
+
+  old_level = intr_disable ();
+  self = cpu_current ();
+
+  /* Two CPUs could be shooting at each other: keep answering
+     while waiting for our turn. */
+  while (!spinlock_try_acquire (&shootdown_lock))
+    tlb_flush_if_pending ();
+
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      struct cpu *cpu = &cpus[i];
+      if (cpu != self && cpu->started && cpu->pagedir == pd)
+        {
+          asm volatile ("lock incl %0" : "+m" (shootdown_pending));
+          cpu->tlb_flush_pending = true;
+          lapic_send_ipi (cpu->lapic_id, LAPIC_TLB_VEC);
+        }
+    }
+  while (shootdown_pending > 0)
+    asm volatile ("pause");
+
+  spinlock_release (&shootdown_lock);
+  intr_set_level (old_level);
+}
+#endif
@@ -0,0 +1,14 @@
+#ifndef THREADS_SMP_H
+#define THREADS_SMP_H
+
+#include <stdint.h>
+
+struct cpu;
+
+void smp_init (void);
+void smp_send_resched (struct cpu *);
+#ifdef USERPROG
+void smp_tlb_shootdown (uint32_t *pd);
+#endif
+
+#endif /* threads/smp.h */
@@ -0,0 +1,130 @@
+#include "threads/softirq.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+
+/* If true, run softirqs with interrupts off, at the end of the
+   hard interrupt.  Controlled by kernel command-line option
+   "-softirq-inline". */
+bool softirq_inline;
+
+/* Rounds of softirqs softirq_run() goes through before it leaves
+   whatever is still pending for the next interrupt, so that
+   softirqs raised over and over can't starve the interrupted
+   thread. */
+#define MAX_ROUNDS 8
+
+struct softirq
+  {
+    softirq_func *func;
+    const char *name;
+  };
+static struct softirq softirqs[SOFTIRQ_CNT];
+
+/* Statistics, per CPU so that CPUs don't share counters. */
+static long long run_cnt[CPU_MAX][SOFTIRQ_CNT];
+static uint64_t run_cycles[CPU_MAX][SOFTIRQ_CNT];
+static long long left_pending_cnt[CPU_MAX];
+
+/* Sets FUNC, named NAME for statistics, as the function that
+   runs softirq NR. */
+void
+softirq_register (enum softirq_nr nr, softirq_func *func, const char *name)
+{
+  ASSERT (nr < SOFTIRQ_CNT);
+  ASSERT (softirqs[nr].func == NULL);
+
+  softirqs[nr].func = func;
+  softirqs[nr].name = name;
+}
+
+/* Marks softirq NR pending on the current CPU, which runs it on
+   its way out of the current interrupt.  Raising a softirq that
+   is already pending has no effect, so the softirq function must
+   find out itself how much there is to do.  Interrupts must be
+   off. */
+void
+softirq_raise (enum softirq_nr nr)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (nr < SOFTIRQ_CNT);
+
+  cpu_current ()->softirq_pending |= 1u << nr;
+}
+
+/* Runs the current CPU's pending softirqs.  Called by
+   intr_handler() with interrupts off, which are turned on while
+   the softirqs run unless softirq_inline is set.  Does nothing if
+   the CPU is already running softirqs further up its stack. */
+void
+softirq_run (void)
+{
+  struct cpu *cpu = cpu_current ();
+  int round;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (cpu->in_softirq || cpu->softirq_pending == 0)
+    return;
+
+  cpu->in_softirq = true;
+  for (round = 0; round < MAX_ROUNDS && cpu->softirq_pending != 0; round++)
+    {
+      unsigned pending = cpu->softirq_pending;
+      int nr;
+
+      cpu->softirq_pending = 0;
+      if (!softirq_inline)
+        intr_enable ();
+
+      /* A softirq raised before its owner registered it is
+         dropped. */
+      for (nr = 0; nr < SOFTIRQ_CNT; nr++)
+        if ((pending & (1u << nr)) && softirqs[nr].func != NULL)
+          {
+            uint64_t start = rdtsc ();
+            softirqs[nr].func ();
+            run_cycles[cpu->id][nr] += rdtsc () - start;
+            run_cnt[cpu->id][nr]++;
+          }
+
+      intr_disable ();
+    }
+  if (cpu->softirq_pending != 0)
+    left_pending_cnt[cpu->id]++;
+  cpu->in_softirq = false;
+}
+
+/* Prints softirq statistics. */
+void
+softirq_print_stats (void)
+{
+  long long left_pending = 0;
+  int nr, i;
+
+  for (nr = 0; nr < SOFTIRQ_CNT; nr++)
+    {
+      long long cnt = 0;
+      uint64_t cycles = 0;
+
+      if (softirqs[nr].func == NULL)
+        continue;
+      for (i = 0; i < cpu_cnt; i++)
+        {
+          cnt += run_cnt[i][nr];
+          cycles += run_cycles[i][nr];
+        }
+      if (cnt > 0)
+        printf ("Softirq %s: %lld runs, %llu cycles avg%s\n",
+                softirqs[nr].name, cnt,
+                (unsigned long long) (cycles / cnt),
+                softirq_inline ? " (inline)" : "");
+    }
+
+  for (i = 0; i < cpu_cnt; i++)
+    left_pending += left_pending_cnt[i];
+  if (left_pending > 0)
+    printf ("Softirq: left pending %lld times\n", left_pending);
+}
@@ -0,0 +1,46 @@
+#ifndef THREADS_SOFTIRQ_H
+#define THREADS_SOFTIRQ_H
+
+#include <stdbool.h>
+
+/* Deferred interrupt work ("bottom halves").
+
+   An external interrupt handler runs with interrupts off, so
+   everything it does delays every other interrupt on its CPU.  A
+   handler that has more to do than talk to its device can raise
+   a softirq instead: once the handler has returned and the
+   interrupt has been acknowledged, intr_handler() runs the
+   pending softirqs of the CPU with interrupts back on.
+
+   Softirq functions run in interrupt context (intr_context()
+   returns true), so they may not sleep, but they may call
+   intr_yield_on_return().  They never nest on a CPU: a hard
+   interrupt that arrives meanwhile only raises softirqs, which
+   the running loop picks up before it returns.
+
+   With the "-softirq-inline" kernel option, pending softirqs
+   instead run at the end of the hard interrupt, with interrupts
+   still off, the way this work used to be done.  Comparing the
+   interrupt statistics printed at shutdown with and without the
+   option shows what deferring buys. */
+
+/* Softirqs, run in this order. */
+enum softirq_nr
+  {
+    SOFTIRQ_TIMER,              /* Wakes up sleepers (threads/sleep.c). */
+    SOFTIRQ_SCHED,              /* Scheduling class system ticks (threads/thread.c). */
+    SOFTIRQ_BLOCK,              /* Block device completions (devices/ide.c). */
+    SOFTIRQ_WORK,               /* Delayed work that is due (threads/workqueue.c). */
+    SOFTIRQ_CNT
+  };
+
+typedef void softirq_func (void);
+
+extern bool softirq_inline;
+
+void softirq_register (enum softirq_nr, softirq_func *, const char *name);
+void softirq_raise (enum softirq_nr);
+void softirq_run (void);
+void softirq_print_stats (void);
+
+#endif /* threads/softirq.h */
@@ -0,0 +1,104 @@
+#include "threads/spinlock.h"
+#include <debug.h>
+#include <stddef.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+
+/* Atomically sets *ADDR to VALUE and returns its old value.
+   See [IA32-v2b] "XCHG": the instruction asserts the bus lock by
+   itself when one operand is in memory. */
+static inline uint32_t
+xchg (volatile uint32_t *addr, uint32_t value)
+{
+  asm volatile ("xchgl %0, %1"
+                : "+m" (*addr), "+r" (value)
+                :
+                : "memory");
+  return value;
+}
+
+/* Initializes spinlock LOCK, naming it NAME. */
+void
+spinlock_init (struct spinlock *lock, const char *name)
+{
+  ASSERT (lock != NULL);
+
+  lock->locked = 0;
+  lock->cpu = -1;
+  lock->depth = 0;
+  lock->name = name;
+}
+
+/* Acquires LOCK, spinning until it becomes available.
+   Interrupts must be off. */
+void
+spinlock_acquire (struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  const int cpu = cpu_current ()->id;
+  if (lock->cpu == cpu)
+    {
+      lock->depth++;
+      return;
+    }
+
+  /* Spin on a plain read, so that waiting CPUs don't keep
+     taking the bus lock, and only try to take LOCK once it looks
+     free. */
+  while (xchg (&lock->locked, 1) != 0)
+    while (lock->locked)
+      asm volatile ("pause");
+
+  lock->cpu = cpu;
+  lock->depth = 1;
+}
+
+/* Tries to acquire LOCK without spinning.  Returns true if
+   successful, false if another CPU holds it.  Interrupts must
+   be off. */
+bool
+spinlock_try_acquire (struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  const int cpu = cpu_current ()->id;
+  if (lock->cpu == cpu)
+    {
+      lock->depth++;
+      return true;
+    }
+
+  if (xchg (&lock->locked, 1) != 0)
+    return false;
+
+  lock->cpu = cpu;
+  lock->depth = 1;
+  return true;
+}
+
+/* Releases LOCK, which the current CPU must hold. */
+void
+spinlock_release (struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+  ASSERT (spinlock_held_by_current_cpu (lock));
+
+  if (--lock->depth > 0)
+    return;
+
+  lock->cpu = -1;
+  xchg (&lock->locked, 0);
+}
+
+/* Returns true if the current CPU holds LOCK.  Interrupts must
+   be off for the answer to stay true. */
+bool
+spinlock_held_by_current_cpu (const struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+
+  return lock->locked && lock->cpu == cpu_current ()->id;
+}
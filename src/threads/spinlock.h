@@ -0,0 +1,40 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A spinlock.
+
+   Unlike a struct lock, a spinlock never sleeps: a CPU that
+   finds it taken busy-waits until the holder, which must be
+   running on another CPU, releases it.  This makes spinlocks
+   usable from interrupt handlers and from the scheduler itself,
+   but a spinlock must only be held for a short time and never
+   across anything that may sleep.
+
+   Interrupts must be off while a spinlock is held, otherwise an
+   interrupt handler on the same CPU could try to take it again.
+   The holder is a CPU, not a thread, and the same CPU may
+   acquire a spinlock it already holds; it is released when
+   every acquisition has been matched by a release. */
+struct spinlock
+  {
+    volatile uint32_t locked;   /* 1 if held, 0 otherwise. */
+    int cpu;                    /* Holding CPU's id, -1 if none. */
+    unsigned depth;             /* # of nested acquisitions. */
+    const char *name;           /* Name, for debugging. */
+  };
+
+/* Initializer for a spinlock with static storage duration, for
+   locks that may be needed before the code that owns them gets a
+   chance to call spinlock_init(). */
+#define SPINLOCK_INITIALIZER(NAME) { 0, -1, 0, NAME }
+
+void spinlock_init (struct spinlock *, const char *name);
+void spinlock_acquire (struct spinlock *);
+bool spinlock_try_acquire (struct spinlock *);
+void spinlock_release (struct spinlock *);
+bool spinlock_held_by_current_cpu (const struct spinlock *);
+
+#endif /* threads/spinlock.h */
@@ -27,12 +27,22 @@
 */
 
 #include "threads/synch.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
+#include "threads/spinlock.h"
 #include "threads/thread.h"
 #include "threads/scheduler.h"
 
+#ifdef LOCK_PROFILE
+static void profile_register (struct lock_stats *);
+static void profile_acquired (struct lock_stats *, bool contended,
+                              uint64_t wait_start);
+static void profile_released (struct lock_stats *, uint64_t hold_start);
+#endif
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -42,13 +52,23 @@
 
    - up or "V": increment the value (and wake up one waiting
      thread, if any). */
+#ifdef LOCK_PROFILE
+void
+sema_init_profiled (struct semaphore *sema, unsigned value,
+                    struct lock_stats *stats)
+#else
 void
 sema_init (struct semaphore *sema, unsigned value) 
+#endif
 {
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  pheap_init (&sema->waiters, thread_waiter_less, NULL);
+#ifdef LOCK_PROFILE
+  sema->stats = stats;
+  profile_register (stats);
+#endif
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -66,14 +86,23 @@ sema_down (struct semaphore *sema)
   ASSERT (sema != NULL);
   ASSERT (!intr_context ());
 
-  old_level = intr_disable ();
+  old_level = sched_lock_acquire ();
+#ifdef LOCK_PROFILE
+  const bool contended = sema->value == 0;
+  const uint64_t wait_start = contended ? rdtsc () : 0;
+#endif
   while (sema->value == 0) 
     {
-      list_push_back (&sema->waiters, &thread_current ()->elem);
+      struct thread *cur = thread_current ();
+      cur->waiting_sema = sema;
+      pheap_insert (&sema->waiters, &cur->wait_elem);
       thread_block ();
     }
   sema->value--;
-  intr_set_level (old_level);
+#ifdef LOCK_PROFILE
+  profile_acquired (sema->stats, contended, wait_start);
+#endif
+  sched_lock_release (old_level);
 }
 
 /* Down or "P" operation on a semaphore, but only if the
@@ -89,15 +118,18 @@ sema_try_down (struct semaphore *sema)
 
   ASSERT (sema != NULL);
 
-  old_level = intr_disable ();
+  old_level = sched_lock_acquire ();
   if (sema->value > 0) 
     {
       sema->value--;
       success = true; 
+#ifdef LOCK_PROFILE
+      profile_acquired (sema->stats, false, 0);
+#endif
     }
   else
     success = false;
-  intr_set_level (old_level);
+  sched_lock_release (old_level);
 
   return success;
 }
@@ -108,14 +140,15 @@ static void sema_up_with_yield (struct semaphore *sema, bool can_yield)
 
   ASSERT (sema != NULL);
 
-  old_level = intr_disable ();
+  old_level = sched_lock_acquire ();
   struct thread * waiter = NULL;
-  if (!list_empty (&sema->waiters)) {
-    waiter = pop_highest_priority_thread(&sema->waiters);
+  if (!pheap_empty (&sema->waiters)) {
+    waiter = pheap_entry (pheap_pop (&sema->waiters), struct thread, wait_elem);
+    waiter->waiting_sema = NULL;
     thread_unblock (waiter);
   }
   sema->value++;
-  intr_set_level (old_level);
+  sched_lock_release (old_level);
 
   if (can_yield && waiter != NULL && should_curr_thread_yield_priority (waiter)) {
     thread_yield ();
@@ -156,7 +189,7 @@ sema_self_test (void)
 }
 
 bool sema_no_waiters (struct semaphore * sema) {
-  return list_empty(&sema->waiters);
+  return pheap_empty(&sema->waiters);
 }
 
 /* Thread function used by sema_self_test(). */
@@ -188,13 +221,22 @@ sema_test_helper (void *sema_)
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
    instead of a lock. */
+#ifdef LOCK_PROFILE
+void
+lock_init_profiled (struct lock *lock, struct lock_stats *stats)
+#else
 void
 lock_init (struct lock *lock)
+#endif
 {
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
+#ifdef LOCK_PROFILE
+  sema_init_profiled (&lock->semaphore, 1, stats);
+#else
   sema_init (&lock->semaphore, 1);
+#endif
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -213,13 +255,18 @@ lock_acquire (struct lock *lock)
   ASSERT (!lock_held_by_current_thread (lock));
 
   struct thread* curr = thread_current ();
-  if (!thread_mlfqs && lock->holder != NULL) {
-    rr_try_donate_priority (curr, lock->holder);
+  if (thread_base_sched_class () == &rr_sched_class && lock->holder != NULL) {
+    rr_donate_priority (curr, lock);
   }
 
   sema_down (&lock->semaphore);
 
-  lock->holder = thread_current ();
+  /* Whoever released LOCK took back our donation, if any. */
+  ASSERT (curr->rr_thread_block.donee == NULL);
+  lock->holder = curr;
+#ifdef LOCK_PROFILE
+  lock->acquired_at = rdtsc ();
+#endif
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -238,7 +285,12 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      lock->holder = thread_current ();
+#ifdef LOCK_PROFILE
+      lock->acquired_at = rdtsc ();
+#endif
+    }
   return success;
 }
 
@@ -248,10 +300,16 @@ lock_release_with_locking (struct lock *lock, bool can_lock)
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+#ifdef LOCK_PROFILE
+  profile_released (lock->semaphore.stats, lock->acquired_at);
+#endif
   lock->holder = NULL;
 
-  if (can_lock && !thread_mlfqs && !list_empty(&lock->semaphore.waiters))
-    rr_try_undonate_priority (&lock->semaphore.waiters, thread_current());
+  /* A donor adds itself to our donors before it gets onto the
+     semaphore's waiters, so even with no waiters there may be a
+     donation to take back. */
+  if (thread_base_sched_class () == &rr_sched_class)
+    rr_undonate_priority (lock);
 
   sema_up_with_yield (&lock->semaphore, can_lock);
 }
@@ -290,7 +348,7 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
+  pheap_init (&cond->waiters, cond_waiter_less, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -317,6 +375,7 @@ void
 cond_wait (struct condition *cond, struct lock *lock) 
 {
   struct semaphore_elem waiter;
+  enum intr_level old_level;
 
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
@@ -324,7 +383,12 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
-  list_push_back (&cond->waiters, &waiter.elem);
+  waiter.thread = thread_current ();
+  waiter.cond = cond;
+  old_level = sched_lock_acquire ();
+  pheap_insert (&cond->waiters, &waiter.elem);
+  waiter.thread->cond_waiter = &waiter;
+  sched_lock_release (old_level);
   // TODO make actually atomic
   lock_release (lock);
   sema_down (&waiter.semaphore);
@@ -337,10 +401,16 @@ void cond_signal_with_yielding (struct condition *cond, struct lock *lock UNUSED
   // ASSERT (intr_context ());
   ASSERT (lock_held_by_current_thread (lock)); 
 
-  if (!list_empty (&cond->waiters)) {
-    struct semaphore_elem * elem = pop_highest_priority_cond_var_waiter (&cond->waiters);
-    sema_up_with_yield (&elem->semaphore, can_yield); // preemption already handled by sema_up
+  struct semaphore_elem * waiter = NULL;
+  const enum intr_level old_level = sched_lock_acquire ();
+  if (!pheap_empty (&cond->waiters)) {
+    waiter = pheap_entry (pheap_pop (&cond->waiters), struct semaphore_elem, elem);
+    waiter->thread->cond_waiter = NULL;
   }
+  sched_lock_release (old_level);
+
+  if (waiter != NULL)
+    sema_up_with_yield (&waiter->semaphore, can_yield); // preemption already handled by sema_up
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
@@ -368,10 +438,365 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
 
-  while (!list_empty (&cond->waiters))
+  while (!pheap_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
 
 bool cond_no_waiters (struct condition * cond) {
-  return list_empty(&cond->waiters);
-}
\ No newline at end of file
+  return pheap_empty(&cond->waiters);
+}
+
+/* Moves T to its new place among the waiters of the semaphore or
+   condition variable it waits on, if any, after its priority
+   changed.  sched_lock must be held. */
+void
+synch_waiter_rekey (struct thread *t)
+{
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
+
+  if (t->waiting_sema != NULL)
+    pheap_update (&t->waiting_sema->waiters, &t->wait_elem);
+  if (t->cond_waiter != NULL)
+    pheap_update (&t->cond_waiter->cond->waiters, &t->cond_waiter->elem);
+}
+
+/* Initializes reader-writer lock RW, held by nobody. */
+#ifdef LOCK_PROFILE
+void
+rwlock_init_profiled (struct rwlock *rw, struct lock_stats *stats)
+#else
+void
+rwlock_init (struct rwlock *rw)
+#endif
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->lock);
+  rw->readers = 0;
+  rw->writer = NULL;
+  rw->waiting_writers = 0;
+  cond_init (&rw->can_read);
+  cond_init (&rw->can_write);
+  list_init (&rw->holders);
+#ifdef LOCK_PROFILE
+  rw->stats = stats;
+  profile_register (stats);
+#endif
+}
+
+/* Returns the current thread's hold on RW, or if RW is null, a
+   free one. */
+static struct rwlock_hold *
+find_hold (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  int i;
+
+  for (i = 0; i < RWLOCK_HOLD_MAX; i++)
+    if (cur->rw_holds[i].rwlock == rw)
+      return &cur->rw_holds[i];
+  return NULL;
+}
+
+/* Records that the current thread holds RW.  RW's lock must be
+   held. */
+static void
+add_hold (struct rwlock *rw)
+{
+  struct rwlock_hold *hold = find_hold (NULL);
+
+  ASSERT (hold != NULL);
+
+  hold->rwlock = rw;
+  hold->thread = thread_current ();
+  list_push_back (&rw->holders, &hold->elem);
+}
+
+/* Records that the current thread no longer holds RW.  RW's lock
+   must be held. */
+static void
+remove_hold (struct rwlock *rw)
+{
+  struct rwlock_hold *hold = find_hold (rw);
+
+  ASSERT (hold != NULL);
+
+  list_remove (&hold->elem);
+  hold->rwlock = NULL;
+}
+
+/* Waits for COND of RW, whose lock must be held, after donating
+   the current thread's priority to RW's holders. */
+static void
+rwlock_wait (struct rwlock *rw, struct condition *cond)
+{
+  if (thread_base_sched_class () == &rr_sched_class)
+    rr_donate_priority_rw (thread_current (), rw);
+  cond_wait (cond, &rw->lock);
+}
+
+/* The current thread just released a reader-writer lock: takes
+   back the donations of the threads waiting for it, and yields if
+   that lowered its priority. */
+static void
+rwlock_undonate (void)
+{
+  if (thread_base_sched_class () == &rr_sched_class)
+    {
+      const int old_pri = thread_get_priority ();
+      rr_undonate_priority_rw ();
+      if (thread_get_priority () < old_pri)
+        thread_yield ();
+    }
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   waits for it.  RW must not already be held by the current
+   thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_by_current_thread (rw));
+
+  lock_acquire (&rw->lock);
+#ifdef LOCK_PROFILE
+  const bool contended = rw->writer != NULL || rw->waiting_writers > 0;
+  const uint64_t wait_start = contended ? rdtsc () : 0;
+#endif
+  while (rw->writer != NULL || rw->waiting_writers > 0)
+    rwlock_wait (rw, &rw->can_read);
+  rw->readers++;
+  add_hold (rw);
+#ifdef LOCK_PROFILE
+  profile_acquired (rw->stats, contended, wait_start);
+#endif
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread must hold for reading. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  ASSERT (rw->readers > 0);
+  remove_hold (rw);
+  if (--rw->readers == 0 && rw->waiting_writers > 0)
+    cond_signal (&rw->can_write, &rw->lock);
+  lock_release (&rw->lock);
+
+  rwlock_undonate ();
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  RW must not already be held by the current thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_by_current_thread (rw));
+
+  lock_acquire (&rw->lock);
+#ifdef LOCK_PROFILE
+  const bool contended = rw->writer != NULL || rw->readers > 0;
+  const uint64_t wait_start = contended ? rdtsc () : 0;
+#endif
+  rw->waiting_writers++;
+  while (rw->writer != NULL || rw->readers > 0)
+    rwlock_wait (rw, &rw->can_write);
+  rw->waiting_writers--;
+  rw->writer = thread_current ();
+  add_hold (rw);
+#ifdef LOCK_PROFILE
+  profile_acquired (rw->stats, contended, wait_start);
+  rw->acquired_at = rdtsc ();
+#endif
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread must hold for writing.
+   Lets in the next writer if one waits, otherwise every waiting
+   reader. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  ASSERT (rw->writer == thread_current ());
+#ifdef LOCK_PROFILE
+  profile_released (rw->stats, rw->acquired_at);
+#endif
+  rw->writer = NULL;
+  remove_hold (rw);
+  if (rw->waiting_writers > 0)
+    cond_signal (&rw->can_write, &rw->lock);
+  else
+    cond_broadcast (&rw->can_read, &rw->lock);
+  lock_release (&rw->lock);
+
+  rwlock_undonate ();
+}
+
+/* Returns true if the current thread holds RW for reading or
+   writing, false otherwise. */
+bool
+rwlock_held_by_current_thread (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return find_hold (rw) != NULL;
+}
+
+/* Returns the highest priority of the threads waiting for the
+   reader-writer locks that T holds, or PRI_MIN if there are none.
+   T must be the running thread, and sched_lock must be held. */
+int
+rwlock_waiter_priority (struct thread *t)
+{
+  int pri = PRI_MIN;
+  int i;
+
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
+
+  for (i = 0; i < RWLOCK_HOLD_MAX; i++)
+    {
+      struct rwlock *rw = t->rw_holds[i].rwlock;
+      struct condition *conds[2];
+      int j;
+
+      if (rw == NULL)
+        continue;
+      conds[0] = &rw->can_read;
+      conds[1] = &rw->can_write;
+      for (j = 0; j < 2; j++)
+        if (!pheap_empty (&conds[j]->waiters))
+          {
+            const struct semaphore_elem *w
+              = pheap_entry (pheap_top (&conds[j]->waiters),
+                             struct semaphore_elem, elem);
+            const int waiter_pri = rr_thread_priority (w->thread);
+            if (waiter_pri > pri)
+              pri = waiter_pri;
+          }
+    }
+  return pri;
+}
+
+#ifdef LOCK_PROFILE
+/* Number of lines printed by lock_print_profile(). */
+#define PROFILE_TOP_CNT 10
+
+/* All the struct lock_stats registered so far.  Protected by
+   profile_lock, which can't be a struct lock for obvious
+   reasons, and which is needed before thread_init() sets up the
+   rest of the kernel. */
+static struct list all_stats = LIST_INITIALIZER (all_stats);
+static struct spinlock profile_lock = SPINLOCK_INITIALIZER ("profile");
+
+/* Adds STATS to all_stats, the first time it is used. */
+static void
+profile_register (struct lock_stats *stats)
+{
+  enum intr_level old_level = intr_disable ();
+  spinlock_acquire (&profile_lock);
+  if (!stats->registered)
+    {
+      stats->registered = true;
+      list_push_back (&all_stats, &stats->elem);
+    }
+  spinlock_release (&profile_lock);
+  intr_set_level (old_level);
+}
+
+/* Records a down or acquisition in STATS.  If CONTENDED, the
+   caller had to wait, starting at WAIT_START. */
+static void
+profile_acquired (struct lock_stats *stats, bool contended,
+                  uint64_t wait_start)
+{
+  enum intr_level old_level = intr_disable ();
+  spinlock_acquire (&profile_lock);
+  stats->acquire_cnt++;
+  if (contended)
+    {
+      uint64_t wait = rdtsc () - wait_start;
+      stats->contended_cnt++;
+      stats->wait_cycles += wait;
+      if (wait > stats->max_wait_cycles)
+        stats->max_wait_cycles = wait;
+    }
+  spinlock_release (&profile_lock);
+  intr_set_level (old_level);
+}
+
+/* Records in STATS the release of a lock acquired at
+   HOLD_START. */
+static void
+profile_released (struct lock_stats *stats, uint64_t hold_start)
+{
+  uint64_t hold = rdtsc () - hold_start;
+  enum intr_level old_level = intr_disable ();
+  spinlock_acquire (&profile_lock);
+  stats->hold_cycles += hold;
+  if (hold > stats->max_hold_cycles)
+    stats->max_hold_cycles = hold;
+  spinlock_release (&profile_lock);
+  intr_set_level (old_level);
+}
+
+/* Prints the PROFILE_TOP_CNT locks and semaphores with the
+   highest total wait time. */
+void
+lock_print_profile (void)
+{
+  struct lock_stats top[PROFILE_TOP_CNT];
+  struct list_elem *e;
+  enum intr_level old_level;
+  int cnt = 0;
+  int i;
+
+  /* Copy the top lines out, since printing needs a lock. */
+  old_level = intr_disable ();
+  spinlock_acquire (&profile_lock);
+  for (e = list_begin (&all_stats); e != list_end (&all_stats);
+       e = list_next (e))
+    {
+      struct lock_stats *s = list_entry (e, struct lock_stats, elem);
+      if (s->acquire_cnt == 0)
+        continue;
+
+      for (i = cnt < PROFILE_TOP_CNT ? cnt++ : PROFILE_TOP_CNT;
+           i > 0 && top[i - 1].wait_cycles < s->wait_cycles; i--)
+        if (i < PROFILE_TOP_CNT)
+          top[i] = top[i - 1];
+      if (i < PROFILE_TOP_CNT)
+        top[i] = *s;
+    }
+  spinlock_release (&profile_lock);
+  intr_set_level (old_level);
+
+  printf ("Lock profile, by total wait time (cycles):\n");
+  printf ("%-28s %10s %10s %14s %12s %14s %12s\n", "lock", "acquired",
+          "contended", "wait", "max wait", "hold", "max hold");
+  for (i = 0; i < cnt; i++)
+    {
+      printf ("%-28s %10"PRIu64" %10"PRIu64" %14"PRIu64" %12"PRIu64
+              " %14"PRIu64" %12"PRIu64"\n", top[i].name,
+              top[i].acquire_cnt, top[i].contended_cnt, top[i].wait_cycles,
+              top[i].max_wait_cycles, top[i].hold_cycles,
+              top[i].max_hold_cycles);
+      printf ("  at %s:%d\n", top[i].file, top[i].line);
+    }
+}
+#endif
@@ -2,16 +2,63 @@
 #define THREADS_SYNCH_H
 
 #include <list.h>
+#include <pairing-heap.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+#ifdef LOCK_PROFILE
+/* Lock contention profiling, enabled by building with
+   `make LOCK_PROFILE=1'.
+
+   Every semaphore and lock initialized by the same sema_init()
+   or lock_init() call in the source shares one struct
+   lock_stats, named after that call's argument, so that, say,
+   the locks of all processes show up as one line.  Times are in
+   CPU cycles.  lock_print_profile() prints the lines with the
+   highest total wait time. */
+struct lock_stats
+  {
+    const char *name;           /* Argument of sema_init() or lock_init(). */
+    const char *file;           /* Where it was called. */
+    int line;
+    bool registered;            /* In the list of all lock_stats yet? */
+    struct list_elem elem;      /* Element in that list. */
+
+    uint64_t acquire_cnt;       /* # of downs or acquisitions. */
+    uint64_t contended_cnt;     /* # of those that had to wait. */
+    uint64_t wait_cycles;       /* Total time spent waiting. */
+    uint64_t max_wait_cycles;   /* Longest wait. */
+    uint64_t hold_cycles;       /* Total time held (locks only). */
+    uint64_t max_hold_cycles;   /* Longest hold (locks only). */
+  };
+
+/* Returns a pointer to a struct lock_stats for the calling line
+   of code, named NAME. */
+#define LOCK_STATS_HERE(NAME)                                           \
+        ({ static struct lock_stats stats_ =                            \
+             { .name = NAME, .file = __FILE__, .line = __LINE__ };      \
+           &stats_; })
+#endif
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct pheap waiters;       /* Waiting threads, by priority.
+                                   Protected by sched_lock. */
+#ifdef LOCK_PROFILE
+    struct lock_stats *stats;   /* Contention statistics. */
+#endif
   };
 
+#ifdef LOCK_PROFILE
+#define sema_init(SEMA, VALUE) \
+        sema_init_profiled (SEMA, VALUE, LOCK_STATS_HERE (#SEMA))
+void sema_init_profiled (struct semaphore *, unsigned value,
+                         struct lock_stats *);
+#else
 void sema_init (struct semaphore *, unsigned value);
+#endif
 void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
@@ -24,16 +71,27 @@ struct lock
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+#ifdef LOCK_PROFILE
+    uint64_t acquired_at;       /* rdtsc() when acquired. */
+#endif
   };
 
-/* One semaphore in a list. */
+/* A thread waiting on a condition variable. */
 struct semaphore_elem 
   {
-    struct list_elem elem;              /* List element. */
-    struct semaphore semaphore;         /* This semaphore. */
+    struct pheap_elem elem;             /* Element in the waiters heap. */
+    struct semaphore semaphore;         /* Up'd to wake THREAD up. */
+    struct thread *thread;              /* Waiting thread. */
+    struct condition *cond;             /* Condition it waits on. */
   };
 
+#ifdef LOCK_PROFILE
+#define lock_init(LOCK) lock_init_profiled (LOCK, LOCK_STATS_HERE (#LOCK))
+void lock_init_profiled (struct lock *, struct lock_stats *);
+void lock_print_profile (void);
+#else
 void lock_init (struct lock *);
+#endif
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
@@ -58,7 +116,8 @@ static inline void lock_release_if_not_held(struct lock * lock, bool is_held) {
 /* Condition variable. */
 struct condition 
   {
-    struct list waiters;        /* List of waiting threads. */
+    struct pheap waiters;       /* Waiting threads, by priority.
+                                   Protected by sched_lock. */
   };
 
 void cond_init (struct condition *);
@@ -68,6 +127,57 @@ void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
 bool cond_no_waiters (struct condition * cond);
+
+void synch_waiter_rekey (struct thread *);
+
+/* Reader-writer lock.
+
+   Any number of readers or a single writer may hold it.  It is
+   writer-preferring: once a writer waits, new readers wait
+   behind it, so that a stream of readers cannot starve writers.
+   Waiting threads donate their priority to every thread that
+   holds the lock, readers included.  Like a struct lock, it is
+   not recursive, and a thread may hold at most RWLOCK_HOLD_MAX of
+   them at once. */
+struct rwlock
+  {
+    struct lock lock;           /* Protects the members below. */
+    int readers;                /* # of threads holding it for reading. */
+    struct thread *writer;      /* Thread holding it for writing, or null. */
+    int waiting_writers;        /* # of writers waiting for it. */
+    struct condition can_read;  /* Signaled when readers may enter. */
+    struct condition can_write; /* Signaled when a writer may enter. */
+    struct list holders;        /* Holds of the threads holding it. */
+#ifdef LOCK_PROFILE
+    struct lock_stats *stats;   /* Contention statistics. */
+    uint64_t acquired_at;       /* rdtsc() when the writer acquired it. */
+#endif
+  };
+
+/* A thread's hold on a reader-writer lock. */
+struct rwlock_hold
+  {
+    struct rwlock *rwlock;      /* Lock held, or null if unused. */
+    struct thread *thread;      /* Thread holding it. */
+    struct list_elem elem;      /* Element in the lock's `holders'. */
+  };
+
+/* Most reader-writer locks a thread may hold at once. */
+#define RWLOCK_HOLD_MAX 4
+
+#ifdef LOCK_PROFILE
+#define rwlock_init(RWLOCK) \
+        rwlock_init_profiled (RWLOCK, LOCK_STATS_HERE (#RWLOCK))
+void rwlock_init_profiled (struct rwlock *, struct lock_stats *);
+#else
+void rwlock_init (struct rwlock *);
+#endif
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_by_current_thread (struct rwlock *);
+int rwlock_waiter_priority (struct thread *);
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
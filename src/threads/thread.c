@@ -1,20 +1,24 @@
 #include "threads/thread.h"
 
 #include <debug.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
-#include <kernel/array.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/fpu.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
-#include "threads/scheduler.h"
-#include "threads/mlfq-scheduler.h"
+#include "threads/sched-class.h"
+#include "threads/sched-trace.h"
+#include "threads/softirq.h"
 #include "devices/timer.h"
 
 #ifdef USERPROG
@@ -33,8 +37,10 @@ static void insert_ready_thread (struct thread* t);
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
-/* Idle thread. */
-static struct thread *idle_thread;
+/* Protects the run queues, the state of every thread, the
+   all_list and, through synch.c, the semaphore wait lists.  See
+   sched_lock_acquire(). */
+struct spinlock sched_lock;
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
@@ -42,6 +48,21 @@ static struct thread *initial_thread;
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/* Pages of dead threads, kept for reuse by thread_create() so
+   that spawning a thread doesn't cost a trip through palloc.
+   Protected by sched_lock, which is held where threads die, in
+   thread_schedule_tail(). */
+#define THREAD_PAGE_CACHE_SIZE 32
+static void *thread_page_cache[THREAD_PAGE_CACHE_SIZE];
+static int thread_page_cache_cnt;
+static long long thread_page_hits;    /* # of pages reused. */
+static long long thread_page_misses;  /* # of pages from palloc. */
+
+/* If false, dead threads' pages go straight back to palloc.
+   Controlled by kernel command-line option
+   "-thread-no-page-cache". */
+bool thread_page_caching = true;
+
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
   {
@@ -55,21 +76,40 @@ static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
 
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
-
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If true, use the completely fair scheduler.  Controlled by
+   kernel command-line option "-cfs". */
+bool thread_cfs;
+
+/* Scheduling classes, highest rank first.  The last one is the
+   base class, which new threads start in. */
+#define SCHED_CLASS_CNT 2
+static const struct sched_class *sched_classes[SCHED_CLASS_CNT];
+static const struct sched_class *base_class;
+
+/* Last tick the classes' system_tick() ran for.  Protected by
+   sched_lock. */
+static int64_t last_system_tick;
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
+static void idle_loop (void) NO_RETURN;
 // static struct thread *running_thread (void);
-static struct thread *next_thread_to_run (void);
+static struct thread *next_thread_to_run (struct cpu *);
+static int select_cpu (struct thread *);
+static void kick_cpu (struct cpu *, struct thread *);
+static bool thread_preempts (struct thread *, struct thread *);
+static bool thread_wakes_before (struct thread *, struct thread *);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
+static struct thread *alloc_thread_page (void);
+static void free_thread_page (struct thread *);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
@@ -93,19 +133,24 @@ thread_init (void)
 {
   ASSERT (intr_get_level () == INTR_OFF);
 
+  spinlock_init (&sched_lock, "sched");
   lock_init (&tid_lock);
   list_init (&all_list);
 
-  if (thread_mlfqs) {
-    mlfq_scheduler_init ();
-  } else {
-    rr_scheduler_init ();
-  }
+  base_class = thread_mlfqs ? &mlfq_sched_class
+               : thread_cfs ? &cfs_sched_class : &rr_sched_class;
+  sched_classes[0] = &edf_sched_class;
+  sched_classes[1] = base_class;
+  for (int i = 0; i < SCHED_CLASS_CNT; i++)
+    if (sched_classes[i]->init != NULL)
+      sched_classes[i]->init ();
+  softirq_register (SOFTIRQ_SCHED, thread_tick_tail, "sched");
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
+  cpus[0].current = initial_thread;
   initial_thread->tid = allocate_tid ();
 } 
 
@@ -126,13 +171,18 @@ thread_start (void)
   sema_down (&idle_started);
 }
 
-/* Called by the timer interrupt handler at each timer tick.
-   Thus, this function runs in an external interrupt context. */
+/* Called by the timer interrupt handler at each timer tick, on
+   every CPU.  Thus, this function runs in an external interrupt
+   context. */
 void
 thread_tick (void) 
 {
   struct thread *t = thread_current ();
+  struct cpu *cpu = cpu_current ();
   const bool is_idle = is_idle_thread (t);
+  bool preempt;
+
+  spinlock_acquire (&sched_lock);
 
   /* Update statistics. */
   if (is_idle)
@@ -144,22 +194,163 @@ thread_tick (void)
   else
     kernel_ticks++;
 
-  if (thread_mlfqs && ! is_idle)
-    mlfq_thread_tick (&t->thread_mlfq_block);
+  /* Enforce preemption.  A class with a tick hook decides when
+     its threads' slices end. */
+  cpu->thread_ticks++;
+  if (! is_idle && t->sched_class->tick != NULL)
+    preempt = t->sched_class->tick (t);
+  else
+    preempt = cpu->thread_ticks >= TIME_SLICE;
+  if (preempt)
+    {
+      SCHED_TRACE (SCHED_EV_PREEMPT, t->tid, -1, 0);
+      intr_yield_on_return ();
+    }
+
+  /* System-wide updates are only done by the CPU that counts
+     timer_ticks(), and not with interrupts off. */
+  if (cpu->id == 0)
+    softirq_raise (SOFTIRQ_SCHED);
+
+  spinlock_release (&sched_lock);
+}
+
+/* Credits CNT timer ticks during which the tickless timer held
+   off the interrupt to the idle thread, which was the one
+   running.  Whatever the MLFQS did in the meantime ends a tick,
+   too. */
+void
+thread_account_skipped_ticks (int64_t cnt)
+{
+  spinlock_acquire (&sched_lock);
+  idle_ticks += cnt;
+  if (thread_mlfqs && cnt > 0)
+    mlfq_tick_boundary ();
+  spinlock_release (&sched_lock);
+}
+
+/* Returns the first tick after NOW at which the scheduler needs
+   a timer interrupt to run even if every CPU is idle, or LIMIT if
+   none comes before it.  Interrupts must be off. */
+int64_t
+thread_next_sched_event (int64_t now, int64_t limit)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
 
-  /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
-    intr_yield_on_return ();
+  spinlock_acquire (&sched_lock);
+  for (int i = 0; i < SCHED_CLASS_CNT; i++)
+    if (sched_classes[i]->next_event != NULL)
+      limit = sched_classes[i]->next_event (now, limit);
+  spinlock_release (&sched_lock);
 
-  thread_tick_tail ();
+  return limit;
 }
 
+/* Most threads whose CPU time thread_print_stats() prints. */
+#define USAGE_PRINT_MAX 32
+
 /* Prints thread statistics. */
 void
 thread_print_stats (void) 
 {
+  static struct
+    {
+      char name[16];
+      tid_t tid;
+      struct thread_usage usage;
+    }
+  usages[USAGE_PRINT_MAX];
+  struct list_elem *e;
+  enum intr_level old_level;
+  int cnt = 0, i;
+
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  printf ("Thread pages: %lld reused, %lld allocated\n",
+          thread_page_hits, thread_page_misses);
+
+  /* Copy the counters first: printf() may sleep. */
+  old_level = sched_lock_acquire ();
+  for (e = list_begin (&all_list);
+       e != list_end (&all_list) && cnt < USAGE_PRINT_MAX; e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      memcpy (usages[cnt].name, t->name, sizeof usages[cnt].name);
+      usages[cnt].tid = t->tid;
+      thread_get_usage (t, &usages[cnt].usage);
+      cnt++;
+    }
+  sched_lock_release (old_level);
+
+  for (i = 0; i < cnt; i++)
+    {
+      const struct thread_usage *u = &usages[i].usage;
+      printf ("Thread %s (%d): %"PRIu64" us user, %"PRIu64" us kernel, "
+              "%lld faults, %lld+%lld switches\n",
+              usages[i].name, usages[i].tid,
+              timer_cycles_to_us (u->user_cycles),
+              timer_cycles_to_us (u->kernel_cycles), u->page_faults,
+              u->voluntary_switches, u->involuntary_switches);
+    }
+}
+
+/* Stores T's CPU time and scheduling counters in *USAGE.  For the
+   running thread, includes the time since it last entered the
+   kernel or was switched to. */
+void
+thread_get_usage (struct thread *t, struct thread_usage *usage) 
+{
+  enum intr_level old_level = intr_disable ();
+
+  *usage = t->usage;
+  if (t == thread_current ())
+    usage->kernel_cycles += rdtsc () - t->usage_tsc;
+
+  intr_set_level (old_level);
+}
+
+/* Charges the time since the running thread last left the kernel
+   to its user time.  Called on every entry to the kernel from
+   user mode. */
+void
+thread_usage_kernel_entry (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  struct thread *t = thread_current ();
+  const uint64_t now = rdtsc ();
+
+  t->usage.user_cycles += now - t->usage_tsc;
+  t->usage_tsc = now;
+
+  intr_set_level (old_level);
+}
+
+/* Charges the time since the running thread last entered the
+   kernel to its kernel time.  Called on every return to user
+   mode. */
+void
+thread_usage_kernel_exit (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  struct thread *t = thread_current ();
+  const uint64_t now = rdtsc ();
+
+  t->usage.kernel_cycles += now - t->usage_tsc;
+  t->usage_tsc = now;
+
+  intr_set_level (old_level);
+}
+
+/* Stores the number of thread pages reused from the cache of
+   dead threads' pages into *HITS and the number obtained from
+   palloc into *MISSES. */
+void
+thread_page_stats (long long *hits, long long *misses) 
+{
+  enum intr_level old_level = sched_lock_acquire ();
+  *hits = thread_page_hits;
+  *misses = thread_page_misses;
+  sched_lock_release (old_level);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -190,13 +381,14 @@ thread_create (const char *name, int priority,
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = alloc_thread_page ();
   if (t == NULL)
     return TID_ERROR;
 
   /* Initialize thread. */
   init_thread (t, name, priority);
   tid = t->tid = allocate_tid ();
+  t->cpu = cpu_current ()->id;
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame (t, sizeof *kf);
@@ -217,7 +409,7 @@ thread_create (const char *name, int priority,
   bool is_idle = function == idle;
   if (is_idle) {
     t->status = THREAD_READY;
-    idle_thread = t;
+    cpus[0].idle_thread = t;
   } else {
     /* Add to run queue. */
     thread_unblock (t);
@@ -233,15 +425,17 @@ thread_create (const char *name, int priority,
 /* Puts the current thread to sleep.  It will not be scheduled
    again until awoken by thread_unblock().
 
-   This function must be called with interrupts turned off.  It
-   is usually a better idea to use one of the synchronization
-   primitives in synch.h. */
+   This function must be called with sched_lock held, see
+   sched_lock_acquire().  It is usually a better idea to use one
+   of the synchronization primitives in synch.h. */
 void
 thread_block (void) 
 {
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
 
+  SCHED_TRACE (SCHED_EV_BLOCK, thread_current ()->tid, 0, 0);
   thread_current ()->status = THREAD_BLOCKED;
   schedule ();
 }
@@ -251,9 +445,10 @@ thread_block (void)
    make the running thread ready.)
 
    This function does not preempt the running thread.  This can
-   be important: if the caller had disabled interrupts itself,
-   it may expect that it can atomically unblock a thread and
-   update other data. */
+   be important: if the caller holds sched_lock itself, it may
+   expect that it can atomically unblock a thread and update
+   other data.  If T ends up on another CPU's run queue, though,
+   that CPU is interrupted if it should run T right away. */
 void
 thread_unblock (struct thread *t) 
 {
@@ -261,11 +456,14 @@ thread_unblock (struct thread *t)
 
   ASSERT (is_thread (t));
 
-  old_level = intr_disable ();
+  old_level = sched_lock_acquire ();
   ASSERT (t->status == THREAD_BLOCKED);
+  t->cpu = select_cpu (t);
+  SCHED_TRACE (SCHED_EV_WAKEUP, t->tid, running_thread ()->tid, t->cpu);
   insert_ready_thread (t);
   t->status = THREAD_READY;
-  intr_set_level (old_level);
+  kick_cpu (&cpus[t->cpu], t);
+  sched_lock_release (old_level);
 }
 
 /* Returns the name of the running thread. */
@@ -311,11 +509,13 @@ thread_exit (void)
 #ifdef USERPROG
   process_exit ();
 #endif
+  fpu_thread_exit ();
+  edf_thread_exit (thread_current ());
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
-  intr_disable ();
+  sched_lock_acquire ();
   list_remove (&thread_current()->allelem);
   thread_current ()->status = THREAD_DYING;
   schedule ();
@@ -332,16 +532,17 @@ thread_yield (void)
   
   ASSERT (!intr_context ());
 
-  old_level = intr_disable ();
-  if (cur != idle_thread) 
+  old_level = sched_lock_acquire ();
+  if (!is_idle_thread (cur)) 
     insert_ready_thread (cur);
   cur->status = THREAD_READY;
   schedule ();
-  intr_set_level (old_level);
+  sched_lock_release (old_level);
 }
 
 /* Invoke function 'func' on all threads, passing along 'aux'.
-   This function must be called with interrupts off. */
+   This function must be called with interrupts off.  FUNC runs
+   with sched_lock held, so it must not sleep. */
 void
 thread_foreach (thread_action_func *func, void *aux)
 {
@@ -349,53 +550,47 @@ thread_foreach (thread_action_func *func, void *aux)
 
   ASSERT (intr_get_level () == INTR_OFF);
 
+  spinlock_acquire (&sched_lock);
   for (e = list_begin (&all_list); e != list_end (&all_list);
        e = list_next (e))
     {
       struct thread *t = list_entry (e, struct thread, allelem);
       func (t, aux);
     }
+  spinlock_release (&sched_lock);
 }
 
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void
 thread_set_priority (int new_priority) 
 {
-  if (! thread_mlfqs) {
-    return rr_thread_set_priority (new_priority);
-  }
+  if (base_class->set_priority != NULL)
+    base_class->set_priority (new_priority);
 }
 
 /* Returns the current thread's priority. */
 int
 thread_get_priority (void) 
 {
-  if (thread_mlfqs) 
-    return mlfq_thread_priority (thread_current ());
-  else
-    return rr_thread_priority (thread_current ());
+  return base_class->priority (thread_current ());
 }
 
 /* Sets the current thread's nice value to NICE. */
 void
 thread_set_nice (int nice) 
 {
-  if (!thread_mlfqs) {
-    return;
-  }
-
-  mlfq_thread_set_nice (nice);
+  if (base_class->set_nice != NULL)
+    base_class->set_nice (nice);
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) 
 {
-  if (! thread_mlfqs) {
+  if (base_class->get_nice == NULL)
     return 0;
-  }
 
-  return mlfq_thread_get_nice (running_thread ());
+  return base_class->get_nice (running_thread ());
 }
 
 /* Returns 100 times the system load average. */
@@ -426,7 +621,10 @@ thread_get_recent_cpu (void)
    to it to enable thread_start() to continue, and immediately
    blocks.  After that, the idle thread never appears in the
    ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   special case when the ready list is empty.
+
+   This is the idle thread of the BSP.  The idle threads of the
+   other CPUs are the threads they boot on, see thread_run_ap(). */
 static void
 idle (void *idle_started_ UNUSED) 
 {
@@ -434,11 +632,37 @@ idle (void *idle_started_ UNUSED)
   // idle_thread = thread_current ();
   sema_up (idle_started);
 
+  idle_loop ();
+}
+
+/* Body of every CPU's idle thread. */
+static void
+idle_loop (void)
+{
+  const bool is_bsp = cpu_current ()->id == 0;
+
   for (;;) 
     {
-      /* Let someone else run. */
+      /* Let someone else run.  schedule() gives the timer its
+         ticks back if it does. */
       intr_disable ();
+      spinlock_acquire (&sched_lock);
       thread_block ();
+      spinlock_release (&sched_lock);
+
+      /* Nobody else can run: zero a page for the page allocator,
+         if it wants one, then let pending interrupts in and check
+         again. */
+      if (palloc_zero_idle ())
+        {
+          intr_enable ();
+          continue;
+        }
+
+      /* Nothing to do at all: in tickless mode, hold off the timer
+         interrupt until it is needed. */
+      if (is_bsp)
+        timer_idle_enter ();
 
       /* Re-enable interrupts and wait for the next one.
 
@@ -462,7 +686,8 @@ kernel_thread (thread_func *function, void *aux)
 {
   ASSERT (function != NULL);
 
-  intr_enable ();       /* The scheduler runs with interrupts off. */
+  /* The scheduler runs with interrupts off and sched_lock held. */
+  sched_lock_release (INTR_ON);
   function (aux);       /* Execute the thread function. */
   thread_exit ();       /* If function() returns, kill the thread. */
 }
@@ -503,18 +728,18 @@ init_thread (struct thread *t, const char *name, int priority)
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
+  t->fpu_cpu = -1;
+  t->usage_tsc = rdtsc ();
   
-  if (thread_mlfqs) {
-    mlfq_thread_init (t);
-  } else {
-    rr_thread_init (t, priority);
-  }
+  t->sched_class = base_class;
+  if (base_class->thread_init != NULL)
+    base_class->thread_init (t, priority);
 
   t->magic = THREAD_MAGIC;
 
-  old_level = intr_disable ();
+  old_level = sched_lock_acquire ();
   list_push_back (&all_list, &t->allelem);
-  intr_set_level (old_level);
+  sched_lock_release (old_level);
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
@@ -530,6 +755,44 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
+/* Returns a page for a new thread, or a null pointer if memory
+   is exhausted.  Only the struct thread at its bottom gets
+   initialized, by init_thread(): the kernel stack above it is
+   left as it is, so a recycled page needn't be cleared. */
+static struct thread *
+alloc_thread_page (void) 
+{
+  struct thread *t = NULL;
+  enum intr_level old_level;
+
+  old_level = sched_lock_acquire ();
+  if (thread_page_cache_cnt > 0) 
+    {
+      t = thread_page_cache[--thread_page_cache_cnt];
+      thread_page_hits++;
+    }
+  else
+    thread_page_misses++;
+  sched_lock_release (old_level);
+
+  if (t == NULL)
+    t = palloc_get_page (0);
+  return t;
+}
+
+/* Frees the page of dead thread T, keeping it for reuse if the
+   cache is on and has room.  sched_lock must be held. */
+static void
+free_thread_page (struct thread *t) 
+{
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
+
+  if (thread_page_caching && thread_page_cache_cnt < THREAD_PAGE_CACHE_SIZE)
+    thread_page_cache[thread_page_cache_cnt++] = t;
+  else
+    palloc_free_page (t);
+}
+
 
 
 /* Completes a thread switch by activating the new thread's page
@@ -554,12 +817,13 @@ thread_schedule_tail (struct thread *prev)
   struct thread *cur = running_thread ();
   
   ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
 
   /* Mark us as running. */
   cur->status = THREAD_RUNNING;
 
   /* Start new time slice. */
-  thread_ticks = 0;
+  cpu_current ()->thread_ticks = 0;
 
 #ifdef USERPROG
   /* Activate the new address space. */
@@ -574,30 +838,57 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      free_thread_page (prev);
     }
 }
 
-/* Schedules a new process.  At entry, interrupts must be off and
-   the running process's state must have been changed from
-   running to some other state.  This function finds another
-   thread to run and switches to it.
+/* Schedules a new process.  At entry, interrupts must be off,
+   sched_lock must be held exactly once and the running process's
+   state must have been changed from running to some other state.
+   This function finds another thread to run and switches to it.
+
+   sched_lock is handed over to the next thread, which releases
+   it: either on its way out of its own call to schedule(), or in
+   kernel_thread() if it never ran before.
 
    It's not safe to call printf() until thread_schedule_tail()
    has completed. */
 static void
 schedule (void) 
 {
+  struct cpu *cpu = cpu_current ();
   struct thread *cur = running_thread ();
-  struct thread *next = next_thread_to_run ();
+  struct thread *next = next_thread_to_run (cpu);
   struct thread *prev = NULL;
 
   ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
+  ASSERT (sched_lock.depth == 1);
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
-  if (cur != next)
-    prev = switch_threads (cur, next);
+  next->cpu = cpu->id;
+  cpu->current = next;
+  if (cur != next) 
+    {
+      const uint64_t now = rdtsc ();
+
+      cur->usage.kernel_cycles += now - cur->usage_tsc;
+      next->usage_tsc = now;
+      if (cur->status == THREAD_BLOCKED)
+        cur->usage.voluntary_switches++;
+      else if (cur->status == THREAD_READY)
+        cur->usage.involuntary_switches++;
+
+      /* Whatever woke the idle thread, the thread that takes over
+         needs its timer ticks. */
+      if (cur == cpu->idle_thread && cpu->id == 0)
+        timer_idle_exit ();
+
+      SCHED_TRACE (SCHED_EV_SWITCH, next->tid, cur->tid, cur->status);
+      fpu_switch_out (cur);
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
@@ -616,93 +907,253 @@ allocate_tid (void)
 }
 
 
-/* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+/* Removes and returns the thread that should run next from the
+   run queue of CPU, or returns a null pointer if it is empty. */
+static struct thread *
+pop_ready_thread (struct cpu *cpu)
+{
+  for (int i = 0; i < SCHED_CLASS_CNT; i++) {
+    struct thread *t = sched_classes[i]->pick_next (cpu->id);
+    if (t != NULL) {
+      cpu->ready_cnt--;
+      return t;
+    }
+  }
+
+  return NULL;
+}
+
+/* Chooses and returns the next thread to be scheduled on CPU.
+   Should return a thread from CPU's run queue, unless the run
+   queue is empty.  (If the running thread can continue running,
+   then it will be in the run queue.)  If the run queue is empty,
+   takes a thread from the CPU with the longest run queue, and if
+   there is none at all, returns CPU's idle thread. */
 static struct thread *
-next_thread_to_run (void) 
+next_thread_to_run (struct cpu *cpu) 
 {
-  struct thread* t = thread_mlfqs ? mlfq_next_thread_to_run () : rr_next_thread_to_run ();
+  struct thread* t = pop_ready_thread (cpu);
+  if (t == NULL) {
+    struct cpu *busiest = NULL;
+    for (int i = 0; i < cpu_cnt; i++)
+      if (cpus[i].ready_cnt > 0 && (busiest == NULL || cpus[i].ready_cnt > busiest->ready_cnt))
+        busiest = &cpus[i];
+
+    if (busiest != NULL)
+      t = pop_ready_thread (busiest);
+  }
+
   if (t == NULL)
-    return idle_thread;
+    return cpu->idle_thread;
 
   return t;
 }
 
-static int thread_priority (struct thread* t) {
-  if (thread_mlfqs)
-    return mlfq_thread_priority (t);
-  else 
-    return rr_thread_priority (t);
+/* Returns true if CPU is running its idle thread and has nothing
+   else to run. */
+static bool cpu_is_idle (const struct cpu *cpu) {
+  return cpu->current == cpu->idle_thread && cpu->ready_cnt == 0;
+}
+
+/* Returns the id of the CPU whose run queue T, which is about to
+   become ready, should go in: the CPU it last ran on, unless
+   that one is busy and another one is idle. */
+static int select_cpu (struct thread *t) {
+  if (cpu_cnt == 1 || cpu_is_idle (&cpus[t->cpu]))
+    return t->cpu;
+
+  for (int i = 0; i < cpu_cnt; i++)
+    if (cpu_is_idle (&cpus[i]))
+      return i;
+
+  return t->cpu;
+}
+
+/* T was just put in CPU's run queue.  If CPU is another CPU
+   that is idle, or running something less important than T,
+   interrupts it so that it reschedules.  On the current CPU,
+   callers outside interrupt context check for themselves, but a
+   thread of a higher class woken by an interrupt handler, such
+   as a real-time thread whose period started, doesn't wait for
+   the time slice to end. */
+static void kick_cpu (struct cpu *cpu, struct thread *t) {
+  if (cpu == cpu_current ()) {
+    if (intr_context () && t->sched_class->rank > cpu->current->sched_class->rank) {
+      SCHED_TRACE (SCHED_EV_PREEMPT, cpu->current->tid, t->tid, 0);
+      intr_yield_on_return ();
+    }
+    return;
+  }
+
+  if (cpu->current == cpu->idle_thread
+      || thread_preempts (t, cpu->current)) {
+    SCHED_TRACE (SCHED_EV_PREEMPT, cpu->current->tid, t->tid, 0);
+    smp_send_resched (cpu);
+  }
 }
 
-static int cmp_thread_priority (struct thread* left_t, struct thread* right_t) {
-  return thread_priority (left_t) - thread_priority (right_t);
+/* Returns true if T should run before CUR: T belongs to a higher
+   ranked class, or to the same class and that class says so. */
+static bool thread_preempts (struct thread* t, struct thread* cur) {
+  if (t->sched_class != cur->sched_class)
+    return t->sched_class->rank > cur->sched_class->rank;
+
+  return t->sched_class->yield_check (cur, t);
 }
 
-static bool thread_priority_less (const struct list_elem *left, const struct list_elem *right, void *_ UNUSED) {
-  struct thread* left_t = list_entry (left, struct thread, elem);
-  struct thread* right_t = list_entry (right, struct thread, elem);
+/* Returns true if waiting thread T should be woken before U: T
+   belongs to a higher ranked class, or to the same class and that
+   class orders it first.  Unlike thread_preempts(), a strict weak
+   order, so it can order heaps. */
+static bool thread_wakes_before (struct thread* t, struct thread* u) {
+  if (t->sched_class != u->sched_class)
+    return t->sched_class->rank > u->sched_class->rank;
 
-  return cmp_thread_priority (left_t, right_t) < 0;
+  return t->sched_class->wakes_before (t, u);
 }
 
-struct thread * pop_highest_priority_thread (struct list* thread_list) {
-  struct list_elem * next_thread = list_pop_max (thread_list, thread_priority_less, NULL);
+/* Orders the waiters of a semaphore: the thread that should run
+   first is the greatest. */
+bool thread_waiter_less (const struct pheap_elem *left, const struct pheap_elem *right, void *_ UNUSED) {
+  struct thread* left_t = pheap_entry (left, struct thread, wait_elem);
+  struct thread* right_t = pheap_entry (right, struct thread, wait_elem);
 
-  return list_entry (next_thread, struct thread, elem);
+  return thread_wakes_before (right_t, left_t);
 }
 
 /** Should be followed by call to thread_yield()
  */
 bool should_curr_thread_yield_priority (struct thread * other) {
-  return !intr_context () && cmp_thread_priority (other, thread_current ()) > 0;
+  return !intr_context () && thread_preempts (other, thread_current ());
 }
 
-static bool cond_waiter_less (const struct list_elem *left, const struct list_elem *right, void *_ UNUSED) {
-  struct semaphore * left_sema = & (list_entry (left, struct semaphore_elem, elem)->semaphore);
-  struct semaphore * right_sema = & (list_entry (right, struct semaphore_elem, elem)->semaphore);
-
-  ASSERT (!sema_no_waiters (left_sema));
-  ASSERT (!sema_no_waiters (right_sema)); 
-
-  struct thread * left_thread = list_entry (list_front (&left_sema->waiters), struct thread, elem);
-  struct thread * right_thread = list_entry (list_front (&right_sema->waiters), struct thread, elem);
+/* Orders the waiters of a condition variable the same way, by
+   the threads waiting. */
+bool cond_waiter_less (const struct pheap_elem *left, const struct pheap_elem *right, void *_ UNUSED) {
+  const struct semaphore_elem * left_w = pheap_entry (left, struct semaphore_elem, elem);
+  const struct semaphore_elem * right_w = pheap_entry (right, struct semaphore_elem, elem);
 
-  return cmp_thread_priority (left_thread, right_thread) < 0;
+  return thread_wakes_before (right_w->thread, left_w->thread);
 }
 
-struct semaphore_elem * pop_highest_priority_cond_var_waiter (struct list* waiters) {
-  struct list_elem * elem = list_pop_max(waiters, cond_waiter_less, NULL);
+/* Adds T to the run queue of CPU T->cpu. */
+static void insert_ready_thread (struct thread* t) {
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
 
-  return list_entry (elem, struct semaphore_elem, elem);
-} 
+  cpus[t->cpu].ready_cnt++;
+  t->sched_class->enqueue (t);
+}
 
-static void insert_ready_thread (struct thread* t) {
-  if (thread_mlfqs)
-    mlfq_insert_ready_thread (t);
-  else 
-    rr_insert_ready_thread (t);
+/* Returns the class new threads start in. */
+const struct sched_class * thread_base_sched_class (void) {
+  return base_class;
 }
 
-static void thread_tick_tail () {
-  if (!thread_mlfqs)
+/* Moves T to scheduling class CLASS.  If T is ready it changes
+   run queues, which may make it worth running right away.
+   sched_lock must be held. */
+void thread_set_sched_class (struct thread *t, const struct sched_class *class) {
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
+
+  if (t->sched_class == class)
     return;
 
-  const int64_t ticks = timer_ticks ();
-  if (ticks % TIME_SLICE == 0) {
-    mlfq_thread_quantum_tick ();
+  if (t->status == THREAD_READY && !is_idle_thread (t)) {
+    t->sched_class->dequeue (t);
+    t->sched_class = class;
+    class->enqueue (t);
+    kick_cpu (&cpus[t->cpu], t);
+  } else {
+    t->sched_class = class;
   }
+}
 
-  if (ticks % TIMER_FREQ == 0) {
-    mlfq_thread_second_tick ();
+/* Scheduler softirq: runs the classes' system ticks for every
+   tick since it last ran, which may be more than one if the
+   softirq was held up or the tickless timer skipped ticks. */
+static void thread_tick_tail (void) {
+  const int64_t now = timer_ticks ();
+  enum intr_level old_level = sched_lock_acquire ();
+  while (last_system_tick < now) {
+    last_system_tick++;
+    for (int i = 0; i < SCHED_CLASS_CNT; i++)
+      if (sched_classes[i]->system_tick != NULL)
+        sched_classes[i]->system_tick (last_system_tick);
   }
+  sched_lock_release (old_level);
 }
 
 bool is_idle_thread (struct thread* t) {
-  return t == idle_thread;
+  return t == cpus[t->cpu].idle_thread;
+}
+
+/* Returns the number of CPUs running a thread other than their
+   idle thread.  sched_lock must be held. */
+int thread_running_cnt (void) {
+  ASSERT (spinlock_held_by_current_cpu (&sched_lock));
+
+  int cnt = 0;
+  for (int i = 0; i < cpu_cnt; i++)
+    if (cpus[i].current != cpus[i].idle_thread)
+      cnt++;
+
+  return cnt;
+}
+
+/* Disables interrupts and acquires sched_lock, which must be held
+   to change the state of any thread or run queue, and to block.
+   Returns the previous interrupt level, to be passed to
+   sched_lock_release().
+
+   On a single CPU disabling interrupts would be enough, but
+   other CPUs keep running: sched_lock is what keeps them out. */
+enum intr_level sched_lock_acquire (void) {
+  enum intr_level old_level = intr_disable ();
+  spinlock_acquire (&sched_lock);
+  return old_level;
+}
+
+/* Releases sched_lock and sets the interrupt level to LEVEL. */
+void sched_lock_release (enum intr_level level) {
+  spinlock_release (&sched_lock);
+  intr_set_level (level);
+}
+
+/* Sets up the idle thread of secondary CPU ID.  Returns the top
+   of its stack, which the CPU boots on before it calls
+   thread_run_ap(). */
+void * thread_create_ap_idle (int id) {
+  struct thread *t = palloc_get_page (PAL_ZERO);
+  if (t == NULL)
+    return NULL;
+
+  char name[16];
+  snprintf (name, sizeof name, "idle%d", id);
+  init_thread (t, name, PRI_MIN);
+  t->tid = allocate_tid ();
+  t->cpu = id;
+  cpus[id].idle_thread = t;
+
+  return (uint8_t *) t + PGSIZE;
+}
+
+/* Turns the code running on an AP, on the stack set up by
+   thread_create_ap_idle(), into that CPU's idle thread and
+   starts scheduling threads.  Interrupts must be off. */
+void thread_run_ap (void) {
+  struct thread *t = thread_current ();
+  struct cpu *cpu = &cpus[t->cpu];
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t == cpu->idle_thread);
+
+  spinlock_acquire (&sched_lock);
+  t->status = THREAD_RUNNING;
+  cpu->current = t;
+  cpu->started = true;
+  spinlock_release (&sched_lock);
+
+  idle_loop ();
 }
 
 /* Offset of `stack' member within `struct thread'.
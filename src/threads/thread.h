@@ -4,10 +4,14 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
-#include <kernel/array.h>
+#include "interrupt.h"
+#include "spinlock.h"
 #include "synch.h"
 #include "scheduler.h"
 #include "mlfq-scheduler.h"
+#include "edf-scheduler.h"
+#include "cfs-scheduler.h"
+#include "sched-class.h"
 #include "macros.h"
 
 /* States in a thread's life cycle. */
@@ -83,12 +87,21 @@ typedef int tid_t;
    the `magic' member of the running thread's `struct thread' is
    set to THREAD_MAGIC.  Stack overflow will normally change this
    value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+/* CPU time and scheduling events of a thread.  Times are in
+   time-stamp counter cycles, see timer_cycles_to_us(). */
+struct thread_usage
+  {
+    uint64_t user_cycles;               /* Time run in user mode. */
+    uint64_t kernel_cycles;             /* Time run in the kernel. */
+    long long page_faults;              /* # of page faults taken. */
+    long long voluntary_switches;       /* # of times it blocked. */
+    long long involuntary_switches;     /* # of times it was preempted or yielded. */
+  };
+
+/* The `elem' member is the thread's element in the run queue of
+   its scheduling class.  A blocked thread waiting for a semaphore
+   is instead in the semaphore's waiters heap through `wait_elem'
+   (synch.c), ordered by priority. */
 struct thread
   {
     /* Owned by thread.c. */
@@ -98,14 +111,32 @@ struct thread
     uint8_t *stack;                     /* Saved stack pointer. */
     struct rr_thread_block rr_thread_block;
     struct thread_mlfq_block thread_mlfq_block; 
+    const struct sched_class *sched_class; /* Scheduling class. */
+    struct edf_thread_block edf_thread_block;
+    struct cfs_thread_block cfs_thread_block;
     struct list_elem allelem;           /* List element for all threads list. */
+    int cpu;                            /* CPU running it, or whose run queue it is in or last ran on. */
+    struct thread_usage usage;          /* CPU time, only updated by the thread itself. */
+    uint64_t usage_tsc;                 /* TSC when the time not yet in USAGE began. */
+
+    /* Owned by threads/fpu.c. */
+    void *fpu_area;                     /* FXSAVE area, null until the FPU is used. */
+    int fpu_cpu;                        /* CPU whose FPU it was last loaded into. */
 
     /* Shared between thread.c and synch.c. */
-    struct list_elem elem;              /* List element. */
+    struct list_elem elem;              /* Run queue element. */
+
+    /* Owned by synch.c, protected by sched_lock. */
+    struct pheap_elem wait_elem;        /* Element in a semaphore's waiters. */
+    struct semaphore *waiting_sema;     /* Semaphore it waits for, or null. */
+    struct semaphore_elem *cond_waiter; /* Its queued condition waiter, or null. */
+    struct rwlock_hold rw_holds[RWLOCK_HOLD_MAX]; /* Reader-writer locks it holds. */
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
+    struct process_node *process;       /* Process it runs, or null. */
+    void *user_esp;                     /* User %esp at last system call. */
 #endif
 
     /* Owned by thread.c. */
@@ -117,11 +148,27 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the completely fair scheduler instead.
+   Controlled by kernel command-line option "-cfs". */
+extern bool thread_cfs;
+
+/* If false, don't keep dead threads' pages for reuse.
+   Controlled by kernel command-line option
+   "-thread-no-page-cache". */
+extern bool thread_page_caching;
+
+extern struct spinlock sched_lock;
+enum intr_level sched_lock_acquire (void);
+void sched_lock_release (enum intr_level);
+
 void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
+void thread_account_skipped_ticks (int64_t cnt);
+int64_t thread_next_sched_event (int64_t now, int64_t limit);
 void thread_print_stats (void);
+void thread_page_stats (long long *hits, long long *misses);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -140,6 +187,10 @@ void thread_yield (void);
 typedef void thread_action_func (struct thread *t, void *aux);
 void thread_foreach (thread_action_func *, void *);
 
+void thread_get_usage (struct thread *, struct thread_usage *);
+void thread_usage_kernel_entry (void);
+void thread_usage_kernel_exit (void);
+
 int thread_get_priority (void);
 void thread_set_priority (int);
 
@@ -149,15 +200,19 @@ int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
 
-struct thread * pop_highest_priority_thread (struct list* thread_list);
+bool thread_waiter_less (const struct pheap_elem *, const struct pheap_elem *, void *aux);
+bool cond_waiter_less (const struct pheap_elem *, const struct pheap_elem *, void *aux);
 bool should_curr_thread_yield_priority (struct thread * other);
-struct semaphore_elem * pop_highest_priority_cond_var_waiter (struct list* waiters);
 
 struct thread * running_thread (void);
 
 void thread_quantum_tick (void);
 
 bool is_idle_thread (struct thread* t);
+int thread_running_cnt (void);
+
+void * thread_create_ap_idle (int id);
+void thread_run_ap (void) NO_RETURN;
 tid_t current_thread_tid(void);
 
 #ifdef USERPROG
@@ -0,0 +1,438 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/softirq.h"
+#include "threads/spinlock.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* A worker thread of a work queue. */
+struct worker
+  {
+    struct workqueue *wq;       /* Queue it works for. */
+    struct work *current;       /* Item being run, or null. */
+    uint64_t current_seq;       /* CURRENT's sequence number. */
+  };
+
+struct workqueue *system_wq;
+int system_wq_workers = 2;
+
+/* Protects every work queue and work item, and the lists below.
+   A spinlock, so that interrupt handlers and the work softirq
+   can queue work. */
+static struct spinlock wq_lock = SPINLOCK_INITIALIZER ("workqueue");
+
+/* Delayed items of all queues, soonest first. */
+static struct list delayed_list = LIST_INITIALIZER (delayed_list);
+
+/* All work queues, for statistics. */
+static struct list all_queues = LIST_INITIALIZER (all_queues);
+
+static thread_func worker_thread;
+static void delayed_softirq (void);
+
+/* Initializes the work queue facility and creates system_wq.
+   Must be called after thread_start(). */
+void
+workqueue_init (void)
+{
+  softirq_register (SOFTIRQ_WORK, delayed_softirq, "work");
+
+  system_wq = workqueue_create ("system", system_wq_workers, PRI_DEFAULT);
+  if (system_wq == NULL)
+    PANIC ("could not create system work queue");
+}
+
+/* Creates a work queue named NAME, run by WORKER_CNT kernel
+   threads at PRIORITY.  Returns the new queue, or a null pointer
+   if memory or threads run out.  Work queues are never
+   destroyed. */
+struct workqueue *
+workqueue_create (const char *name, int worker_cnt, int priority)
+{
+  struct workqueue *wq;
+  enum intr_level old_level;
+  int i;
+
+  ASSERT (worker_cnt > 0);
+
+  wq = malloc (sizeof *wq);
+  if (wq == NULL)
+    return NULL;
+  wq->workers = calloc (worker_cnt, sizeof *wq->workers);
+  if (wq->workers == NULL)
+    {
+      free (wq);
+      return NULL;
+    }
+
+  wq->name = name;
+  wq->worker_cnt = worker_cnt;
+  list_init (&wq->pending);
+  sema_init (&wq->ready, 0);
+  wq->next_seq = 0;
+  sema_init (&wq->flushed, 0);
+  wq->flush_waiters = 0;
+  wq->stats = (struct workqueue_stats) { 0 };
+
+  /* The workers don't touch WQ before there is work, so there is
+     nothing to undo once the first of them exists. */
+  for (i = 0; i < worker_cnt; i++)
+    {
+      char thread_name[16];
+
+      wq->workers[i].wq = wq;
+      snprintf (thread_name, sizeof thread_name, "%s/%d", name, i);
+      if (thread_create (thread_name, priority, worker_thread,
+                         &wq->workers[i]) == TID_ERROR)
+        {
+          if (i == 0)
+            {
+              free (wq->workers);
+              free (wq);
+              return NULL;
+            }
+          wq->worker_cnt = i;
+          break;
+        }
+    }
+
+  old_level = intr_disable ();
+  spinlock_acquire (&wq_lock);
+  list_push_back (&all_queues, &wq->elem);
+  spinlock_release (&wq_lock);
+  intr_set_level (old_level);
+
+  return wq;
+}
+
+/* Initializes WORK to call FUNC with AUX when it runs. */
+void
+work_init (struct work *work, work_func *func, void *aux)
+{
+  ASSERT (work != NULL);
+  ASSERT (func != NULL);
+
+  work->func = func;
+  work->aux = aux;
+  work->state = WORK_IDLE;
+  work->wq = NULL;
+}
+
+/* Puts WORK at the end of its queue's ready items.  wq_lock must
+   be held.  The caller must up the queue's `ready' once it has
+   released wq_lock: sema_up() may yield. */
+static void
+make_ready (struct work *work)
+{
+  struct workqueue *wq = work->wq;
+
+  ASSERT (spinlock_held_by_current_cpu (&wq_lock));
+
+  work->state = WORK_PENDING;
+  work->seq = wq->next_seq++;
+  work->ready_tsc = rdtsc ();
+  list_push_back (&wq->pending, &work->elem);
+  if (++wq->stats.depth > wq->stats.max_depth)
+    wq->stats.max_depth = wq->stats.depth;
+}
+
+static bool
+due_less (const struct list_elem *a_, const struct list_elem *b_,
+          void *aux UNUSED)
+{
+  const struct work *a = list_entry (a_, struct work, elem);
+  const struct work *b = list_entry (b_, struct work, elem);
+  return a->due < b->due;
+}
+
+/* Queues WORK on WQ, to become ready after TICKS timer ticks, or
+   right away if TICKS is not positive.  Returns true if WORK was
+   queued, false if it already was. */
+bool
+workqueue_queue_delayed (struct workqueue *wq, struct work *work,
+                         int64_t ticks)
+{
+  enum intr_level old_level;
+  bool queued = false, ready = false;
+
+  ASSERT (wq != NULL);
+  ASSERT (work != NULL && work->func != NULL);
+
+  old_level = intr_disable ();
+  spinlock_acquire (&wq_lock);
+  if (work->state == WORK_IDLE)
+    {
+      work->wq = wq;
+      wq->stats.queued++;
+      if (ticks > 0)
+        {
+          work->state = WORK_DELAYED;
+          work->due = timer_ticks () + ticks;
+          list_insert_ordered (&delayed_list, &work->elem, due_less, NULL);
+        }
+      else
+        {
+          make_ready (work);
+          ready = true;
+        }
+      queued = true;
+    }
+  spinlock_release (&wq_lock);
+  intr_set_level (old_level);
+
+  if (ready)
+    sema_up (&wq->ready);
+  return queued;
+}
+
+/* Queues WORK on WQ to run as soon as a worker is free.  Returns
+   true if WORK was queued, false if it already was. */
+bool
+workqueue_queue (struct workqueue *wq, struct work *work)
+{
+  return workqueue_queue_delayed (wq, work, 0);
+}
+
+/* Waits for one of WQ's workers to finish an item.  wq_lock must
+   be held once, and is held again on return. */
+static void
+wait_for_progress (struct workqueue *wq)
+{
+  wq->flush_waiters++;
+  spinlock_release (&wq_lock);
+  sema_down (&wq->flushed);
+  spinlock_acquire (&wq_lock);
+}
+
+/* Returns true if one of WQ's workers is running WORK. */
+static bool
+is_running (const struct workqueue *wq, const struct work *work)
+{
+  int i;
+
+  for (i = 0; i < wq->worker_cnt; i++)
+    if (wq->workers[i].current == work)
+      return true;
+  return false;
+}
+
+/* Takes WORK off its queue, if it is queued, and waits until no
+   worker is running it any more, so that the caller may free it.
+   Returns true if WORK was queued, false otherwise.  Must not be
+   called by WORK's own function. */
+bool
+workqueue_cancel (struct work *work)
+{
+  struct workqueue *wq = work->wq;
+  enum intr_level old_level;
+  bool cancelled = false;
+
+  ASSERT (!intr_context ());
+
+  if (wq == NULL)
+    return false;
+
+  old_level = intr_disable ();
+  spinlock_acquire (&wq_lock);
+  if (work->state != WORK_IDLE)
+    {
+      if (work->state == WORK_PENDING)
+        wq->stats.depth--;
+      list_remove (&work->elem);
+      work->state = WORK_IDLE;
+      wq->stats.cancelled++;
+      cancelled = true;
+    }
+  while (is_running (wq, work))
+    wait_for_progress (wq);
+  spinlock_release (&wq_lock);
+  intr_set_level (old_level);
+
+  return cancelled;
+}
+
+/* Waits until every item that was ready on WQ when this function
+   was called has run.  Delayed items that were not due yet are not
+   waited for.  Must not be called from a work function of WQ. */
+void
+workqueue_flush (struct workqueue *wq)
+{
+  enum intr_level old_level;
+  uint64_t target;
+
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  spinlock_acquire (&wq_lock);
+  target = wq->next_seq;
+  for (;;)
+    {
+      bool busy = false;
+      int i;
+
+      /* Items are ready in sequence order, so the oldest one is
+         at the front of the list. */
+      if (!list_empty (&wq->pending)
+          && list_entry (list_front (&wq->pending), struct work, elem)->seq
+             < target)
+        busy = true;
+      for (i = 0; i < wq->worker_cnt; i++)
+        if (wq->workers[i].current != NULL
+            && wq->workers[i].current_seq < target)
+          busy = true;
+      if (!busy)
+        break;
+      wait_for_progress (wq);
+    }
+  spinlock_release (&wq_lock);
+  intr_set_level (old_level);
+}
+
+/* Work softirq: makes the delayed items that are due ready.
+   Raised by the timer interrupt on every tick. */
+static void
+delayed_softirq (void)
+{
+  const int64_t now = timer_ticks ();
+  enum intr_level old_level = intr_disable ();
+
+  for (;;)
+    {
+      struct workqueue *wq = NULL;
+
+      spinlock_acquire (&wq_lock);
+      if (!list_empty (&delayed_list))
+        {
+          struct work *work = list_entry (list_front (&delayed_list),
+                                          struct work, elem);
+          if (work->due <= now)
+            {
+              list_pop_front (&delayed_list);
+              make_ready (work);
+              wq = work->wq;
+            }
+        }
+      spinlock_release (&wq_lock);
+
+      if (wq == NULL)
+        break;
+      sema_up (&wq->ready);
+    }
+  intr_set_level (old_level);
+}
+
+/* Returns the tick at which the first delayed item becomes
+   ready, or LIMIT if none does before it.  Lets the tickless
+   timer hold the timer interrupt off.  Interrupts must be off. */
+int64_t
+workqueue_next_event (int64_t limit)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  spinlock_acquire (&wq_lock);
+  if (!list_empty (&delayed_list))
+    {
+      int64_t due = list_entry (list_front (&delayed_list),
+                                struct work, elem)->due;
+      if (due < limit)
+        limit = due;
+    }
+  spinlock_release (&wq_lock);
+
+  return limit;
+}
+
+/* A worker thread.  Runs WORKER_'s queue's ready items, one at a
+   time, forever. */
+static void
+worker_thread (void *worker_)
+{
+  struct worker *worker = worker_;
+  struct workqueue *wq = worker->wq;
+
+  for (;;)
+    {
+      enum intr_level old_level;
+      struct work *work;
+      uint64_t latency;
+      int waiters;
+
+      sema_down (&wq->ready);
+
+      old_level = intr_disable ();
+      spinlock_acquire (&wq_lock);
+      if (list_empty (&wq->pending))
+        {
+          /* The item this up was for has been cancelled. */
+          spinlock_release (&wq_lock);
+          intr_set_level (old_level);
+          continue;
+        }
+      work = list_entry (list_pop_front (&wq->pending), struct work, elem);
+      work->state = WORK_IDLE;
+      worker->current = work;
+      worker->current_seq = work->seq;
+      wq->stats.depth--;
+      latency = rdtsc () - work->ready_tsc;
+      wq->stats.latency_cycles += latency;
+      if (latency > wq->stats.max_latency_cycles)
+        wq->stats.max_latency_cycles = latency;
+      spinlock_release (&wq_lock);
+      intr_set_level (old_level);
+
+      /* WORK may be queued again or freed from here on. */
+      work->func (work->aux);
+
+      old_level = intr_disable ();
+      spinlock_acquire (&wq_lock);
+      worker->current = NULL;
+      wq->stats.run++;
+      waiters = wq->flush_waiters;
+      wq->flush_waiters = 0;
+      spinlock_release (&wq_lock);
+      intr_set_level (old_level);
+
+      /* Let flush and cancel waiters check again. */
+      for (; waiters > 0; waiters--)
+        sema_up (&wq->flushed);
+    }
+}
+
+/* Copies WQ's counters into *STATS. */
+void
+workqueue_get_stats (struct workqueue *wq, struct workqueue_stats *stats)
+{
+  enum intr_level old_level = intr_disable ();
+
+  spinlock_acquire (&wq_lock);
+  *stats = wq->stats;
+  spinlock_release (&wq_lock);
+  intr_set_level (old_level);
+}
+
+/* Prints the counters of every work queue that was used. */
+void
+workqueue_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_queues); e != list_end (&all_queues);
+       e = list_next (e))
+    {
+      struct workqueue *wq = list_entry (e, struct workqueue, elem);
+      struct workqueue_stats s;
+
+      workqueue_get_stats (wq, &s);
+      if (s.queued == 0)
+        continue;
+      printf ("Workqueue %s: %lld queued, %lld run, %lld cancelled, "
+              "depth %d (max %d), latency %llu cycles avg, %llu max\n",
+              wq->name, s.queued, s.run, s.cancelled, s.depth, s.max_depth,
+              (unsigned long long) (s.run > 0 ? s.latency_cycles / s.run : 0),
+              (unsigned long long) s.max_latency_cycles);
+    }
+}
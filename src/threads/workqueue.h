@@ -0,0 +1,108 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/synch.h"
+
+/* Work queues.
+
+   A work queue runs functions on behalf of other code in a pool
+   of kernel worker threads, so that work that nobody has to wait
+   for, such as writing back a dirty page or freeing a dead
+   process's memory, can be taken off the path of the thread that
+   caused it.
+
+   A work item is a struct work, usually embedded in the structure
+   it works on, that names a function and its argument.  Queueing
+   an item that is already queued does nothing, so an item runs at
+   most once per time it is queued, but it may queue itself again
+   from its function.  An item may also be queued to become ready
+   only after a number of timer ticks.
+
+   Items that are ready run in the order they became ready, but
+   with more than one worker they may run concurrently and finish
+   in any order.  Work functions run in a kernel thread and may
+   sleep.
+
+   workqueue_queue() and workqueue_queue_delayed() may be called
+   from interrupt handlers; the other functions may sleep. */
+
+struct workqueue;
+struct worker;
+typedef void work_func (void *aux);
+
+/* States of a work item. */
+enum work_state
+  {
+    WORK_IDLE,                  /* Not queued. */
+    WORK_DELAYED,               /* Waiting for its tick to come. */
+    WORK_PENDING                /* Ready, waiting for a worker. */
+  };
+
+/* A work item.  Initialize with work_init(); the members are
+   owned by workqueue.c.  An item is idle again as soon as a worker
+   takes it, so its function may queue it again or free it. */
+struct work
+  {
+    work_func *func;            /* Function to run. */
+    void *aux;                  /* Its argument. */
+    enum work_state state;
+    struct workqueue *wq;       /* Queue it was last queued on. */
+    struct list_elem elem;      /* Pending or delayed list element. */
+    int64_t due;                /* Tick a delayed item becomes ready. */
+    uint64_t ready_tsc;         /* When it became ready, for latency. */
+    uint64_t seq;               /* Order in which it became ready. */
+  };
+
+/* Counters of a work queue. */
+struct workqueue_stats
+  {
+    long long queued;           /* # of items queued. */
+    long long run;              /* # of items run. */
+    long long cancelled;        /* # of items cancelled before running. */
+    int depth;                  /* # of items ready now. */
+    int max_depth;              /* Most items ever ready at once. */
+    uint64_t latency_cycles;    /* Total TSC cycles from ready to running. */
+    uint64_t max_latency_cycles;  /* Longest of those. */
+  };
+
+/* A work queue. */
+struct workqueue
+  {
+    const char *name;
+    int worker_cnt;             /* # of worker threads. */
+    struct list pending;        /* Ready items, oldest first. */
+    struct semaphore ready;     /* Up'd once per item made ready. */
+    struct worker *workers;     /* WORKER_CNT workers. */
+    uint64_t next_seq;          /* Sequence number of next ready item. */
+    struct semaphore flushed;   /* Wakes up flush and cancel waiters. */
+    int flush_waiters;          /* # of threads waiting on FLUSHED. */
+    struct workqueue_stats stats;
+    struct list_elem elem;      /* Element in list of all queues. */
+  };
+
+/* Shared queue for work that doesn't need a queue of its own. */
+extern struct workqueue *system_wq;
+
+/* Number of workers of system_wq.  Controlled by kernel
+   command-line option "-wq-workers=N". */
+extern int system_wq_workers;
+
+void workqueue_init (void);
+struct workqueue *workqueue_create (const char *name, int worker_cnt,
+                                    int priority);
+
+void work_init (struct work *, work_func *, void *aux);
+bool workqueue_queue (struct workqueue *, struct work *);
+bool workqueue_queue_delayed (struct workqueue *, struct work *,
+                              int64_t ticks);
+bool workqueue_cancel (struct work *);
+void workqueue_flush (struct workqueue *);
+
+void workqueue_get_stats (struct workqueue *, struct workqueue_stats *);
+int64_t workqueue_next_event (int64_t limit);
+void workqueue_print_stats (void);
+
+#endif /* threads/workqueue.h */
@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "minunit.h"
+
+#include "../lib/kernel/pairing-heap.c"
+
+#define ELEM_CNT 1000
+
+struct elem
+{
+  int key;
+  int seq;                      /* Insertion order, for equal keys. */
+  bool in_heap;
+  struct pheap_elem node;
+};
+
+int tests_run = 0;
+
+void
+debug_panic (const char *file, int line, const char *function,
+             const char *message, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "%s:%d in %s(): ", file, line, function);
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+  fprintf (stderr, "\n");
+  abort ();
+}
+
+static bool
+elem_less (const struct pheap_elem *a, const struct pheap_elem *b, void *aux)
+{
+  (void) aux;
+  return pheap_entry (a, struct elem, node)->key
+         < pheap_entry (b, struct elem, node)->key;
+}
+
+/* Returns true if A must come out of the heap before B. */
+static bool
+elem_before (const struct elem *a, const struct elem *b)
+{
+  return a->key > b->key || (a->key == b->key && a->seq < b->seq);
+}
+
+/* Returns the number of elements in the subtree rooted at N, or -1
+   if a child comes out before its parent or a link is broken. */
+static int
+check_subtree (const struct pheap_elem *n)
+{
+  const struct pheap_elem *c, *prev = n;
+  int cnt = 1;
+
+  for (c = n->child; c != NULL; prev = c, c = c->next)
+    {
+      if (c->prev != prev
+          || elem_before (pheap_entry (c, struct elem, node),
+                          pheap_entry (n, struct elem, node)))
+        return -1;
+      int sub = check_subtree (c);
+      if (sub < 0)
+        return -1;
+      cnt += sub;
+    }
+  return cnt;
+}
+
+/* Checks HEAP's invariants against the elements in ELEMS that are
+   in it. */
+static bool
+check_heap (const struct pheap *heap, struct elem *elems, int cnt)
+{
+  int in_heap = 0;
+  for (int i = 0; i < cnt; i++)
+    in_heap += elems[i].in_heap;
+  if ((size_t) in_heap != pheap_size (heap))
+    return false;
+  if (heap->root == NULL)
+    return in_heap == 0;
+  if (heap->root->prev != NULL || heap->root->next != NULL)
+    return false;
+  return check_subtree (heap->root) == in_heap;
+}
+
+/* Pops every element of HEAP, checking that they come out in
+   order. */
+static bool
+drain (struct pheap *heap)
+{
+  struct elem *prev = NULL;
+
+  while (!pheap_empty (heap))
+    {
+      struct elem *e = pheap_entry (pheap_pop (heap), struct elem, node);
+      if (prev != NULL && elem_before (e, prev))
+        return false;
+      e->in_heap = false;
+      prev = e;
+    }
+  return pheap_top (heap) == NULL;
+}
+
+static char *
+test_pheap_sorted()
+{
+  static struct elem elems[ELEM_CNT];
+  struct pheap heap;
+
+  pheap_init (&heap, elem_less, NULL);
+  MU_ASSERT("init to empty", pheap_empty (&heap) && pheap_top (&heap) == NULL);
+
+  for (int i = 0; i < ELEM_CNT; i++)
+    {
+      elems[i] = (struct elem) { .key = i, .seq = i, .in_heap = true };
+      pheap_insert (&heap, &elems[i].node);
+    }
+  MU_ASSERT("ascending inserts", check_heap (&heap, elems, ELEM_CNT));
+
+  for (int i = ELEM_CNT - 1; i >= 0; i--)
+    {
+      struct elem *e = pheap_entry (pheap_pop (&heap), struct elem, node);
+      MU_ASSERT("max in order", e->key == i);
+      e->in_heap = false;
+      if (i % 97 == 0)
+        MU_ASSERT("pops", check_heap (&heap, elems, ELEM_CNT));
+    }
+  MU_ASSERT("empty again", pheap_empty (&heap) && pheap_top (&heap) == NULL);
+
+  return 0;
+}
+
+static char *
+test_pheap_random()
+{
+  static struct elem elems[ELEM_CNT];
+  struct pheap heap;
+  int seq = 0;
+
+  srand (42);
+  pheap_init (&heap, elem_less, NULL);
+  for (int i = 0; i < ELEM_CNT; i++)
+    elems[i].in_heap = false;
+
+  for (int round = 0; round < 20 * ELEM_CNT; round++)
+    {
+      struct elem *e = &elems[rand () % ELEM_CNT];
+      switch (rand () % 4)
+        {
+        case 0:
+          if (!pheap_empty (&heap))
+            {
+              struct elem *top = pheap_entry (pheap_top (&heap),
+                                              struct elem, node);
+              for (int i = 0; i < ELEM_CNT; i++)
+                MU_ASSERT("top is greatest",
+                          !elems[i].in_heap
+                          || !elem_before (&elems[i], top)
+                          || &elems[i] == top);
+              pheap_pop (&heap);
+              top->in_heap = false;
+            }
+          break;
+
+        case 1:
+          /* Re-keying, as priority donation does.  The element keeps
+             its place among equal keys. */
+          if (e->in_heap)
+            {
+              e->key = rand () % 64;
+              pheap_update (&heap, &e->node);
+            }
+          break;
+
+        default:
+          if (e->in_heap)
+            {
+              pheap_remove (&heap, &e->node);
+              e->in_heap = false;
+            }
+          else
+            {
+              /* Few distinct keys, to get many duplicates. */
+              e->key = rand () % 64;
+              e->seq = seq++;
+              e->in_heap = true;
+              pheap_insert (&heap, &e->node);
+            }
+          break;
+        }
+
+      if (round % 97 == 0)
+        MU_ASSERT("random operations", check_heap (&heap, elems, ELEM_CNT));
+    }
+  MU_ASSERT("final heap", check_heap (&heap, elems, ELEM_CNT));
+  MU_ASSERT("drains in order", drain (&heap));
+
+  return 0;
+}
+
+static char *
+pheap_tests()
+{
+  MU_RUN_TEST(test_pheap_sorted);
+  MU_RUN_TEST(test_pheap_random);
+  return 0;
+}
+
+int
+main()
+{
+  MU_RUN_TESTS(pheap_tests);
+}
@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include "minunit.h"
+
+#include "../lib/kernel/priority-bitmap.h"
+
+int tests_run = 0;
+
+static char *
+test_priority_bitmap()
+{
+  struct priority_bitmap b;
+
+  priority_bitmap_init(&b);
+  MU_ASSERT("init to empty", priority_bitmap_empty(&b));
+  MU_ASSERT("empty has no highest", priority_bitmap_highest(&b) == -1);
+
+  priority_bitmap_set(&b, 0);
+  MU_ASSERT("", !priority_bitmap_empty(&b));
+  MU_ASSERT("", priority_bitmap_highest(&b) == 0);
+
+  priority_bitmap_set(&b, 31);
+  MU_ASSERT("", priority_bitmap_highest(&b) == 31);
+
+  priority_bitmap_set(&b, 32);
+  MU_ASSERT("crosses word boundary", priority_bitmap_highest(&b) == 32);
+
+  priority_bitmap_set(&b, 63);
+  MU_ASSERT("", priority_bitmap_highest(&b) == 63);
+  MU_ASSERT("", priority_bitmap_test(&b, 63));
+  MU_ASSERT("", !priority_bitmap_test(&b, 62));
+
+  priority_bitmap_clear(&b, 63);
+  priority_bitmap_clear(&b, 32);
+  MU_ASSERT("", priority_bitmap_highest(&b) == 31);
+
+  priority_bitmap_clear(&b, 31);
+  priority_bitmap_clear(&b, 0);
+  MU_ASSERT("", priority_bitmap_empty(&b));
+
+  return 0;
+}
+
+static char *
+priority_bitmap_tests()
+{
+  MU_RUN_TEST(test_priority_bitmap);
+  return 0;
+}
+
+int 
+main()
+{
+  MU_RUN_TESTS(priority_bitmap_tests);
+}
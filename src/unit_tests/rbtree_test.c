@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "minunit.h"
+
+#include "../lib/kernel/rbtree.c"
+
+#define ELEM_CNT 1000
+
+struct elem
+{
+  int key;
+  int seq;                      /* Insertion order, for equal keys. */
+  bool in_tree;
+  struct rb_node node;
+};
+
+int tests_run = 0;
+
+void
+debug_panic (const char *file, int line, const char *function,
+             const char *message, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "%s:%d in %s(): ", file, line, function);
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+  fprintf (stderr, "\n");
+  abort ();
+}
+
+static bool
+elem_less (const struct rb_node *a, const struct rb_node *b, void *aux)
+{
+  (void) aux;
+  return rb_entry (a, struct elem, node)->key
+         < rb_entry (b, struct elem, node)->key;
+}
+
+/* Returns the black height of the subtree rooted at N, or -1 if
+   it breaks a red-black rule or its parent links. */
+static int
+check_subtree (const struct rb_node *n)
+{
+  if (n == NULL)
+    return 1;
+  if (n->red && (is_red (n->left) || is_red (n->right)))
+    return -1;
+  if ((n->left != NULL && n->left->parent != n)
+      || (n->right != NULL && n->right->parent != n))
+    return -1;
+
+  int left = check_subtree (n->left);
+  int right = check_subtree (n->right);
+  if (left < 0 || left != right)
+    return -1;
+  return left + !n->red;
+}
+
+/* Checks TREE's invariants and that an in-order walk visits the
+   elements in ELEMS that are in the tree, in order, equal keys by
+   insertion order. */
+static bool
+check_tree (const struct rb_tree *tree, struct elem *elems, int cnt)
+{
+  if (is_red (tree->root) || check_subtree (tree->root) < 0)
+    return false;
+
+  int in_tree = 0;
+  for (int i = 0; i < cnt; i++)
+    in_tree += elems[i].in_tree;
+  if ((size_t) in_tree != rb_size (tree))
+    return false;
+
+  const struct elem *prev = NULL;
+  int walked = 0;
+  for (struct rb_node *n = rb_min (tree); n != NULL; n = rb_next (n))
+    {
+      const struct elem *e = rb_entry (n, struct elem, node);
+      if (!e->in_tree)
+        return false;
+      if (prev != NULL
+          && (prev->key > e->key
+              || (prev->key == e->key && prev->seq > e->seq)))
+        return false;
+      prev = e;
+      walked++;
+    }
+  return walked == in_tree;
+}
+
+static char *
+test_rbtree_sorted()
+{
+  static struct elem elems[ELEM_CNT];
+  struct rb_tree tree;
+
+  rb_init (&tree, elem_less, NULL);
+  MU_ASSERT("init to empty", rb_empty (&tree) && rb_min (&tree) == NULL);
+
+  /* Ascending keys make an unbalanced tree without rebalancing. */
+  for (int i = 0; i < ELEM_CNT; i++)
+    {
+      elems[i] = (struct elem) { .key = i, .seq = i, .in_tree = true };
+      rb_insert (&tree, &elems[i].node);
+    }
+  MU_ASSERT("ascending inserts", check_tree (&tree, elems, ELEM_CNT));
+
+  /* Popping the minimum over and over, as a scheduler does. */
+  for (int i = 0; i < ELEM_CNT; i++)
+    {
+      struct elem *e = rb_entry (rb_min (&tree), struct elem, node);
+      MU_ASSERT("min in order", e->key == i);
+      rb_remove (&tree, &e->node);
+      e->in_tree = false;
+    }
+  MU_ASSERT("empty again", rb_empty (&tree) && rb_min (&tree) == NULL);
+
+  return 0;
+}
+
+static char *
+test_rbtree_random()
+{
+  static struct elem elems[ELEM_CNT];
+  struct rb_tree tree;
+  int seq = 0;
+
+  srand (42);
+  rb_init (&tree, elem_less, NULL);
+  for (int i = 0; i < ELEM_CNT; i++)
+    elems[i].in_tree = false;
+
+  for (int round = 0; round < 20 * ELEM_CNT; round++)
+    {
+      struct elem *e = &elems[rand () % ELEM_CNT];
+      if (e->in_tree)
+        {
+          rb_remove (&tree, &e->node);
+          e->in_tree = false;
+        }
+      else
+        {
+          /* Few distinct keys, to get many duplicates. */
+          e->key = rand () % 64;
+          e->seq = seq++;
+          e->in_tree = true;
+          rb_insert (&tree, &e->node);
+        }
+
+      if (round % 97 == 0)
+        MU_ASSERT("random inserts and removes",
+                  check_tree (&tree, elems, ELEM_CNT));
+    }
+  MU_ASSERT("final tree", check_tree (&tree, elems, ELEM_CNT));
+
+  return 0;
+}
+
+static char *
+rbtree_tests()
+{
+  MU_RUN_TEST(test_rbtree_sorted);
+  MU_RUN_TEST(test_rbtree_random);
+  return 0;
+}
+
+int
+main()
+{
+  MU_RUN_TESTS(rbtree_tests);
+}
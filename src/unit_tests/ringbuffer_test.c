@@ -51,10 +51,43 @@ test_ringbuffer()
   return 0;
 }
 
+static char *
+test_ringbuffer_peek()
+{
+  struct ringbuffer_int buf;
+
+  RINGBUFFER_INIT(buf, BUFFER_SIZE);
+  MU_ASSERT("empty count", RINGBUFFER_COUNT(buf) == 0);
+
+  RINGBUFFER_PUSH(buf, 1);
+  RINGBUFFER_PUSH(buf, 2);
+  MU_ASSERT("count", RINGBUFFER_COUNT(buf) == 2);
+  MU_ASSERT("oldest first", RINGBUFFER_AT(buf, 0) == 1);
+  MU_ASSERT("", RINGBUFFER_AT(buf, 1) == 2);
+
+  /* Wrap around the end of the array. */
+  RINGBUFFER_PUSH(buf, 3);
+  RINGBUFFER_PUSH(buf, 4);
+  RINGBUFFER_PUSH(buf, 5);
+  MU_ASSERT("full count", RINGBUFFER_COUNT(buf) == BUFFER_SIZE);
+  MU_ASSERT("wrapped", RINGBUFFER_AT(buf, 0) == 3);
+  MU_ASSERT("", RINGBUFFER_AT(buf, 1) == 4);
+  MU_ASSERT("", RINGBUFFER_AT(buf, 2) == 5);
+
+  bool popped;
+  RINGBUFFER_POP(int, buf, popped);
+  MU_ASSERT("", popped);
+  MU_ASSERT("count after pop", RINGBUFFER_COUNT(buf) == 2);
+  MU_ASSERT("", RINGBUFFER_AT(buf, 0) == 4);
+
+  return 0;
+}
+
 static char *
 ringbuffer_tests()
 {
   MU_RUN_TEST(test_ringbuffer);
+  MU_RUN_TEST(test_ringbuffer_peek);
   return 0;
 }
 
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "minunit.h"
+
+/* glibc's <string.h> declares these arguments nonnull. */
+#pragma GCC diagnostic ignored "-Wnonnull-compare"
+#include "../lib/string.c"
+
+#define BUF_SIZE 512
+#define MAX_LEN 200
+
+int tests_run = 0;
+
+void
+debug_panic (const char *file, int line, const char *function,
+             const char *message, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "%s:%d in %s(): ", file, line, function);
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+  fprintf (stderr, "\n");
+  abort ();
+}
+
+/* Fills BUF with a pattern that depends on SEED. */
+static void
+fill (unsigned char *buf, size_t size, int seed)
+{
+  for (size_t i = 0; i < size; i++)
+    buf[i] = (unsigned char) (i * 7 + seed * 13 + 1);
+}
+
+/* Returns true if SIZE bytes at A and B are equal, comparing a
+   byte at a time. */
+static bool
+same (const unsigned char *a, const unsigned char *b, size_t size)
+{
+  for (size_t i = 0; i < size; i++)
+    if (a[i] != b[i])
+      return false;
+  return true;
+}
+
+static char *
+test_memcpy (void)
+{
+  static unsigned char src[BUF_SIZE], dst[BUF_SIZE], want[BUF_SIZE];
+
+  for (size_t src_ofs = 0; src_ofs < 8; src_ofs++)
+    for (size_t dst_ofs = 0; dst_ofs < 8; dst_ofs++)
+      for (size_t size = 0; size <= MAX_LEN; size++)
+        {
+          fill (src, BUF_SIZE, 1);
+          fill (dst, BUF_SIZE, 2);
+          fill (want, BUF_SIZE, 2);
+          for (size_t i = 0; i < size; i++)
+            want[dst_ofs + i] = src[src_ofs + i];
+
+          MU_ASSERT("memcpy returns dst",
+                    memcpy (dst + dst_ofs, src + src_ofs, size)
+                    == dst + dst_ofs);
+          MU_ASSERT("memcpy copies exactly size bytes",
+                    same (dst, want, BUF_SIZE));
+        }
+  return 0;
+}
+
+static char *
+test_memmove (void)
+{
+  static unsigned char buf[BUF_SIZE], want[BUF_SIZE];
+
+  for (size_t src_ofs = 0; src_ofs < 40; src_ofs++)
+    for (size_t dst_ofs = 0; dst_ofs < 40; dst_ofs++)
+      for (size_t size = 0; size <= MAX_LEN; size += 3)
+        {
+          fill (buf, BUF_SIZE, 3);
+          fill (want, BUF_SIZE, 3);
+          for (size_t i = 0; i < size; i++)
+            want[dst_ofs + i] = buf[src_ofs + i];
+
+          MU_ASSERT("memmove returns dst",
+                    memmove (buf + dst_ofs, buf + src_ofs, size)
+                    == buf + dst_ofs);
+          MU_ASSERT("memmove handles overlap in both directions",
+                    same (buf, want, BUF_SIZE));
+        }
+  return 0;
+}
+
+static char *
+test_memset (void)
+{
+  static unsigned char buf[BUF_SIZE], want[BUF_SIZE];
+
+  for (size_t ofs = 0; ofs < 8; ofs++)
+    for (size_t size = 0; size <= MAX_LEN; size++)
+      {
+        int value = 0x100 + (int) size;
+
+        fill (buf, BUF_SIZE, 4);
+        fill (want, BUF_SIZE, 4);
+        for (size_t i = 0; i < size; i++)
+          want[ofs + i] = (unsigned char) value;
+
+        MU_ASSERT("memset returns dst",
+                  memset (buf + ofs, value, size) == buf + ofs);
+        MU_ASSERT("memset sets exactly size bytes",
+                  same (buf, want, BUF_SIZE));
+      }
+  return 0;
+}
+
+static char *
+test_strlen_strchr (void)
+{
+  static char buf[BUF_SIZE];
+
+  for (size_t ofs = 0; ofs < 8; ofs++)
+    for (size_t len = 0; len <= MAX_LEN; len++)
+      {
+        char *s = buf + ofs;
+
+        for (size_t i = 0; i < BUF_SIZE; i++)
+          buf[i] = 'a' + i % 7;
+        s[len] = '\0';
+        if (len > 0)
+          s[len - 1] = 'z';
+
+        MU_ASSERT("strlen", strlen (s) == len);
+        MU_ASSERT("strchr finds the terminator", strchr (s, '\0') == s + len);
+        MU_ASSERT("strchr finds the last character",
+                  strchr (s, 'z') == (len > 0 ? s + len - 1 : NULL));
+        MU_ASSERT("strchr stops at the terminator", strchr (s, 'y') == NULL);
+        MU_ASSERT("strchr with high characters",
+                  strchr (s, 0x100 + 'z') == strchr (s, 'z'));
+      }
+  return 0;
+}
+
+static char *
+test_memchr (void)
+{
+  static unsigned char buf[BUF_SIZE];
+
+  for (size_t ofs = 0; ofs < 8; ofs++)
+    for (size_t size = 0; size <= MAX_LEN; size++)
+      for (size_t at = 0; at <= size; at += 5)
+        {
+          unsigned char *block = buf + ofs;
+
+          memset (buf, 0x80, BUF_SIZE);
+          block[at] = 0x7f;
+          MU_ASSERT("memchr",
+                    memchr (block, 0x7f, size) == (at < size ? block + at
+                                                   : NULL));
+          MU_ASSERT("memchr of a byte not there",
+                    memchr (block, 0x00, size) == NULL);
+        }
+  return 0;
+}
+
+static char *
+all_tests (void)
+{
+  MU_RUN_TEST(test_memcpy);
+  MU_RUN_TEST(test_memmove);
+  MU_RUN_TEST(test_memset);
+  MU_RUN_TEST(test_strlen_strchr);
+  MU_RUN_TEST(test_memchr);
+  return 0;
+}
+
+int
+main (void)
+{
+  MU_RUN_TESTS(all_tests);
+}
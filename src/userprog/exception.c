@@ -4,6 +4,7 @@
 
 #include "userprog/exception.h"
 #include "userprog/gdt.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "process.h"
@@ -50,8 +51,9 @@ void exception_init(void)
   intr_register_int(0, 0, INTR_ON, kill, "#DE Divide Error");
   intr_register_int(1, 0, INTR_ON, kill, "#DB Debug Exception");
   intr_register_int(6, 0, INTR_ON, kill, "#UD Invalid Opcode Exception");
-  intr_register_int(7, 0, INTR_ON, kill,
-                    "#NM Device Not Available Exception");
+  if (!fpu_available())
+    intr_register_int(7, 0, INTR_ON, kill,
+                      "#NM Device Not Available Exception");
   intr_register_int(11, 0, INTR_ON, kill, "#NP Segment Not Present");
   intr_register_int(12, 0, INTR_ON, kill, "#SS Stack Fault Exception");
   intr_register_int(13, 0, INTR_ON, kill, "#GP General Protection Exception");
@@ -90,11 +92,10 @@ kill(struct intr_frame *f)
   case SEL_UCSEG:
     /* User's code segment, so it's a user exception, as we
          expected.  Kill the user process.  */
-    process_add_exit_code(find_current_thread_process(), BAD_EXIT_CODE);
     printf("%s: dying due to interrupt %#04x (%s).\n",
            thread_name(), f->vec_no, intr_name(f->vec_no));
     intr_dump_frame(f);
-    thread_exit();
+    exit_curr_process(BAD_EXIT_CODE, false);
 
   case SEL_KCSEG:
     /* Kernel's code segment, which indicates a kernel bug.
@@ -115,13 +116,7 @@ kill(struct intr_frame *f)
 
 static bool activate_stack_frame(void* fault_addr) {
   void* page_adr = prt_to_page(fault_addr);
-  struct vm_node* node = find_vm_node(find_current_thread_process(), page_adr);
-
-  if (node != NULL && activate_vm_page(node) != NULL) {
-    return true; // page activated
-  }
-
-  return false;
+  return activate_vm_address(find_current_thread_process(), page_adr) != NULL;
 }
 
 #define STACK_LEEWAY (50)
@@ -182,6 +177,7 @@ page_fault(struct intr_frame *f)
 
   /* Count page faults. */
   page_fault_cnt++;
+  thread_current()->usage.page_faults++;
 
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
@@ -206,8 +202,7 @@ page_fault(struct intr_frame *f)
     } else if (!user) {
 
       if (write) {
-        void* stack_ptr = collect_process_user_stack_ptr(find_current_thread_process());
-        if (try_grow_stack(stack_ptr, fault_addr)) {
+        if (try_grow_stack(thread_current()->user_esp, fault_addr)) {
           return;
         }
       }
@@ -0,0 +1,153 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <debug.h>
+#include <stdbool.h>
+#include <kernel/list.h>
+#include <kernel/hash.h>
+
+#include "futex.h"
+#include "vm.h"
+#include "process.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+
+#define FUTEX_BUCKET_CNT 64
+
+// a thread blocked in futex_wait(), lives on its stack
+struct futex_waiter {
+  struct list_elem elem;
+  const void* key; // kernel address of the futex word
+  struct process_node* process;
+  struct semaphore sema;
+};
+
+// waiters hashed by key. The lock also makes futex_wait()'s compare and
+// enqueue atomic with respect to futex_wake().
+static struct futex_table {
+  struct list buckets[FUTEX_BUCKET_CNT];
+  struct lock monitor;
+} futex_table;
+
+void futex_init (void) {
+  for (size_t i = 0; i < FUTEX_BUCKET_CNT; i++) {
+    list_init (&futex_table.buckets[i]);
+  }
+  lock_init (&futex_table.monitor);
+}
+
+static struct list* key_bucket (const void* key) {
+  return &futex_table.buckets[hash_int ((uintptr_t) key) % FUTEX_BUCKET_CNT];
+}
+
+/**
+ * Returns the kernel address of the futex word at UADDR, which is where its frame is
+ * mapped in kernel space, so the same for every process that maps that frame.
+ * Kills the process if UADDR isn't readable, returns NULL if it's misaligned.
+ */
+static uint32_t* futex_key (uint32_t* uaddr) {
+  if ((uintptr_t) uaddr % sizeof (uint32_t) != 0) {
+    return NULL;
+  }
+
+  for (;;) {
+    // faults the page in if it isn't loaded yet
+    bool success;
+    get_userland_double_word (uaddr, &success);
+    if (!success) {
+      exit_curr_process (BAD_EXIT_CODE, true);
+      NOT_REACHED ();
+    }
+
+    // the page can be evicted again, or unmapped by another thread, before we get
+    // here, then fault it back in
+    uint32_t* key = pagedir_get_page (thread_current ()->pagedir, uaddr);
+    if (key != NULL) {
+      return key;
+    }
+  }
+}
+
+/**
+ * Blocks until woken by futex_wake() on the same word, unless *UADDR != EXPECTED.
+ * Returns 0 if woken, FUTEX_ERROR if the value didn't match or UADDR is misaligned.
+ */
+int futex_wait (uint32_t* uaddr, uint32_t expected) {
+  uint32_t* key = futex_key (uaddr);
+  if (key == NULL) {
+    return FUTEX_ERROR;
+  }
+
+  struct futex_waiter waiter;
+  waiter.key = key;
+  waiter.process = find_current_thread_process ();
+  sema_init (&waiter.sema, 0);
+
+  // the process exiting after this check wakes us with futex_wake_process()
+  lock_acquire (&futex_table.monitor);
+  if (*(volatile uint32_t*) key != expected || process_is_exiting (waiter.process)) {
+    lock_release (&futex_table.monitor);
+    return FUTEX_ERROR;
+  }
+  list_push_back (key_bucket (key), &waiter.elem);
+  lock_release (&futex_table.monitor);
+
+  // a wake that comes before this just leaves the semaphore at 1
+  sema_down (&waiter.sema);
+  return 0;
+}
+
+/**
+ * Wakes up to CNT threads waiting on the word at UADDR, in the order they started
+ * waiting. Returns the number woken, or FUTEX_ERROR if UADDR is misaligned.
+ */
+int futex_wake (uint32_t* uaddr, int cnt) {
+  uint32_t* key = futex_key (uaddr);
+  if (key == NULL) {
+    return FUTEX_ERROR;
+  }
+
+  struct list* bucket = key_bucket (key);
+  int woken = 0;
+
+  lock_acquire (&futex_table.monitor);
+  for (struct list_elem* e = list_begin (bucket); e != list_end (bucket) && woken < cnt; ) {
+    struct futex_waiter* waiter = list_entry (e, struct futex_waiter, elem);
+    if (waiter->key != key) {
+      e = list_next (e);
+      continue;
+    }
+
+    e = list_remove (e);
+    sema_up (&waiter->sema);
+    woken++;
+  }
+  lock_release (&futex_table.monitor);
+
+  return woken;
+}
+
+/**
+ * Wakes every thread of PROCESS waiting on any futex, which must be exiting, so that its
+ * threads can leave.
+ */
+void futex_wake_process (struct process_node* process) {
+  ASSERT (process_is_exiting (process));
+
+  lock_acquire (&futex_table.monitor);
+  for (size_t i = 0; i < FUTEX_BUCKET_CNT; i++) {
+    struct list* bucket = &futex_table.buckets[i];
+    for (struct list_elem* e = list_begin (bucket); e != list_end (bucket); ) {
+      struct futex_waiter* waiter = list_entry (e, struct futex_waiter, elem);
+      if (waiter->process != process) {
+        e = list_next (e);
+        continue;
+      }
+
+      e = list_remove (e);
+      sema_up (&waiter->sema);
+    }
+  }
+  lock_release (&futex_table.monitor);
+}
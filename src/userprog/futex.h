@@ -0,0 +1,21 @@
+#ifndef __USERPROG_FUTEX_H_
+#define __USERPROG_FUTEX_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Wait queues for user-space synchronization.  A futex is any
+   aligned 32-bit word of user memory; threads wait on it by the
+   address of the frame that holds it, so processes sharing a
+   SHARED_WRITABLE_FILE mapping share its futexes too. */
+
+#define FUTEX_ERROR -1
+
+struct process_node;
+
+void futex_init (void);
+int futex_wait (uint32_t* uaddr, uint32_t expected);
+int futex_wake (uint32_t* uaddr, int cnt);
+void futex_wake_process (struct process_node* process);
+
+#endif
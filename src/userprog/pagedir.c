@@ -2,9 +2,12 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
@@ -227,7 +230,10 @@ pagedir_activate (uint32_t *pd)
      new page tables immediately.  See [IA32-v2a] "MOV--Move
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base
      Address of the Page Directory". */
+  enum intr_level old_level = intr_disable ();
+  cpu_current ()->pagedir = pd;
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (pd)) : "memory");
+  intr_set_level (old_level);
 }
 
 /* Returns the currently active page directory. */
@@ -250,7 +256,8 @@ active_pd (void)
 
    This function invalidates the TLB if PD is the active page
    directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
+   the TLB, so there is no need to invalidate anything.)  Other
+   CPUs that have PD active are asked to do the same. */
 static void
 invalidate_pagedir (uint32_t *pd) 
 {
@@ -260,6 +267,7 @@ invalidate_pagedir (uint32_t *pd)
          "Translation Lookaside Buffers (TLBs)". */
       pagedir_activate (pd);
     } 
+  smp_tlb_shootdown (pd);
 }
 
 bool is_ptr_page_mapped(uint32_t* pagedir, void* ptr) {
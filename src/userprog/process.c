@@ -30,6 +30,8 @@
 #define MAX_ARGS 30
 
 static thread_func start_process NO_RETURN;
+static thread_func start_thread NO_RETURN;
+static void enter_user_mode(struct intr_frame *if_) NO_RETURN;
 
 struct start_process_arg
 {
@@ -45,9 +47,33 @@ struct start_process_arg
 
 static struct file *load(struct start_process_arg *start_process_arg, void (**eip)(void), void **esp);
 
+/* Switches the running thread into user mode with the registers
+   in IF_, by simulating a return from an interrupt, implemented by
+   intr_exit (in threads/intr-stubs.S).  Because intr_exit takes all
+   of its arguments on the stack in the form of a `struct
+   intr_frame', we just point the stack pointer (%esp) to IF_ and
+   jump to it.
+
+   The thread's user time starts here, not when its process was
+   loaded: everything up to now is charged to the kernel.  Turning
+   interrupts off first keeps a preemption from landing between
+   starting the user clock and the iret, which turns them back on
+   from IF_->eflags. */
+static void
+enter_user_mode(struct intr_frame *if_)
+{
+  intr_disable();
+  thread_usage_kernel_exit();
+  asm volatile("movl %0, %%esp; jmp intr_exit"
+               :
+               : "g"(if_)
+               : "memory");
+  NOT_REACHED();
+}
+
 static void parse_executable_command(struct start_process_arg *process_args, const char *command)
 {
-  process_args->parent_tid = current_thread_tid();
+  process_args->parent_tid = current_process_pid();
   process_args->child_failed = false;
   strlcpy(process_args->command, command, MAX_PROCESS_ARGS_SIZE);
   sema_init(&process_args->created_sema, 0);
@@ -136,19 +162,96 @@ start_process(void *arg)
   start_process_arg->child_failed = false;
   sema_up(&start_process_arg->created_sema);
 
-  /* Start the user process by simulating a return from an
-     interrupt, implemented by intr_exit (in
-     threads/intr-stubs.S).  Because intr_exit takes all of its
-     arguments on the stack in the form of a `struct intr_frame',
-     we just point the stack pointer (%esp) to our stack frame
-     and jump to it. */
-  asm volatile("movl %0, %%esp; jmp intr_exit"
-               :
-               : "g"(&if_)
-               : "memory");
+  enter_user_mode(&if_);
   NOT_REACHED();
 }
 
+struct start_thread_arg
+{
+  struct process_node *process;
+  uint32_t *pagedir;
+  int stack_slot;
+  void *start;
+  void *func;
+  void *aux;
+
+  // synch
+  struct semaphore started_sema;
+  bool failed;
+};
+
+/* Starts a new thread in the current process, running START
+   (FUNC, AUX) in user mode on a stack of its own.  START is the
+   user library's wrapper that exits the thread when FUNC
+   returns.  Returns the new thread's id, or TID_ERROR if it
+   cannot be created. */
+tid_t process_thread_create(void *start, void *func, void *aux)
+{
+  struct start_thread_arg arg;
+  arg.process = find_current_thread_process();
+  arg.pagedir = thread_current()->pagedir;
+  arg.start = start;
+  arg.func = func;
+  arg.aux = aux;
+  arg.failed = false;
+  sema_init(&arg.started_sema, 0);
+
+  arg.stack_slot = reserve_process_thread_stack(arg.process);
+  if (arg.stack_slot < 0)
+    return TID_ERROR;
+
+  /* ARG lives on our stack, so wait for the thread to be done
+     with it. */
+  tid_t tid = thread_create(thread_name(), PRI_DEFAULT, start_thread, &arg);
+  if (tid == TID_ERROR)
+  {
+    release_process_thread_stack(arg.process, arg.stack_slot);
+    return TID_ERROR;
+  }
+
+  sema_down(&arg.started_sema);
+  return arg.failed ? TID_ERROR : tid;
+}
+
+static bool setup_thread_stack(struct process_node *process, int slot, void **esp, void *func, void *aux);
+
+/* A thread function that joins the process of the thread that
+   created it and starts running user code. */
+static void
+start_thread(void *arg_)
+{
+  struct start_thread_arg *arg = arg_;
+  struct thread *t = thread_current();
+  struct intr_frame if_;
+
+  memset(&if_, 0, sizeof if_);
+  if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+  if_.cs = SEL_UCSEG;
+  if_.eflags = FLAG_IF | FLAG_MBS;
+  if_.eip = (void (*)(void))arg->start;
+
+  /* The creating thread is blocked on ARG until we're done, so
+     the process can't be torn down under us until then. */
+  t->pagedir = arg->pagedir;
+  process_activate();
+
+  if (!setup_thread_stack(arg->process, arg->stack_slot, &if_.esp, arg->func, arg->aux) || !add_process_thread(arg->process, t->tid, arg->stack_slot))
+  {
+    t->pagedir = NULL;
+    pagedir_activate(NULL);
+    release_process_thread_stack(arg->process, arg->stack_slot);
+    arg->failed = true;
+    sema_up(&arg->started_sema);
+    thread_exit();
+  }
+
+  t->process = arg->process;
+  t->user_esp = if_.esp;
+  sema_up(&arg->started_sema);
+
+  enter_user_mode(&if_);
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -389,6 +492,37 @@ setup_stack(struct process_node *process, void **esp, char *args[], size_t num_a
   return true;
 }
 
+/* Sets up the stack of a thread started by thread_create() in
+   stack slot SLOT, with a call frame for START (FUNC, AUX).  The
+   slot may have been used by a thread that was joined already,
+   in which case its pages are reused. */
+static bool
+setup_thread_stack(struct process_node *process, int slot, void **esp, void *func, void *aux)
+{
+  uint8_t *stack_top = user_thread_stack_top(slot);
+
+  struct vm_node *vm_node = add_stack_freestanding_vm(process, stack_top - PGSIZE);
+  if (vm_node == NULL)
+  {
+    return false;
+  }
+
+  uint8_t *kpage = (uint8_t *)activate_vm_page(vm_node);
+  if (kpage == NULL)
+  {
+    return false;
+  }
+
+  /* Null return address, then the arguments. */
+  uint32_t *frame = (uint32_t *)(kpage + PGSIZE) - 3;
+  frame[0] = 0;
+  frame[1] = (uint32_t)func;
+  frame[2] = (uint32_t)aux;
+  *esp = stack_top - 3 * sizeof(uint32_t);
+
+  return true;
+}
+
 /* Loads an ELF executable from FILE_NAME into the current thread.
    Stores the executable's entry point into *EIP
    and its initial stack pointer into *ESP.
@@ -429,6 +563,7 @@ static struct file *load(struct start_process_arg *start_process_arg, void (**ei
   {
     goto done;
   }
+  t->process = process_node;
 
   /* Read and verify executable header. */
   if (file_read(file, &ehdr, sizeof ehdr) != sizeof ehdr || memcmp(ehdr.e_ident, "\177ELF\1\1\1", 7) || ehdr.e_type != 2 || ehdr.e_machine != 3 || ehdr.e_version != 1 || ehdr.e_phentsize != sizeof(struct Elf32_Phdr) || ehdr.e_phnum > 1024)
@@ -514,6 +649,7 @@ done:
     lock_release(&filesys_monitor);
     if (process_node != NULL)
     {
+      t->process = NULL;
       process_add_exit_code(process_node, BAD_EXIT_CODE);
       ASSERT(collect_process_exit_code(process_node) == BAD_EXIT_CODE);
     }
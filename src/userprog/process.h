@@ -3,9 +3,11 @@
 
 #include "threads/thread.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 #include "filesys/file.h"
 
 tid_t process_execute (const char *file_name);
+tid_t process_thread_create (void *start, void *func, void *aux);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
@@ -20,13 +22,31 @@ typedef tid_t pid_t;
 #define MMAP_ERROR -1
 #define MAX_PROCESS_ARGS_SIZE 256
 
+// user stacks: the initial thread's grows down from PHYS_BASE, the stacks of threads
+// started by thread_create() sit in fixed slots below it
+#define USER_STACK_MAX (8 * 1024 * 1024)
+#define USER_THREAD_STACK_SIZE (1024 * 1024)
+#define USER_THREAD_MAX 32
+
+static inline void* user_thread_stack_top (int slot) {
+  return (uint8_t*) PHYS_BASE - USER_STACK_MAX - slot * USER_THREAD_STACK_SIZE;
+}
+
 extern struct lock filesys_monitor;
 
 struct process_node;
 
 void process_impl_init (void);
 void process_add_exit_code (struct process_node* process, int exit_code);
-void exit_curr_process(int exit_code, bool should_print_exit_code);
+void exit_curr_process(int exit_code, bool should_print_exit_code) NO_RETURN;
+void exit_curr_thread(void) NO_RETURN;
+void process_exit_if_exiting(void);
+bool process_is_exiting(struct process_node* process);
+void process_get_usage(struct process_node* process, struct thread_usage* usage);
+int reserve_process_thread_stack(struct process_node* process);
+void release_process_thread_stack(struct process_node* process, int slot);
+bool add_process_thread(struct process_node* process, tid_t tid, int slot);
+int join_process_thread(struct process_node* process, tid_t tid);
 int add_process_open_file (struct process_node* process, const char* file_path);
 bool process_close_file (struct process_node* process, int fd);
 struct file* get_process_open_file (struct process_node* process, int fd);
@@ -35,5 +55,6 @@ struct file* get_process_open_file (struct process_node* process, int fd);
 
 
 struct process_node* find_current_thread_process (void);
+pid_t current_process_pid (void);
 
 #endif /* userprog/process.h */
@@ -6,6 +6,7 @@
 
 #include "process.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #include "threads/interrupt.h"
 #include "filesys/file.h"
@@ -21,6 +22,7 @@
 #include "vm/strings_pool.h"
 #include "userprog/vm.h"
 #include "filesys/inode.h"
+#include "userprog/futex.h"
 
 struct lock filesys_monitor;
 
@@ -45,16 +47,34 @@ struct process_node {
 
   // supplemental VM table
   struct hash vm_table;
-  void* syscall_stack_ptr;
 
   // file mmap
   int mapid_counter;
   struct list file_mmaps;
+
+  // threads
+  int thread_cnt; // threads running in the process, including the initial one
+  bool exiting; // exit() was called, the other threads must leave
+  bool print_exit_code;
+  struct list threads; // threads started by thread_create() and not joined yet
+  struct condition cond_thread_exited;
+  uint32_t thread_stacks; // bitmap of the stack slots in use
+  struct thread_usage exited_usage; // CPU time and counters of the threads that left
 };
 
+// a thread started by thread_create()
+struct process_thread_node {
+  struct list_elem elem;
+  tid_t tid;
+  int stack_slot;
+  bool exited;
+  bool joining;
+};
+
+// looked up on every wait() and exec(), changed only when a process starts or is reaped
 static struct processes {
   struct hash processes;
-  struct lock lock;
+  struct rwlock lock;
 } processes;
 
 static unsigned int processes_hash_func (const struct hash_elem *e, void *_ UNUSED) {
@@ -73,7 +93,7 @@ void
 process_impl_init () {
   const bool ok = hash_init (&processes.processes, processes_hash_func, processes_hash_less_func, NULL);
   ASSERT (ok);
-  lock_init (&processes.lock);
+  rwlock_init (&processes.lock);
   lock_init (&filesys_monitor);
 }
 
@@ -89,15 +109,20 @@ static struct process_node* find_process_internal (pid_t pid) {
 }
 
 struct process_node* find_process (pid_t pid) {
-  lock_acquire (&processes.lock);
+  rwlock_acquire_read (&processes.lock);
   struct process_node* node = find_process_internal (pid);
-  lock_release (&processes.lock);
+  rwlock_release_read (&processes.lock);
   return node;
 }
 
 struct process_node* find_current_thread_process () {
-  pid_t process_id = current_thread_tid ();
-  return find_process(process_id);
+  return thread_current ()->process;
+}
+
+// children belong to the process, not to the thread that started them
+pid_t current_process_pid () {
+  struct process_node* process = find_current_thread_process ();
+  return process != NULL ? process->pid : current_thread_tid ();
 }
 
 
@@ -110,11 +135,12 @@ static void remove_process (struct process_node* node) {
 
 static unsigned int vm_table_hash (const struct hash_elem *e, void *_ UNUSED);
 static bool vm_table_less (const struct hash_elem *l, const struct hash_elem *r, void *_ UNUSED);
+static struct vm_node* find_vm_node_internal(struct process_node* process, void* address);
  
 struct process_node* add_process (pid_t parent_tid, pid_t tid, uint32_t* pagedir, const char* name, struct file* exec_file) {
   ASSERT (! intr_context());
 
-  lock_acquire (& processes.lock);
+  rwlock_acquire_write (&processes.lock);
 
   if (find_process_internal (tid) != NULL) {
     PANIC("Process already exists");
@@ -122,7 +148,7 @@ struct process_node* add_process (pid_t parent_tid, pid_t tid, uint32_t* pagedir
 
   struct process_node* node = malloc (sizeof (struct process_node));
   if (node == NULL) {
-    lock_release (& processes.lock);
+    rwlock_release_write (&processes.lock);
     return NULL;
   }
 
@@ -136,19 +162,25 @@ struct process_node* add_process (pid_t parent_tid, pid_t tid, uint32_t* pagedir
   list_init (&node->open_files);
   node->fd_counter = 2;
   node->exec_file = exec_file;
-  node->syscall_stack_ptr = NULL;
   list_init(&node->file_mmaps);
   node->mapid_counter = 0;
+  node->thread_cnt = 1;
+  node->exiting = false;
+  node->print_exit_code = false;
+  list_init(&node->threads);
+  cond_init(&node->cond_thread_exited);
+  node->thread_stacks = 0;
+  memset (&node->exited_usage, 0, sizeof node->exited_usage);
   lock_init(&node->lock);
   if (! hash_init(&node->vm_table, vm_table_hash, vm_table_less, NULL)) {
     free (node);
-    lock_release (& processes.lock);
+    rwlock_release_write (&processes.lock);
     return NULL;
   }
 
   ASSERT (hash_insert (& processes.processes, &node->elem) == NULL);
 
-  lock_release (& processes.lock);
+  rwlock_release_write (&processes.lock);
 
   return node;
 }
@@ -276,6 +308,7 @@ struct file* get_process_open_file (struct process_node* node, int fd) {
 
 static void destroy_vm_page_table(struct process_node* process);
 void destroy_mmaps(struct process_node* process);
+static void destroy_process_threads(struct process_node* process);
 
 /**
  * Supposed to be called immediately before process exit.
@@ -295,6 +328,7 @@ void process_add_exit_code (struct process_node* node, int exit_code) {
   destroy_mmaps(node);
   close_open_files (node);
   destroy_vm_page_table (node);
+  destroy_process_threads (node);
 
   node->exited = true;
   node->exit_code = exit_code;
@@ -318,7 +352,7 @@ int collect_process_exit_code (struct process_node* node) {
 
   lock_acquire (&node->lock);
 
-  const tid_t parent_tid = current_thread_tid ();
+  const tid_t parent_tid = current_process_pid ();
   if (parent_tid != node->parent_pid) {
     lock_release (&node->lock);
     return BAD_EXIT_CODE;
@@ -329,10 +363,10 @@ int collect_process_exit_code (struct process_node* node) {
   } 
 
   const int exit_code = node->exit_code;
-  lock_acquire(&processes.lock);
+  rwlock_acquire_write (&processes.lock);
   lock_release (&node->lock);
   remove_process (node);
-  lock_release(&processes.lock);
+  rwlock_release_write (&processes.lock);
 
   return exit_code;
 }
@@ -348,16 +382,255 @@ static void print_exit_code (struct process_node* node) {
   lock_release (&node->lock);
 }
 
-void exit_curr_process(int exit_code, bool should_print_exit_code) {
-  struct process_node* process = find_current_thread_process();
-  process_add_exit_code (process, exit_code);
-  if (should_print_exit_code) {
-    print_exit_code (process);
+static struct process_thread_node* find_process_thread (struct process_node* process, tid_t tid) {
+  ASSERT (lock_held_by_current_thread (&process->lock));
+
+  for (struct list_elem *e = list_begin (&process->threads); e != list_end (&process->threads); e = list_next (e)) {
+    struct process_thread_node* node = list_entry (e, struct process_thread_node, elem);
+    if (node->tid == tid)
+      return node;
+  }
+
+  return NULL;
+}
+
+static void leave_process (struct process_node* process, bool exit_process, int exit_code, bool should_print_exit_code) NO_RETURN;
+
+static void add_usage (struct thread_usage* sum, const struct thread_usage* usage) {
+  sum->user_cycles += usage->user_cycles;
+  sum->kernel_cycles += usage->kernel_cycles;
+  sum->page_faults += usage->page_faults;
+  sum->voluntary_switches += usage->voluntary_switches;
+  sum->involuntary_switches += usage->involuntary_switches;
+}
+
+struct usage_sum {
+  struct process_node* process;
+  struct thread_usage usage;
+};
+
+static void add_thread_usage (struct thread* t, void* sum_) {
+  struct usage_sum* sum = sum_;
+  if (t->process == sum->process) {
+    struct thread_usage usage;
+    thread_get_usage (t, &usage);
+    add_usage (&sum->usage, &usage);
+  }
+}
+
+/**
+ * Stores in USAGE the CPU time and counters of every thread PROCESS has run,
+ * the ones that left and the ones still running.
+ */
+void process_get_usage (struct process_node* process, struct thread_usage* usage) {
+  ASSERT (process != NULL);
+
+  struct usage_sum sum;
+  sum.process = process;
+
+  // a thread adds itself to EXITED_USAGE and leaves the process under the lock,
+  // so it is counted exactly once
+  lock_acquire (&process->lock);
+  sum.usage = process->exited_usage;
+  const enum intr_level old_level = intr_disable ();
+  thread_foreach (add_thread_usage, &sum);
+  intr_set_level (old_level);
+  lock_release (&process->lock);
+
+  *usage = sum.usage;
+}
+
+/**
+ * Takes the current thread out of PROCESS and exits it. If EXIT_PROCESS the whole
+ * process exits with EXIT_CODE: the other threads leave as soon as they are about to
+ * return to user mode. The last thread to leave frees the process's resources.
+ */
+static void leave_process (struct process_node* process, bool exit_process, int exit_code, bool should_print_exit_code) {
+  ASSERT (process != NULL);
+  struct thread* t = thread_current ();
+
+  lock_acquire (&process->lock);
+
+  const bool first_exit = exit_process && !process->exiting;
+  if (first_exit) {
+    process->exiting = true;
+    process->exit_code = exit_code;
+    process->print_exit_code = should_print_exit_code;
+  }
+
+  struct process_thread_node* node = find_process_thread (process, t->tid);
+  if (node != NULL) {
+    node->exited = true;
+  }
+  if (node != NULL || first_exit) {
+    cond_broadcast (&process->cond_thread_exited, &process->lock);
+  }
+
+  // keep the leaving thread's usage in the process's totals
+  struct thread_usage usage;
+  thread_get_usage (t, &usage);
+  add_usage (&process->exited_usage, &usage);
+  t->process = NULL;
+
+  const bool last = --process->thread_cnt == 0;
+  if (!last) {
+    // the last thread destroys the page directory, stop using it first
+    t->pagedir = NULL;
+    pagedir_activate (NULL);
+  }
+
+  lock_release (&process->lock);
+
+  if (first_exit) {
+    futex_wake_process (process);
+  }
+
+  if (last) {
+    if (!process->exiting) {
+      // every thread called thread_exit()
+      process->exit_code = 0;
+      process->print_exit_code = true;
+    }
+    process_add_exit_code (process, process->exit_code);
+    if (process->print_exit_code) {
+      print_exit_code (process);
+    }
   }
 
   thread_exit ();
+}
 
-  NOT_REACHED ();
+void exit_curr_process(int exit_code, bool should_print_exit_code) {
+  leave_process (find_current_thread_process (), true, exit_code, should_print_exit_code);
+}
+
+void exit_curr_thread(void) {
+  leave_process (find_current_thread_process (), false, 0, false);
+}
+
+bool process_is_exiting(struct process_node* process) {
+  ASSERT (process != NULL);
+  return process->exiting;
+}
+
+/**
+ * Called on every return to user mode, possibly with interrupts off. Exits the current
+ * thread if another thread of its process has called exit().
+ */
+void process_exit_if_exiting(void) {
+  struct process_node* process = find_current_thread_process ();
+  if (process != NULL && process->exiting) {
+    intr_enable ();
+    exit_curr_thread ();
+  }
+}
+
+////////////////////
+////  threads  /////
+////////////////////
+
+/**
+ * Returns a free stack slot for a new thread of PROCESS, or -1 if there is none.
+ */
+int reserve_process_thread_stack(struct process_node* process) {
+  ASSERT (process != NULL);
+
+  lock_acquire (&process->lock);
+
+  int slot = -1;
+  for (int i = 0; i < USER_THREAD_MAX; i++) {
+    if ((process->thread_stacks & (1u << i)) == 0) {
+      process->thread_stacks |= 1u << i;
+      slot = i;
+      break;
+    }
+  }
+
+  lock_release (&process->lock);
+  return slot;
+}
+
+void release_process_thread_stack(struct process_node* process, int slot) {
+  ASSERT (process != NULL);
+  ASSERT (slot >= 0 && slot < USER_THREAD_MAX);
+
+  lock_acquire (&process->lock);
+  process->thread_stacks &= ~(1u << slot);
+  lock_release (&process->lock);
+}
+
+/**
+ * Adds thread TID, running on stack SLOT, to PROCESS so that it can be joined.
+ * Fails if the process is exiting.
+ */
+bool add_process_thread(struct process_node* process, tid_t tid, int slot) {
+  ASSERT (process != NULL);
+
+  struct process_thread_node* node = malloc (sizeof (struct process_thread_node));
+  if (node == NULL) {
+    return false;
+  }
+  node->tid = tid;
+  node->stack_slot = slot;
+  node->exited = false;
+  node->joining = false;
+
+  lock_acquire (&process->lock);
+
+  if (process->exiting) {
+    lock_release (&process->lock);
+    free (node);
+    return false;
+  }
+
+  list_push_back (&process->threads, &node->elem);
+  process->thread_cnt++;
+
+  lock_release (&process->lock);
+  return true;
+}
+
+/**
+ * Waits for thread TID of PROCESS to exit and frees its stack slot.
+ * Returns 0, or -1 if TID isn't a joinable thread of PROCESS or the process is exiting.
+ */
+int join_process_thread(struct process_node* process, tid_t tid) {
+  ASSERT (process != NULL);
+
+  lock_acquire (&process->lock);
+
+  struct process_thread_node* node = find_process_thread (process, tid);
+  if (node == NULL || node->joining || tid == current_thread_tid ()) {
+    lock_release (&process->lock);
+    return BAD_EXIT_CODE;
+  }
+
+  node->joining = true;
+  while (!node->exited && !process->exiting) {
+    cond_wait (&process->cond_thread_exited, &process->lock);
+  }
+
+  if (!node->exited) {
+    node->joining = false;
+    lock_release (&process->lock);
+    return BAD_EXIT_CODE;
+  }
+
+  list_remove (&node->elem);
+  process->thread_stacks &= ~(1u << node->stack_slot);
+  free (node);
+
+  lock_release (&process->lock);
+  return 0;
+}
+
+static void destroy_process_threads(struct process_node* process) {
+  ASSERT (lock_held_by_current_thread (&process->lock));
+
+  while (!list_empty (&process->threads)) {
+    struct list_elem *e = list_pop_front (&process->threads);
+    free (list_entry (e, struct process_thread_node, elem));
+  }
 }
 
 ////////////////////
@@ -380,8 +653,14 @@ static bool vm_table_less (const struct hash_elem *l, const struct hash_elem *r,
   return node_l->page_vaddr < node_r->page_vaddr;
 }
 
+static struct kmem_cache vm_node_cache = KMEM_CACHE_INITIALIZER (vm_node_cache, "vm_node", struct vm_node, NULL);
+
 static struct vm_node* create_vm_node(void * vaddr, struct process_node* process) {
-  struct vm_node* node = malloc (sizeof (struct vm_node));
+  struct vm_node* node = kmem_cache_alloc (&vm_node_cache);
+  if (node == NULL) {
+    return NULL;
+  }
+
   node->page_vaddr = (uintptr_t) vaddr;
   node->process = process;
 
@@ -407,7 +686,7 @@ static struct vm_node* add_file_backed_vm_internal(struct process_node* process,
 
   struct file_page_node* file_page = create_file_page_node(file, file_path, offset, num_zero_padding);
   if (file_page == NULL) {
-    free (node);
+    kmem_cache_free (&vm_node_cache, node);
     return NULL;
   }
 
@@ -419,7 +698,7 @@ static struct vm_node* add_file_backed_vm_internal(struct process_node* process,
     struct active_files_list* active_files = shared_readonly_file ? &readonly_files : &writable_files;
     struct file_offset_mapping* shared_executable = add_active_file(active_files, file_page);
     if (shared_executable == NULL) {
-      free (node);
+      kmem_cache_free (&vm_node_cache, node);
       destroy_file_page_node(file_page);
       return NULL;
     }
@@ -451,6 +730,10 @@ struct vm_node* add_file_backed_vm(struct process_node* process, uint8_t* vaddr,
   return node;
 }
 
+/**
+ * Returns the stack page at VADDR, adding it if it doesn't exist yet: a sibling thread
+ * may have grown into it first. Returns NULL if something else is mapped there.
+ */
 struct vm_node* add_stack_freestanding_vm(struct process_node* process, uint8_t* vaddr) {
   ASSERT (process != NULL);
   ASSERT (! process->exited);
@@ -459,7 +742,13 @@ struct vm_node* add_stack_freestanding_vm(struct process_node* process, uint8_t*
 
   lock_acquire (&process->lock);
 
-  struct vm_node* node = create_vm_node(vaddr, process);
+  struct vm_node* node = find_vm_node_internal(process, vaddr);
+  if (node != NULL) {
+    lock_release (&process->lock);
+    return node->page_common.type == FREESTANDING ? node : NULL;
+  }
+
+  node = create_vm_node(vaddr, process);
   if (node == NULL) {
     lock_release (&process->lock);
     return NULL;
@@ -523,7 +812,7 @@ static void destroy_vm_page_node (struct vm_node *node) {
       NOT_REACHED();
   }
 
-  free (node);
+  kmem_cache_free (&vm_node_cache, node);
 }
 
 /* Adds a mapping from user virtual address UPAGE to kernel 
@@ -543,13 +832,18 @@ static bool install_page (uint32_t* pagedir, void *upage, void *kpage, bool writ
           && pagedir_set_page (pagedir, upage, kpage, writable));
 }
 
-void* activate_vm_page(struct vm_node* node) {
-
-  // print_process_vm(node->process);
+/**
+ * Loads NODE's page into a frame and maps it, returns the frame's kernel address or NULL
+ * if that fails. Sibling threads can fault on the same page at once, so it may already be
+ * mapped.
+ */
+static void* activate_vm_page_internal(struct vm_node* node) {
   ASSERT (node != NULL);
-  ASSERT (! is_mapped(node));
+  ASSERT (lock_held_by_current_thread(&node->process->lock));
 
-  lock_acquire (&node->process->lock);
+  if (is_mapped(node)) {
+    return get_frame_phys_addr(node->frame);
+  }
 
   switch (node->page_common.type) {
     case SHARED_READONLY_FILE:
@@ -576,7 +870,6 @@ void* activate_vm_page(struct vm_node* node) {
 
   // failed to load
   if (node->frame == NULL) {
-    lock_release (&node->process->lock);
     return NULL;
   }
 
@@ -586,17 +879,40 @@ void* activate_vm_page(struct vm_node* node) {
   void* vaddr = (void*) node->page_vaddr;
   const bool writable = ! is_page_common_readonly(&node->page_common);
   if (! install_page(node->process->pagedir, vaddr, paddr, writable)) {
-    struct lock* lock = &node->process->lock;
     destroy_frame(node->frame);
-    lock_release (lock);
     return NULL;
   }
 
+  return paddr;
+}
+
+void* activate_vm_page(struct vm_node* node) {
+  ASSERT (node != NULL);
+
+  lock_acquire (&node->process->lock);
+  void* paddr = activate_vm_page_internal(node);
   lock_release (&node->process->lock);
 
   return paddr;
 }
 
+/**
+ * Like activate_vm_page() for the page at ADDRESS, looked up under the same lock so that
+ * a sibling thread can't unmap it in between. Returns NULL if there is no such page.
+ */
+void* activate_vm_address(struct process_node* process, void* address) {
+  ASSERT (process != NULL);
+
+  lock_acquire (&process->lock);
+
+  struct vm_node* node = find_vm_node_internal(process, address);
+  void* paddr = node != NULL ? activate_vm_page_internal(node) : NULL;
+
+  lock_release (&process->lock);
+
+  return paddr;
+}
+
 
 static void destroy_vm_page (struct hash_elem *e, void *_ UNUSED) {
 
@@ -690,28 +1006,6 @@ struct vm_node* find_vm_node(struct process_node* process, void* address) {
   return node;
 }
 
-void add_process_user_stack_ptr(struct process_node* process, void* address) {
-  ASSERT (process != NULL);
-
-  lock_acquire (&process->lock);
-
-  process->syscall_stack_ptr = address;
-
-  lock_release (&process->lock);
-}
-
-void* collect_process_user_stack_ptr(struct process_node* process) {
-  ASSERT (process != NULL);
-
-  lock_acquire (&process->lock);
-  void* addr = process->syscall_stack_ptr;
-  ASSERT(addr != NULL);
-
-  lock_release (&process->lock);
-
-  return addr;
-}
-
 
 ////////////////////
 ////  MMAP     /////
@@ -723,6 +1017,14 @@ struct mmap_node {
   struct list vm_nodes;
 };
 
+static void mmap_node_ctor(void* object) {
+  struct mmap_node* node = object;
+
+  list_init(&node->vm_nodes);
+}
+
+static struct kmem_cache mmap_node_cache = KMEM_CACHE_INITIALIZER (mmap_node_cache, "mmap_node", struct mmap_node, mmap_node_ctor);
+
 int add_file_mapping(struct process_node* process, int fd, void* addr) {
   ASSERT (process != NULL);
   ASSERT (fd >= 2);
@@ -754,10 +1056,13 @@ int add_file_mapping(struct process_node* process, int fd, void* addr) {
     }
   }
 
-  struct mmap_node* map_node = malloc (sizeof (struct mmap_node));
+  struct mmap_node* map_node = kmem_cache_alloc (&mmap_node_cache);
+  if (map_node == NULL) {
+    lock_release (&process->lock);
+    return MMAP_ERROR;
+  }
   map_node->mapid = process->mapid_counter;
   process->mapid_counter++;
-  list_init(&map_node->vm_nodes);
 
   const bool holding = lock_acquire_if_not_held(&filesys_monitor);
   struct inode *inode = file_get_inode (file_node->file);
@@ -812,7 +1117,7 @@ static void destroy_mmap_node (struct process_node* process, struct mmap_node* m
     destroy_vm_page_node(vm);
   } 
 
-  free (mmap_node);
+  kmem_cache_free (&mmap_node_cache, mmap_node);
 }
 
 
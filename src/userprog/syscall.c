@@ -1,9 +1,11 @@
 #include <stdio.h>
 #include <syscall-nr.h>
+#include <rusage.h>
 #include <kernel/stdio.h>
 #include <kernel/console.h>
 
 #include "devices/shutdown.h"
+#include "devices/timer.h"
 #include "threads/malloc.h"
 #include "userprog/syscall.h"
 #include "threads/interrupt.h"
@@ -14,6 +16,7 @@
 #include "threads/synch.h"
 #include "filesys/filesys.h"
 #include "process_vm.h"
+#include "futex.h"
 
 #define SYSCALL_ERROR -1
 #define MAX_FILENAME_SIZE 15
@@ -23,6 +26,7 @@ static void syscall_handler (struct intr_frame *);
 void
 syscall_init (void) 
 {
+  futex_init ();
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
@@ -274,11 +278,35 @@ static void munmap (int mmapid) {
   unmap_file_mapping (find_current_thread_process (), mmapid);
 }
 
+static int getrusage (int who, struct rusage* u_usage) {
+  struct thread_usage usage;
+  if (who == RUSAGE_SELF) {
+    process_get_usage (find_current_thread_process (), &usage);
+  } else if (who == RUSAGE_THREAD) {
+    thread_get_usage (thread_current (), &usage);
+  } else {
+    return SYSCALL_ERROR;
+  }
+
+  struct rusage ru;
+  ru.ru_utime_us = timer_cycles_to_us (usage.user_cycles);
+  ru.ru_stime_us = timer_cycles_to_us (usage.kernel_cycles);
+  ru.ru_pgfault = usage.page_faults;
+  ru.ru_nvcsw = usage.voluntary_switches;
+  ru.ru_nivcsw = usage.involuntary_switches;
+
+  if (! set_userland_buffer (u_usage, &ru, sizeof ru)) {
+    exit_curr_process (BAD_EXIT_CODE, true);
+    NOT_REACHED ();
+  }
+  return 0;
+}
+
 static void
 syscall_handler (struct intr_frame *f) 
 {
   void* esp = f->esp;
-  add_process_user_stack_ptr(find_current_thread_process(), esp);
+  thread_current ()->user_esp = esp;
   const int syscall_num = get_stack_int (&esp);
   switch (syscall_num) {
     // lab 2
@@ -369,6 +397,44 @@ syscall_handler (struct intr_frame *f)
       return;
     }
 
+    // futexes
+    case SYS_FUTEX_WAIT: {
+      uint32_t* u_addr = (uint32_t*) get_stack_ptr (&esp);
+      const uint32_t expected = get_stack_double_word (&esp);
+      set_ret_val (f, futex_wait (u_addr, expected));
+      return;
+    }
+    case SYS_FUTEX_WAKE: {
+      uint32_t* u_addr = (uint32_t*) get_stack_ptr (&esp);
+      const int cnt = get_stack_int (&esp);
+      set_ret_val (f, futex_wake (u_addr, cnt));
+      return;
+    }
+
+    // threads
+    case SYS_THREAD_CREATE: {
+      void* start = get_stack_ptr (&esp);
+      void* func = get_stack_ptr (&esp);
+      void* aux = get_stack_ptr (&esp);
+      set_ret_val (f, process_thread_create (start, func, aux));
+      return;
+    }
+    case SYS_THREAD_JOIN: {
+      const tid_t tid = get_stack_int (&esp);
+      set_ret_val (f, join_process_thread (find_current_thread_process (), tid));
+      return;
+    }
+    case SYS_THREAD_EXIT: {
+      exit_curr_thread ();
+      break;
+    }
+    case SYS_GETRUSAGE: {
+      const int who = get_stack_int (&esp);
+      struct rusage* u_usage = (struct rusage*) get_stack_ptr (&esp);
+      set_ret_val (f, getrusage (who, u_usage));
+      return;
+    }
+
     // lab 4
     case SYS_CHDIR:
     case SYS_MKDIR:
@@ -6,6 +6,7 @@
 struct tss;
 void tss_init (void);
 struct tss *tss_get (void);
+struct tss *tss_get_cpu (int id);
 void tss_update (void);
 
 #endif /* userprog/tss.h */
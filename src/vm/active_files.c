@@ -4,7 +4,7 @@
 #include <string.h>
 #include <stdio.h>
 
-#include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 #include "active_files.h"
 #include "filesys/off_t.h"
@@ -23,10 +23,18 @@ struct file_offset_mapping {
   unsigned int process_ref_count;
 };
 
+static void file_offset_mapping_ctor(void* object) {
+  struct file_offset_mapping* node = object;
+
+  lock_init(&node->lock);
+}
+
+static struct kmem_cache file_offset_mapping_cache = KMEM_CACHE_INITIALIZER (file_offset_mapping_cache, "file_offset_mapping", struct file_offset_mapping, file_offset_mapping_ctor);
+
 static struct file_offset_mapping* create_file_offset_mapping(struct file_page_node* file_page) {
   ASSERT (file_page != NULL);
 
-  struct file_offset_mapping* node = malloc(sizeof(struct file_offset_mapping));
+  struct file_offset_mapping* node = kmem_cache_alloc(&file_offset_mapping_cache);
   if (node == NULL) {
     return NULL;
   }
@@ -34,7 +42,6 @@ static struct file_offset_mapping* create_file_offset_mapping(struct file_page_n
   node->file_page = file_page;
   node->process_ref_count = 0;
   node->frame = NULL;
-  lock_init(&node->lock);
   
   return node;
 }
@@ -55,9 +62,11 @@ static bool active_files_list_less (const struct hash_elem *l, const struct hash
  
 #define ACTIVE_FILE_NAME_SIZE 16
 
+// looked up every time a process maps a file page, changed only when the first
+// process maps one or the last one unmaps it
 struct active_files_list {
   struct hash active_files;
-  struct lock monitor;
+  struct rwlock monitor;
   const char* name;
 };
 
@@ -65,7 +74,7 @@ struct active_files_list readonly_files;
 struct active_files_list writable_files;
 
 static bool init_active_files_list(struct active_files_list* active_files, const char* name) {
-  lock_init (&active_files->monitor);
+  rwlock_init (&active_files->monitor);
   active_files->name = name;
   return hash_init (&active_files->active_files, active_files_list_hash, active_files_list_less, NULL);
 }
@@ -98,52 +107,77 @@ struct file_page_node* get_file_offset_mapping_file_page(struct file_offset_mapp
 }
 
 bool active_file_exists(struct active_files_list* active_list, struct file_page_node* file_page) {
-  lock_acquire (&active_list->monitor);
+  rwlock_acquire_read (&active_list->monitor);
 
   struct file_offset_mapping* node = find_file_offset_mapping(&active_list->active_files, file_page);
 
-  lock_release (&active_list->monitor);
+  rwlock_release_read (&active_list->monitor);
 
   return node != NULL;
 }
 
-struct file_offset_mapping* add_active_file(struct active_files_list* active_list, struct file_page_node* file_page) {
+// takes a reference to NODE, which the caller found in its list
+static struct file_offset_mapping* ref_file_offset_mapping(struct file_offset_mapping* node, struct file_page_node* file_page) {
+  lock_acquire (&node->lock);
+  node->process_ref_count++;
+  lock_release (&node->lock);
+
+  destroy_file_page_node(file_page);
+  return node;
+}
 
-  lock_acquire (&active_list->monitor);
+struct file_offset_mapping* add_active_file(struct active_files_list* active_list, struct file_page_node* file_page) {
 
+  // the file is usually mapped already
+  rwlock_acquire_read (&active_list->monitor);
   struct file_offset_mapping* node = find_file_offset_mapping(&active_list->active_files, file_page);
-  if (node == NULL) {
-    node = create_file_offset_mapping(file_page);
-    if (node == NULL) {
-      lock_release (&active_list->monitor);
-      return NULL;
-    }
-
-    ASSERT (hash_insert (&active_list->active_files, &node->elem) == NULL);
-  } else {
-    destroy_file_page_node(file_page);
+  if (node != NULL) {
+    node = ref_file_offset_mapping(node, file_page);
+  }
+  rwlock_release_read (&active_list->monitor);
+  if (node != NULL) {
+    return node;
   }
 
+  rwlock_acquire_write (&active_list->monitor);
+
+  // another process may have mapped it meanwhile
+  node = find_file_offset_mapping(&active_list->active_files, file_page);
+  if (node != NULL) {
+    node = ref_file_offset_mapping(node, file_page);
+    rwlock_release_write (&active_list->monitor);
+    return node;
+  }
+
+  node = create_file_offset_mapping(file_page);
+  if (node == NULL) {
+    rwlock_release_write (&active_list->monitor);
+    return NULL;
+  }
   node->process_ref_count++;
+  ASSERT (hash_insert (&active_list->active_files, &node->elem) == NULL);
 
-  lock_release (&active_list->monitor);
+  rwlock_release_write (&active_list->monitor);
   return node;
 }
 
 void destroy_active_file (struct active_files_list* active_list, struct file_offset_mapping *node) {
   ASSERT (node != NULL);
 
+  // the list's lock comes first, so that add_active_file() can't find NODE while the
+  // last reference goes away
+  rwlock_acquire_write (&active_list->monitor);
   lock_acquire (&node->lock);
   node->process_ref_count--;
 
   if (node->process_ref_count != 0) {
     lock_release (&node->lock);
+    rwlock_release_write (&active_list->monitor);
     return;
   }
 
-  lock_acquire (&active_list->monitor);
   ASSERT (hash_delete (&active_list->active_files, &node->elem) != NULL);
-  lock_release (&active_list->monitor);
+  rwlock_release_write (&active_list->monitor);
   if (node->frame != NULL) {
     destroy_frame(node->frame);
     node->frame = NULL;
@@ -151,7 +185,7 @@ void destroy_active_file (struct active_files_list* active_list, struct file_off
   destroy_file_page_node(node->file_page);
 
   lock_release (&node->lock);
-  free (node);
+  kmem_cache_free (&file_offset_mapping_cache, node);
 }
 
 struct frame_node* load_file_offset_mapping_page (struct file_offset_mapping *node) {
@@ -191,11 +225,11 @@ static void file_offset_mapping_print (struct hash_elem *e, void *_ UNUSED) {
 }
 
 void print_active_files (struct active_files_list* active_list) {
-  lock_acquire (&active_list->monitor);
+  rwlock_acquire_read (&active_list->monitor);
 
   printf ("Active files (name=%s, len=%lu): \n", active_list->name, hash_size(&active_list->active_files));
   hash_apply (&active_list->active_files, file_offset_mapping_print);
   printf("---\n");
 
-  lock_release (&active_list->monitor);
+  rwlock_release_read (&active_list->monitor);
 }
\ No newline at end of file
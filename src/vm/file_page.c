@@ -4,12 +4,13 @@
 
 #include "filesys/off_t.h"
 #include "file_page.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/vaddr.h"
 #include "strings_pool.h"
 #include "frame_table.h"
 #include "filesys/inode.h"
 
+static struct kmem_cache file_page_node_cache = KMEM_CACHE_INITIALIZER (file_page_node_cache, "file_page_node", struct file_page_node, NULL);
 
 struct file_page_node* create_file_page_node(struct file * opened_file, const char* file_path, off_t offset, size_t num_zero_padding) {
   ASSERT (num_zero_padding <= PGSIZE);
@@ -24,7 +25,7 @@ struct file_page_node* create_file_page_node(struct file * opened_file, const ch
     return NULL;
   }
 
-  struct file_page_node* node = malloc (sizeof (struct file_page_node));
+  struct file_page_node* node = kmem_cache_alloc (&file_page_node_cache);
   if (node == NULL) {
     return NULL;
   }
@@ -46,7 +47,7 @@ void destroy_file_page_node(struct file_page_node* node) {
   file_close(node->file);
   lock_release_if_not_held (&filesys_monitor, holding);
 
-  free (node);
+  kmem_cache_free (&file_page_node_cache, node);
 }
 
 unsigned int hash_file_page_node (struct file_page_node* node) {
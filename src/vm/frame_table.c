@@ -8,8 +8,8 @@
 #include "frame_table.h"
 #include "threads/synch.h"
 #include "userprog/process_vm.h"
-#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "page_common.h"
 #include "threads/vaddr.h"
 
@@ -22,6 +22,15 @@ struct frame_node {
   bool dirty_acum;
 };
 
+static void frame_node_ctor(void* object) {
+  struct frame_node* node = object;
+
+  list_init(&node->vm_nodes);
+  lock_init(&node->lock);
+}
+
+static struct kmem_cache frame_node_cache = KMEM_CACHE_INITIALIZER (frame_node_cache, "frame_node", struct frame_node, frame_node_ctor);
+
 static struct frame_table {
   struct list frames;
   struct lock monitor;
@@ -33,14 +42,12 @@ void init_frame_table(void) {
 }
 
 static struct frame_node* create_frame_node(void) {
-  struct frame_node* node = malloc(sizeof (struct frame_node));
+  struct frame_node* node = kmem_cache_alloc(&frame_node_cache);
   if (node == NULL) {
     return NULL;
   }
 
-  list_init(&node->vm_nodes);
   node->phys_addr = NULL;
-  lock_init(&node->lock);
   node->page_common.type = -1;
   node->dirty_acum = false;
 
@@ -136,7 +143,7 @@ void destroy_frame(struct frame_node* node) {
   palloc_free_page(node->phys_addr);
   lock_release(&node->lock);
 
-  free(node);
+  kmem_cache_free(&frame_node_cache, node);
 }
 
 
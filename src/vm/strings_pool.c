@@ -8,6 +8,7 @@
 #include "threads/synch.h"
 #include "strings_pool.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/vaddr.h"
 
 #define MAX_STRING_SIZE PGSIZE
@@ -24,6 +25,8 @@ static struct strings_pool {
   struct lock monitor;
 } pool;
 
+static struct kmem_cache string_node_cache = KMEM_CACHE_INITIALIZER (string_node_cache, "string_node", struct string_node, NULL);
+
 static unsigned int strings_pool_hash (const struct hash_elem *e, void *_ UNUSED) {
   struct string_node *node = hash_entry (e, struct string_node, elem);
   return hash_string (node->string);
@@ -66,8 +69,9 @@ static struct string_node* create_string_node(const char* string) {
   }
 
   strlcpy (str_cpy, string, str_size);
-  struct string_node* node = malloc(sizeof(struct string_node));
+  struct string_node* node = kmem_cache_alloc(&string_node_cache);
   if (node == NULL) {
+    free(str_cpy);
     return NULL;
   }
 
@@ -110,7 +114,7 @@ void remove_string_pool(const char* string) {
   if (node->ref_count == 0) {
     hash_delete (&pool.strings, &node->elem);
     free((void*) node->string);
-    free(node);
+    kmem_cache_free(&string_node_cache, node);
   }
 
 